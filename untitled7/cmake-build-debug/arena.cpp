@@ -0,0 +1,83 @@
+#include "arena.h"
+#include <algorithm>
+#include <atomic>
+#include <string>
+
+using namespace std;
+
+// Buffer of a new arena, the most one arena keeps between problems, and the
+// most all arenas of the process keep together (memory beyond that is returned
+// to the heap on every reset)
+const size_t ARENA_INITIAL_BYTES = 64 * 1024;
+const size_t ARENA_MAX_RETAINED_BYTES = 256 * 1024 * 1024;
+const size_t ARENA_TOTAL_RETAINED_BYTES = 512 * 1024 * 1024;
+
+// Buffer bytes held by all arenas
+static atomic<size_t> retainedBytes{0};
+
+// Takes up to bytes more of the total retained by all arenas and returns how many it got
+static size_t reserveRetained(size_t bytes) {
+    size_t held = retainedBytes.load(memory_order_relaxed);
+    size_t granted;
+    do {
+        granted = held < ARENA_TOTAL_RETAINED_BYTES ? min(bytes, ARENA_TOTAL_RETAINED_BYTES - held) : 0;
+    } while (granted != 0 && !retainedBytes.compare_exchange_weak(held, held + granted, memory_order_relaxed));
+    return granted;
+}
+
+MemoryBudgetExceeded::MemoryBudgetExceeded(size_t requested, size_t used, size_t budget)
+    : runtime_error("Memory budget of " + to_string(budget) + " bytes exceeded (" + to_string(used) +
+                    " in use, " + to_string(requested) + " more requested)"),
+      requested(requested), used(used), budget(budget) {}
+
+ScratchArena::ScratchArena() : bufferSize(reserveRetained(ARENA_INITIAL_BYTES)) {
+    if (bufferSize > 0) buffer = make_unique_for_overwrite<byte[]>(bufferSize);
+    arena.emplace(buffer.get(), bufferSize, &overflow, budgetBytes);
+}
+
+ScratchArena::~ScratchArena() {
+    arena.reset();
+    retainedBytes.fetch_sub(bufferSize, memory_order_relaxed);
+}
+
+void ScratchArena::setBudget(size_t bytes) {
+    budgetBytes = bytes;
+    arena->budget = bytes;
+}
+
+void ScratchArena::reset() {
+    size_t needed = min(bufferSize + overflow.allocated, ARENA_MAX_RETAINED_BYTES);
+    arena.reset(); // Returns the overflow blocks to the heap
+    if (overflow.allocated > 0 && bufferSize < needed) {
+        // Grow by what the other arenas leave of the total
+        size_t granted = reserveRetained(needed - bufferSize);
+        if (granted > 0) {
+            buffer.reset();
+            buffer = make_unique_for_overwrite<byte[]>(bufferSize + granted);
+            bufferSize += granted;
+        }
+    }
+    overflow.allocated = 0;
+    arena.emplace(buffer.get(), bufferSize, &overflow, budgetBytes);
+}
+
+void* ScratchArena::AccountedResource::do_allocate(size_t bytes, size_t alignment) {
+    if (budget != 0 && (used > budget || bytes > budget - used)) {
+        throw MemoryBudgetExceeded(bytes, used, budget);
+    }
+    used += bytes;
+    return monotonic_buffer_resource::do_allocate(bytes, alignment);
+}
+
+void* ScratchArena::OverflowResource::do_allocate(size_t bytes, size_t alignment) {
+    allocated += bytes;
+    return pmr::new_delete_resource()->allocate(bytes, alignment);
+}
+
+void ScratchArena::OverflowResource::do_deallocate(void* p, size_t bytes, size_t alignment) {
+    pmr::new_delete_resource()->deallocate(p, bytes, alignment);
+}
+
+bool ScratchArena::OverflowResource::do_is_equal(const pmr::memory_resource& other) const noexcept {
+    return this == &other;
+}
@@ -0,0 +1,87 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <memory>
+#include <memory_resource>
+#include <optional>
+#include <stdexcept>
+#include <vector>
+
+// Thrown when an allocation would take an arena past its budget
+class MemoryBudgetExceeded : public std::runtime_error {
+public:
+    MemoryBudgetExceeded(size_t requested, size_t used, size_t budget);
+
+    size_t requested;
+    size_t used;
+    size_t budget;
+};
+
+// Monotonic scratch memory for one minimization. Containers built on resource()
+// free nothing individually; reset() drops everything at once. Memory the arena
+// had to take from the heap is folded into its own buffer on reset, so a solver
+// reused for similar problems stops calling malloc/free after the first calls.
+// What the arenas of a process keep between problems is capped in total (see
+// arena.cpp), so many contexts do not each hold on to the peak of one solve.
+class ScratchArena {
+public:
+    ScratchArena();
+    ~ScratchArena();
+
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    std::pmr::memory_resource* resource() { return &*arena; }
+
+    // Frees everything allocated since the last reset (keeping the capacity)
+    void reset();
+
+    size_t capacity() const { return bufferSize; }
+
+    // Bytes handed out since the last reset; nothing is freed in between, so
+    // this is also the peak
+    size_t used() const { return arena->used; }
+
+    // Caps used() (0 = no cap); an allocation past it throws MemoryBudgetExceeded
+    void setBudget(size_t bytes);
+    size_t budget() const { return budgetBytes; }
+
+    // Whether bytes more would stay within the budget
+    bool fits(size_t bytes) const {
+        return budgetBytes == 0 || (arena->used <= budgetBytes && bytes <= budgetBytes - arena->used);
+    }
+
+private:
+    // The monotonic arena, counting what it hands out
+    class AccountedResource : public std::pmr::monotonic_buffer_resource {
+    public:
+        AccountedResource(void* buffer, size_t size, std::pmr::memory_resource* upstream, size_t budget)
+            : monotonic_buffer_resource(buffer, size, upstream), budget(budget) {}
+
+        size_t used = 0;
+        size_t budget;
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+    };
+
+    // Heap memory taken by the arena once its buffer is used up
+    class OverflowResource : public std::pmr::memory_resource {
+    public:
+        size_t allocated = 0;
+
+    private:
+        void* do_allocate(size_t bytes, size_t alignment) override;
+        void do_deallocate(void* p, size_t bytes, size_t alignment) override;
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override;
+    };
+
+    OverflowResource overflow;
+    std::unique_ptr<std::byte[]> buffer;   // Not zero-filled: the arena hands out uninitialized memory anyway
+    size_t bufferSize = 0;
+    size_t budgetBytes = 0;
+    std::optional<AccountedResource> arena;
+};
+
+#endif // ARENA_H
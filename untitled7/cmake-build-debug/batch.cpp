@@ -0,0 +1,434 @@
+#include "batch.h"
+#include "bit_slice.h"
+#include "flight_recorder.h"
+#include "mapped_file.h"
+#include "problem.h"
+#include "qm.h"
+#include "server.h"
+#include "term_parser.h"
+#include "trace.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <condition_variable>
+#include <filesystem>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+// One problem of a batch: a file to load, or a piece of a stream
+struct BatchItem {
+    string name;
+    string path;
+    string_view text;
+};
+
+// Writes a sum of products over cover, e.g. "AB + C'"
+static string formatSum(const vector<string>& cover, const vector<size_t>* terms) {
+    string sum;
+    size_t count = terms ? terms->size() : cover.size();
+    for (size_t i = 0; i < count; i++) {
+        string expression = cubeToExpression(cover[terms ? (*terms)[i] : i]);
+        if (i != 0) sum += " + ";
+        sum += expression.empty() ? "1" : expression;
+    }
+    return sum.empty() ? "0" : sum;
+}
+
+// Formats the result line of one problem
+static string formatResult(const string& name, const QMResult& result) {
+    string line = name + ": ";
+    if (!result.isMultiOutput()) {
+        return line + "F = " + formatSum(result.cover, nullptr);
+    }
+    for (size_t k = 0; k < result.outputTerms.size(); k++) {
+        if (k != 0) line += "; ";
+        line += "F" + to_string(k) + " = " + formatSum(result.cover, &result.outputTerms[k]);
+    }
+    return line;
+}
+
+// Formats an error line; multi-line messages are joined with "; "
+static string formatError(const string& name, const string& message) {
+    string line = name + ": error: ";
+    for (char c : message) {
+        if (c == '\n') line += "; ";
+        else line += c;
+    }
+    return line;
+}
+
+// Loads one item; returns false (with its error line) when it failed
+static bool loadItem(const BatchItem& item, Problem& problem, string& line) {
+    TraceSpan span("load_problem");
+    try {
+        problem = item.path.empty() ? parseProblem(item.text) : loadProblem(item.path);
+        return true;
+    }
+    catch (const exception& e) {
+        line = formatError(item.name, e.what());
+        return false;
+    }
+}
+
+// Formats the result line of one item; returns false when it was invalid
+static bool finishItem(const BatchItem& item, const QMResult& result, string& line) {
+    if (!result.valid) {
+        string message;
+        for (const string& error : result.errors) message += (message.empty() ? "" : "\n") + error;
+        line = formatError(item.name, message);
+        return false;
+    }
+    line = formatResult(item.name, result);
+    return true;
+}
+
+// Lists the regular files of a directory, sorted by name
+static vector<BatchItem> directoryItems(const string& path) {
+    vector<BatchItem> items;
+    for (const filesystem::directory_entry& entry : filesystem::directory_iterator(path)) {
+        if (entry.is_regular_file()) {
+            items.push_back({entry.path().filename().string(), entry.path().string(), {}});
+        }
+    }
+    sort(items.begin(), items.end(), [](const BatchItem& a, const BatchItem& b) { return a.name < b.name; });
+    return items;
+}
+
+// Lists the problem files named by a manifest
+static vector<BatchItem> manifestItems(const string& path, string_view text) {
+    filesystem::path base = filesystem::path(path).parent_path();
+    vector<BatchItem> items;
+    for (string_view line : splitLines(text)) {
+        size_t first = line.find_first_not_of(" \t");
+        if (first == string_view::npos || line[first] == '#') continue;
+        size_t last = line.find_last_not_of(" \t");
+        string name(line.substr(first, last - first + 1));
+        filesystem::path file(name);
+        if (file.is_relative()) file = base / file;
+        items.push_back({name, file.string(), {}});
+    }
+    return items;
+}
+
+// Splits a stream at lines containing only "---"; problems are named "<stream>#<n>"
+static vector<BatchItem> streamItems(const string& path, string_view text) {
+    vector<BatchItem> items;
+    size_t start = 0;
+    size_t position = 0;
+    auto addItem = [&](size_t end) {
+        string_view piece = text.substr(start, end - start);
+        size_t first = piece.find_first_not_of(" \t\r\n");
+        if (first != string_view::npos) {
+            // Skip blank lines before the problem
+            size_t lineStart = piece.rfind('\n', first);
+            piece.remove_prefix(lineStart == string_view::npos ? 0 : lineStart + 1);
+            items.push_back({path + "#" + to_string(items.size() + 1), "", piece});
+        }
+    };
+    while (position < text.size()) {
+        size_t end = text.find('\n', position);
+        if (end == string_view::npos) end = text.size();
+        string_view line = text.substr(position, end - position);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (line == "---") {
+            addItem(position);
+            start = end + 1;
+        }
+        position = end + 1;
+    }
+    addItem(text.size());
+    return items;
+}
+
+// Nearest-rank percentile of sorted values
+static double percentile(const vector<double>& sorted, double p) {
+    if (sorted.empty()) return 0;
+    size_t rank = static_cast<size_t>(ceil(p / 100.0 * sorted.size()));
+    return sorted[min(sorted.size(), max<size_t>(rank, 1)) - 1];
+}
+
+// Lists the items of a source. Manifests and streams are read once and stay
+// in file or standardInput while the items are in use.
+static vector<BatchItem> sourceItems(BatchSource source, const string& path, unique_ptr<MappedFile>& file,
+                                     string& standardInput) {
+    string_view text;
+    if (source != BatchSource::Directory) {
+        if (path == "-") {
+            standardInput.assign(istreambuf_iterator<char>(cin), istreambuf_iterator<char>());
+            text = standardInput;
+        } else {
+            file = make_unique<MappedFile>(path);
+            text = file->contents();
+        }
+    }
+    if (source == BatchSource::Directory) return directoryItems(path);
+    if (source == BatchSource::Manifest) return manifestItems(path, text);
+    return streamItems(path, text);
+}
+
+// Fills in the summary from the latencies of every problem
+static void summarize(BatchSummary& summary, vector<double>& latencies, chrono::steady_clock::time_point start) {
+    summary.seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    sort(latencies.begin(), latencies.end());
+    summary.p50 = percentile(latencies, 50);
+    summary.p90 = percentile(latencies, 90);
+    summary.p99 = percentile(latencies, 99);
+    summary.max = latencies.empty() ? 0 : latencies.back();
+}
+
+// Solves every problem of the source on a worker pool and writes the results in input order
+BatchSummary runBatch(BatchSource source, const string& path, ostream& out, unsigned threads,
+                      ResultCache* cache, size_t memoryBudget, FlightRecorder* recorder) {
+    auto start = chrono::steady_clock::now();
+    unique_ptr<MappedFile> file;
+    string standardInput;
+    vector<BatchItem> items = sourceItems(source, path, file, standardInput);
+
+    size_t count = items.size();
+    vector<string> lines(count);
+    vector<double> latencies(count);
+    vector<char> failed(count, 0);
+    vector<char> done(count, 0);
+    mutex doneMutex;
+    condition_variable doneChanged;
+    atomic<size_t> nextItem{0};
+
+    // Items are taken in chunks of up to BIT_SLICE_LANES, small enough to keep
+    // every worker busy, and each chunk is solved together (see bit_slice.h)
+    if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+    threads = static_cast<unsigned>(min<size_t>(threads, max<size_t>(count, 1)));
+    size_t chunk = clamp<size_t>(count / (threads * 4), 1, BIT_SLICE_LANES);
+
+    // Every worker owns one solver context and pulls the next unsolved chunk
+    auto worker = [&]() {
+        SolverContext context;
+        context.setResultCache(cache);
+        context.setMemoryBudget(memoryBudget);
+        context.setDetailedStats(recorder != nullptr); // Phase times for the records
+        vector<Problem> problems;
+        vector<size_t> loaded;
+        vector<string> chunkLines;
+        vector<double> chunkLatencies;
+        vector<char> chunkFailed;
+        for (size_t first = nextItem.fetch_add(chunk); first < count; first = nextItem.fetch_add(chunk)) {
+            size_t last = min(count, first + chunk);
+            chunkLines.assign(last - first, string());
+            chunkLatencies.assign(last - first, 0);
+            chunkFailed.assign(last - first, 0);
+            problems.clear();
+            loaded.clear();
+            for (size_t i = first; i < last; i++) {
+                auto loadStart = chrono::steady_clock::now();
+                problems.emplace_back();
+                if (loadItem(items[i], problems.back(), chunkLines[i - first])) {
+                    loaded.push_back(i);
+                } else {
+                    problems.pop_back();
+                    chunkFailed[i - first] = 1;
+                }
+                chunkLatencies[i - first] =
+                    chrono::duration<double, milli>(chrono::steady_clock::now() - loadStart).count();
+            }
+
+            // Every problem is timed on its own (see solveBitSliced)
+            TraceSpan chunkSpan("solve_chunk", "problems", static_cast<long long>(loaded.size()));
+            vector<QMResult> results;
+            vector<chrono::nanoseconds> solveTimes;
+            try {
+                results = solveBitSliced(problems, context, &solveTimes);
+            }
+            catch (const exception&) {
+                results.clear(); // Solved one by one below, so the error lands on its own item
+            }
+            bool sliced = !results.empty();
+            if (!sliced) {
+                results.resize(loaded.size());
+                solveTimes.assign(loaded.size(), chrono::nanoseconds(0));
+            }
+            vector<char> solved(loaded.size(), 0);
+            for (size_t p = 0; p < loaded.size(); p++) {
+                const BatchItem& item = items[loaded[p]];
+                string& line = chunkLines[loaded[p] - first];
+                auto solveStart = chrono::steady_clock::now();
+                try {
+                    if (!sliced) results[p] = solve(problems[p], context);
+                    solved[p] = 1;
+                    chunkFailed[loaded[p] - first] = !finishItem(item, results[p], line);
+                }
+                catch (const exception& e) {
+                    line = formatError(item.name, e.what());
+                    chunkFailed[loaded[p] - first] = 1;
+                }
+                solveTimes[p] += chrono::steady_clock::now() - solveStart;
+                chunkLatencies[loaded[p] - first] += chrono::duration<double, milli>(solveTimes[p]).count();
+            }
+
+            for (size_t p = 0; recorder && p < loaded.size(); p++) {
+                if (!solved[p]) continue;
+                auto latency = chrono::duration_cast<chrono::nanoseconds>(
+                    chrono::duration<double, milli>(chunkLatencies[loaded[p] - first]));
+                if (recorder->isSlow(latency)) recorder->record(items[loaded[p]].name, problems[p], results[p], latency, memoryBudget);
+            }
+
+            {
+                lock_guard<mutex> lock(doneMutex);
+                for (size_t i = first; i < last; i++) {
+                    lines[i] = move(chunkLines[i - first]);
+                    latencies[i] = chunkLatencies[i - first];
+                    failed[i] = chunkFailed[i - first];
+                    done[i] = 1;
+                }
+            }
+            doneChanged.notify_one();
+        }
+    };
+
+    vector<thread> pool;
+    for (unsigned t = 0; t < threads; t++) pool.emplace_back(worker);
+
+    // Write results as soon as the next one in input order is done
+    BatchSummary summary;
+    summary.problems = count;
+    for (size_t i = 0; i < count; i++) {
+        string line;
+        {
+            unique_lock<mutex> lock(doneMutex);
+            doneChanged.wait(lock, [&]() { return done[i] != 0; });
+            line = move(lines[i]);
+        }
+        TraceSpan span("write_result", "item", static_cast<long long>(i));
+        out << line << "\n";
+        if (failed[i]) summary.failures++;
+    }
+    out.flush();
+    for (thread& t : pool) t.join();
+
+    summarize(summary, latencies, start);
+    return summary;
+}
+
+// The parts of a result that formatResult needs, from its packed form
+static QMResult unpackResult(const PackedResult& packed) {
+    QMResult result;
+    result.variables = packed.variables;
+    for (PackedCube cube : packed.cover) result.cover.push_back(unpackCube(cube, packed.variables));
+    for (const vector<uint32_t>& terms : packed.outputTerms) {
+        result.outputTerms.push_back(vector<size_t>(terms.begin(), terms.end()));
+    }
+    return result;
+}
+
+// Loads the problems here and sends them all down one connection from a
+// second thread, while this one collects the responses
+BatchSummary runRemoteBatch(BatchSource source, const string& path, ostream& out, const string& socketPath,
+                            uint32_t timeLimitMs) {
+    auto start = chrono::steady_clock::now();
+    unique_ptr<MappedFile> file;
+    string standardInput;
+    vector<BatchItem> items = sourceItems(source, path, file, standardInput);
+    ServerConnection connection(socketPath);
+
+    size_t count = items.size();
+    vector<string> lines(count);
+    vector<double> latencies(count);
+    vector<char> failed(count, 0);
+    vector<char> answered(count, 0);
+    vector<chrono::steady_clock::time_point> sent(count);
+    mutex sentMutex;
+    string sendError;
+
+    thread sender([&]() {
+        try {
+            for (size_t i = 0; i < count; i++) {
+                Problem problem;
+                string line;
+                bool loaded = loadItem(items[i], problem, line);
+                {
+                    lock_guard<mutex> lock(sentMutex);
+                    sent[i] = chrono::steady_clock::now();
+                    if (!loaded) {
+                        lines[i] = move(line);
+                        failed[i] = 1;
+                        answered[i] = 1;
+                        continue;
+                    }
+                }
+                // Not under the lock: send() blocks while the server holds back
+                // reading until the receiver has taken enough responses
+                connection.send(i, problem, timeLimitMs);
+            }
+        }
+        catch (const exception& e) {
+            lock_guard<mutex> lock(sentMutex);
+            sendError = e.what();
+        }
+        connection.finishSending();
+    });
+
+    ServerResponse response;
+    string receiveError;
+    try {
+        while (connection.receive(response)) {
+            size_t i;
+            {
+                lock_guard<mutex> lock(sentMutex);
+                if (response.id >= count || answered[response.id]) {
+                    receiveError = response.message.empty() ? "Unexpected response from the server" : response.message;
+                    continue;
+                }
+                i = static_cast<size_t>(response.id);
+                latencies[i] = chrono::duration<double, milli>(chrono::steady_clock::now() - sent[i]).count();
+                answered[i] = 1;
+            }
+            // Once answered, only this thread touches the line of a problem
+            if (response.status == ResponseStatus::Solved) {
+                lines[i] = formatResult(items[i].name, unpackResult(response.result));
+            } else {
+                lines[i] = formatError(items[i].name, response.message);
+                failed[i] = 1;
+            }
+        }
+    }
+    catch (const exception& e) {
+        receiveError = e.what();
+    }
+    sender.join();
+
+    BatchSummary summary;
+    summary.problems = count;
+    for (size_t i = 0; i < count; i++) {
+        if (!answered[i]) {
+            string reason = !sendError.empty()      ? sendError
+                            : !receiveError.empty() ? receiveError
+                                                    : "No response from the server";
+            lines[i] = formatError(items[i].name, reason);
+            failed[i] = 1;
+        }
+        out << lines[i] << "\n";
+        if (failed[i]) summary.failures++;
+    }
+    out.flush();
+    summarize(summary, latencies, start);
+    return summary;
+}
+
+// Prints throughput and latency percentiles
+void printBatchSummary(const BatchSummary& summary, ostream& out) {
+    out << fixed << setprecision(3);
+    out << "Batch: " << summary.problems << " problems (" << summary.failures << " failed) in "
+        << summary.seconds << " s, "
+        << (summary.seconds > 0 ? summary.problems / summary.seconds : 0) << " problems/s\n";
+    out << "Latency (ms): p50 " << summary.p50 << ", p90 " << summary.p90 << ", p99 " << summary.p99
+        << ", max " << summary.max << "\n";
+    out << defaultfloat;
+}
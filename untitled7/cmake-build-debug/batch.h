@@ -0,0 +1,57 @@
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+
+class FlightRecorder;
+class ResultCache;
+
+// Batch mode: solves many problems on a pool of worker threads and writes one
+// line per problem, in input order, e.g. "adder.txt: F = AB + C'".
+//
+// Problems come from
+//   Directory - every regular file of a directory, by file name
+//   Manifest  - a text file naming one problem file per line (blank lines and
+//               lines starting with '#' are skipped; relative paths are taken
+//               relative to the manifest)
+//   Stream    - one text file ("-" = standard input) holding several problems
+//               separated by lines that contain only "---"
+enum class BatchSource { Directory, Manifest, Stream };
+
+struct BatchSummary {
+    size_t problems = 0;
+    size_t failures = 0;      // Problems that could not be loaded or were invalid
+    double seconds = 0;       // Wall time of the whole run
+    double p50 = 0;           // Per-problem latency percentiles (load + solve, see runBatch) in milliseconds
+    double p90 = 0;
+    double p99 = 0;
+    double max = 0;
+};
+
+// Runs a batch; threads = 0 uses one worker per hardware thread. All workers
+// share cache when one is given; memoryBudget caps the scratch memory of every
+// solve (see QM::setMemoryBudget, 0 = no cap), and problems that run out of it
+// count as failures. Problems are solved in chunks (see bit_slice.h);
+// a problem's latency counts its load, its solve (timed on its own except in
+// the lanes the bit-sliced kernel finishes by itself, see solveBitSliced) and
+// its output. Throws runtime_error if the source itself cannot be read.
+// Slow problems go to recorder when one is given (see flight_recorder.h),
+// judged by that latency.
+BatchSummary runBatch(BatchSource source, const std::string& path, std::ostream& out, unsigned threads = 0,
+                      ResultCache* cache = nullptr, size_t memoryBudget = 0, FlightRecorder* recorder = nullptr);
+
+// Runs a batch on the server listening on socketPath (see server.h): problems
+// are loaded here and all sent on one connection without waiting for answers,
+// with timeLimitMs for every solve (0 = the server's default). A problem's
+// latency runs from sending it to its response. Throws runtime_error if the
+// source cannot be read or the server cannot be reached.
+BatchSummary runRemoteBatch(BatchSource source, const std::string& path, std::ostream& out,
+                            const std::string& socketPath, uint32_t timeLimitMs = 0);
+
+// Prints throughput and latency percentiles
+void printBatchSummary(const BatchSummary& summary, std::ostream& out);
+
+#endif // BATCH_H
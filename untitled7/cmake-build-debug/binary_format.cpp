@@ -0,0 +1,391 @@
+#include "binary_format.h"
+#include <bit>
+#include <fstream>
+#include <stdexcept>
+
+using namespace std;
+
+static const char PROBLEM_MAGIC[4] = {'Q', 'M', 'C', 'P'};
+static const char RESULT_MAGIC[4] = {'Q', 'M', 'C', 'R'};
+
+// Converts a solver result into packed form
+PackedResult packResult(const QMResult& result) {
+    PackedResult packed;
+    packed.variables = result.variables;
+    for (const string& pi : result.primeImplicants) packed.primes.push_back(packCube(pi));
+    for (const string& epi : result.essentialPrimeImplicants) packed.essentials.push_back(packCube(epi));
+    for (const string& term : result.cover) packed.cover.push_back(packCube(term));
+    for (const vector<string>& solution : result.alternatives) {
+        vector<PackedCube> alternative;
+        for (const string& pi : solution) alternative.push_back(packCube(pi));
+        packed.alternatives.push_back(alternative);
+    }
+    packed.primeTags.assign(result.primeTags.begin(), result.primeTags.end());
+    for (const vector<size_t>& terms : result.outputTerms) {
+        packed.outputTerms.push_back(vector<uint32_t>(terms.begin(), terms.end()));
+    }
+    return packed;
+}
+
+void BinaryWriter::u8(uint8_t value) {
+    buffer.push_back(static_cast<char>(value));
+}
+
+void BinaryWriter::u16(uint16_t value) {
+    for (int i = 0; i < 2; i++) u8(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+void BinaryWriter::u32(uint32_t value) {
+    for (int i = 0; i < 4; i++) u8(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+void BinaryWriter::u64(uint64_t value) {
+    for (int i = 0; i < 8; i++) u8(static_cast<uint8_t>(value >> (8 * i)));
+}
+
+// LEB128: seven bits per byte, high bit set on every byte but the last
+void BinaryWriter::varint(uint64_t value) {
+    while (value >= 0x80) {
+        u8(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    u8(static_cast<uint8_t>(value));
+}
+
+void BinaryWriter::cube(PackedCube cube) {
+    u32(cube.value);
+    u32(cube.care);
+}
+
+void BinaryWriter::raw(string_view data) {
+    buffer.append(data);
+}
+
+void BinaryWriter::writeToFile(const string& filename) const {
+    ofstream out(filename, ios::binary | ios::trunc);
+    if (!out.is_open()) {
+        throw runtime_error("Could not open file for writing: " + filename);
+    }
+    out.write(buffer.data(), static_cast<streamsize>(buffer.size()));
+    if (!out) {
+        throw runtime_error("Could not write file: " + filename);
+    }
+}
+
+uint8_t BinaryReader::u8() {
+    if (position >= data.size()) {
+        throw runtime_error("Truncated binary file");
+    }
+    return static_cast<uint8_t>(data[position++]);
+}
+
+uint16_t BinaryReader::u16() {
+    uint16_t value = u8();
+    return static_cast<uint16_t>(value | (u8() << 8));
+}
+
+uint32_t BinaryReader::u32() {
+    uint32_t value = 0;
+    for (int i = 0; i < 4; i++) value |= static_cast<uint32_t>(u8()) << (8 * i);
+    return value;
+}
+
+uint64_t BinaryReader::u64() {
+    uint64_t value = 0;
+    for (int i = 0; i < 8; i++) value |= static_cast<uint64_t>(u8()) << (8 * i);
+    return value;
+}
+
+uint64_t BinaryReader::varint() {
+    uint64_t value = 0;
+    for (int shift = 0; shift < 64; shift += 7) {
+        uint8_t byte = u8();
+        value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) return value;
+    }
+    throw runtime_error("Malformed varint in binary file");
+}
+
+PackedCube BinaryReader::cube() {
+    PackedCube cube;
+    cube.value = u32();
+    cube.care = u32();
+    return cube;
+}
+
+string_view BinaryReader::raw(size_t size) {
+    if (size > data.size() - position) {
+        throw runtime_error("Truncated binary file");
+    }
+    string_view result = data.substr(position, size);
+    position += size;
+    return result;
+}
+
+// Encodes a sorted term list with whichever encoding is smaller
+static void writeTerms(BinaryWriter& writer, const vector<int>& terms, int variables) {
+    BinaryWriter deltas;
+    int previous = 0;
+    for (int term : terms) {
+        deltas.varint(static_cast<uint64_t>(term - previous));
+        previous = term;
+    }
+
+    size_t bitmapBytes = ((size_t(1) << variables) + 7) / 8;
+    if (bitmapBytes < deltas.bytes().size()) {
+        string bitmap(bitmapBytes, '\0');
+        for (int term : terms) {
+            bitmap[term / 8] = static_cast<char>(bitmap[term / 8] | (1 << (term % 8)));
+        }
+        writer.u8(TERMS_BITMAP);
+        writer.u32(static_cast<uint32_t>(terms.size()));
+        writer.u32(static_cast<uint32_t>(bitmap.size()));
+        writer.raw(bitmap);
+    } else {
+        writer.u8(TERMS_DELTA_VARINT);
+        writer.u32(static_cast<uint32_t>(terms.size()));
+        writer.u32(static_cast<uint32_t>(deltas.bytes().size()));
+        writer.raw(deltas.bytes());
+    }
+}
+
+// Decodes one term list; the result is sorted, unique and in range by construction
+static vector<int> readTerms(BinaryReader& reader, int variables) {
+    uint8_t encoding = reader.u8();
+    uint32_t count = reader.u32();
+    uint32_t payloadBytes = reader.u32();
+    string_view payload = reader.raw(payloadBytes);
+    int totalTerms = 1 << variables;
+
+    // Check the count before trusting it with an allocation: a list holds
+    // each term once, and a delta list takes at least one byte per term
+    if (count > static_cast<uint32_t>(totalTerms) ||
+        (encoding == TERMS_DELTA_VARINT && count > payload.size())) {
+        throw runtime_error("Term count does not match the term list");
+    }
+    vector<int> terms;
+    terms.reserve(count);
+    if (encoding == TERMS_BITMAP) {
+        if (payload.size() != (static_cast<size_t>(totalTerms) + 7) / 8) {
+            throw runtime_error("Bitmap size does not match the number of variables");
+        }
+        // Scan eight bytes at a time and visit only the set bits
+        for (size_t base = 0; base < payload.size(); base += 8) {
+            uint64_t word = 0;
+            for (size_t i = 0; i < 8 && base + i < payload.size(); i++) {
+                word |= static_cast<uint64_t>(static_cast<uint8_t>(payload[base + i])) << (8 * i);
+            }
+            while (word != 0) {
+                int term = static_cast<int>(base * 8) + countr_zero(word);
+                if (term >= totalTerms) throw runtime_error("Bitmap has bits beyond the last term");
+                terms.push_back(term);
+                word &= word - 1;
+            }
+        }
+    } else if (encoding == TERMS_DELTA_VARINT) {
+        BinaryReader deltas(payload);
+        uint64_t term = 0;
+        while (!deltas.atEnd()) {
+            uint64_t delta = deltas.varint();
+            if (!terms.empty() && delta == 0) throw runtime_error("Term list is not strictly increasing");
+            // A delta this large is out of range whatever it is added to, and
+            // rejecting it here keeps the sum from wrapping around
+            if (delta >= static_cast<uint64_t>(totalTerms)) {
+                throw invalid_argument("Error: Term delta " + to_string(delta) + " is out of range (0-" +
+                                       to_string(totalTerms - 1) + ")");
+            }
+            term += delta;
+            if (term >= static_cast<uint64_t>(totalTerms)) {
+                throw invalid_argument("Error: Term " + to_string(term) + " is out of range (0-" +
+                                       to_string(totalTerms - 1) + ")");
+            }
+            terms.push_back(static_cast<int>(term));
+        }
+    } else {
+        throw runtime_error("Unknown term list encoding " + to_string(encoding));
+    }
+
+    if (terms.size() != count) {
+        throw runtime_error("Term count does not match the term list");
+    }
+    return terms;
+}
+
+bool isBinaryProblem(string_view data) {
+    return data.size() >= 4 && data.substr(0, 4) == string_view(PROBLEM_MAGIC, 4);
+}
+
+// Reads a binary problem; lists come out normalized, so only overlaps need checking
+Problem parseBinaryProblem(string_view data) {
+    BinaryReader reader(data);
+    reader.raw(4);
+    uint16_t version = reader.u16();
+    if (version != BINARY_FORMAT_VERSION) {
+        throw runtime_error("Unsupported binary problem version " + to_string(version));
+    }
+
+    Problem problem;
+    problem.variables = reader.u8();
+    if (problem.variables < 1 || problem.variables > 20) {
+        throw runtime_error("Number of variables must be between 1 and 20");
+    }
+    uint8_t flags = reader.u8();
+    problem.fromMaxterms = (flags & BINARY_FLAG_FROM_MAXTERMS) != 0;
+
+    uint32_t outputs = reader.u32();
+    if (outputs > 64) {
+        throw runtime_error("Number of outputs must be between 1 and 64");
+    }
+    if (outputs == 0) {
+        problem.minterms = readTerms(reader, problem.variables);
+        problem.dontCares = readTerms(reader, problem.variables);
+    } else {
+        for (uint32_t k = 0; k < outputs; k++) {
+            problem.outputMinterms.push_back(readTerms(reader, problem.variables));
+            problem.outputDontCares.push_back(readTerms(reader, problem.variables));
+        }
+    }
+
+    validateProblem(problem);
+    return problem;
+}
+
+// Writes the problem header and term lists
+static void writeProblem(BinaryWriter& writer, const Problem& problem) {
+    writer.raw(string_view(PROBLEM_MAGIC, 4));
+    writer.u16(BINARY_FORMAT_VERSION);
+    writer.u8(static_cast<uint8_t>(problem.variables));
+    writer.u8(problem.fromMaxterms ? BINARY_FLAG_FROM_MAXTERMS : 0);
+    writer.u32(static_cast<uint32_t>(problem.outputMinterms.size()));
+    if (!problem.isMultiOutput()) {
+        writeTerms(writer, problem.minterms, problem.variables);
+        writeTerms(writer, problem.dontCares, problem.variables);
+    } else {
+        for (size_t k = 0; k < problem.outputMinterms.size(); k++) {
+            writeTerms(writer, problem.outputMinterms[k], problem.variables);
+            writeTerms(writer, problem.outputDontCares[k], problem.variables);
+        }
+    }
+}
+
+string encodeBinaryProblem(const Problem& problem) {
+    BinaryWriter writer;
+    writeProblem(writer, problem);
+    return writer.bytes();
+}
+
+void writeBinaryProblem(const Problem& problem, const string& filename) {
+    BinaryWriter writer;
+    writeProblem(writer, problem);
+    writer.writeToFile(filename);
+}
+
+bool isBinaryResult(string_view data) {
+    return data.size() >= 4 && data.substr(0, 4) == string_view(RESULT_MAGIC, 4);
+}
+
+// Reads a cube list: u32 count followed by the cubes. Like term lists, cubes
+// are checked against the number of variables, since unpackCube and the
+// canonical transforms trust them: no bits beyond the last variable, and
+// values only where the cube cares.
+static vector<PackedCube> readCubes(BinaryReader& reader, int variables) {
+    uint32_t count = reader.u32();
+    if (count > reader.remaining() / 8) {
+        throw runtime_error("Cube count does not match the result");
+    }
+    uint32_t allVariables = (uint32_t(1) << variables) - 1;
+    vector<PackedCube> cubes;
+    cubes.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+        PackedCube cube = reader.cube();
+        if ((cube.care & ~allVariables) != 0 || (cube.value & ~cube.care) != 0) {
+            throw runtime_error("Cube does not fit the number of variables");
+        }
+        cubes.push_back(cube);
+    }
+    return cubes;
+}
+
+static void writeCubes(BinaryWriter& writer, const vector<PackedCube>& cubes) {
+    writer.u32(static_cast<uint32_t>(cubes.size()));
+    for (const PackedCube& cube : cubes) {
+        writer.cube(cube);
+    }
+}
+
+PackedResult parseBinaryResult(string_view data) {
+    if (!isBinaryResult(data)) {
+        throw runtime_error("Not a binary result file");
+    }
+    BinaryReader reader(data);
+    reader.raw(4);
+    uint16_t version = reader.u16();
+    if (version != BINARY_FORMAT_VERSION) {
+        throw runtime_error("Unsupported binary result version " + to_string(version));
+    }
+
+    PackedResult result;
+    result.variables = reader.u8();
+    if (result.variables < 1 || result.variables > 20) {
+        throw runtime_error("Number of variables must be between 1 and 20");
+    }
+    bool multiOutput = (reader.u8() & BINARY_FLAG_MULTI_OUTPUT) != 0;
+    result.primes = readCubes(reader, result.variables);
+    if (multiOutput) {
+        for (size_t i = 0; i < result.primes.size(); i++) {
+            result.primeTags.push_back(reader.u64());
+        }
+    }
+    result.essentials = readCubes(reader, result.variables);
+    result.cover = readCubes(reader, result.variables);
+    uint32_t alternatives = reader.u32();
+    for (uint32_t i = 0; i < alternatives; i++) {
+        result.alternatives.push_back(readCubes(reader, result.variables));
+    }
+    if (multiOutput) {
+        uint32_t outputs = reader.u32();
+        for (uint32_t k = 0; k < outputs; k++) {
+            uint32_t count = reader.u32();
+            if (count > result.cover.size() || count > reader.remaining() / 4) {
+                throw runtime_error("Output term count does not match the result");
+            }
+            vector<uint32_t> terms(count);
+            for (uint32_t& term : terms) {
+                term = reader.u32();
+                if (term >= result.cover.size()) throw runtime_error("Output term index out of range");
+            }
+            result.outputTerms.push_back(terms);
+        }
+    }
+    return result;
+}
+
+string encodeBinaryResult(const PackedResult& result) {
+    BinaryWriter writer;
+    writer.raw(string_view(RESULT_MAGIC, 4));
+    writer.u16(BINARY_FORMAT_VERSION);
+    writer.u8(static_cast<uint8_t>(result.variables));
+    writer.u8(result.isMultiOutput() ? BINARY_FLAG_MULTI_OUTPUT : 0);
+    writeCubes(writer, result.primes);
+    if (result.isMultiOutput()) {
+        for (uint64_t tag : result.primeTags) {
+            writer.u64(tag);
+        }
+    }
+    writeCubes(writer, result.essentials);
+    writeCubes(writer, result.cover);
+    writer.u32(static_cast<uint32_t>(result.alternatives.size()));
+    for (const vector<PackedCube>& alternative : result.alternatives) {
+        writeCubes(writer, alternative);
+    }
+    if (result.isMultiOutput()) {
+        writer.u32(static_cast<uint32_t>(result.outputTerms.size()));
+        for (const vector<uint32_t>& terms : result.outputTerms) {
+            writer.u32(static_cast<uint32_t>(terms.size()));
+            for (uint32_t term : terms) {
+                writer.u32(term);
+            }
+        }
+    }
+    return writer.bytes();
+}
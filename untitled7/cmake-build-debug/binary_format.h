@@ -0,0 +1,101 @@
+#ifndef BINARY_FORMAT_H
+#define BINARY_FORMAT_H
+
+#include "cube_table.h"
+#include "problem.h"
+#include "qm_result.h"
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Versioned binary problem and result files (all integers little endian).
+//
+// Problem file: "QMCP", u16 version, u8 variables, u8 flags, u32 outputs
+// (0 = single output), then the term lists (ON, DC; or ON, DC per output).
+// Each list is: u8 encoding, u32 term count, u32 payload bytes, payload, where
+// the payload is a bitmap of 2^variables bits or delta-varint encoded terms.
+//
+// Result file: "QMCR", u16 version, u8 variables, u8 flags, then the primes,
+// essential primes, chosen cover and alternatives as packed cubes, and for
+// multi-output results the output tag of every prime and the terms per output.
+const uint16_t BINARY_FORMAT_VERSION = 1;
+
+// Problem header flags
+const uint8_t BINARY_FLAG_FROM_MAXTERMS = 1;
+// Result header flags
+const uint8_t BINARY_FLAG_MULTI_OUTPUT = 1;
+
+// Term list encodings
+const uint8_t TERMS_DELTA_VARINT = 0;
+const uint8_t TERMS_BITMAP = 1;
+
+// A minimization result in packed form
+struct PackedResult {
+    int variables = 0;
+    std::vector<PackedCube> primes;
+    std::vector<PackedCube> essentials;
+    std::vector<PackedCube> cover;
+    std::vector<std::vector<PackedCube>> alternatives; // Non-essential part of each minimal solution
+
+    // Multi-output results: output tag of every prime, and indices into cover per output
+    std::vector<uint64_t> primeTags;
+    std::vector<std::vector<uint32_t>> outputTerms;
+
+    bool isMultiOutput() const { return !outputTerms.empty(); }
+};
+
+// Converts a solver result into packed form
+PackedResult packResult(const QMResult& result);
+
+// Appends little endian integers to a byte buffer
+class BinaryWriter {
+public:
+    void u8(uint8_t value);
+    void u16(uint16_t value);
+    void u32(uint32_t value);
+    void u64(uint64_t value);
+    void varint(uint64_t value);
+    void cube(PackedCube cube);
+    void raw(std::string_view data);
+
+    const std::string& bytes() const { return buffer; }
+    void writeToFile(const std::string& filename) const;
+
+private:
+    std::string buffer;
+};
+
+// Reads little endian integers from a byte buffer; throws runtime_error when truncated
+class BinaryReader {
+public:
+    explicit BinaryReader(std::string_view data) : data(data) {}
+
+    uint8_t u8();
+    uint16_t u16();
+    uint32_t u32();
+    uint64_t u64();
+    uint64_t varint();
+    PackedCube cube();
+    std::string_view raw(size_t size);
+
+    bool atEnd() const { return position == data.size(); }
+    size_t remaining() const { return data.size() - position; }
+
+private:
+    std::string_view data;
+    size_t position = 0;
+};
+
+// Problems
+bool isBinaryProblem(std::string_view data);
+Problem parseBinaryProblem(std::string_view data);
+std::string encodeBinaryProblem(const Problem& problem);
+void writeBinaryProblem(const Problem& problem, const std::string& filename);
+
+// Results
+bool isBinaryResult(std::string_view data);
+PackedResult parseBinaryResult(std::string_view data);
+std::string encodeBinaryResult(const PackedResult& result);
+
+#endif // BINARY_FORMAT_H
@@ -0,0 +1,238 @@
+#include "bit_slice.h"
+#include "canonical.h"
+#include "cube_table.h"
+#include "result_cache.h"
+#include "small_table.h"
+#include "trace.h"
+#include <array>
+#include <cstdint>
+
+using namespace std;
+
+// Every cube of one width in the order of their strings ('-' < '0' < '1'),
+// with the neighbours the kernel combines. The cube with key k has base 3
+// digit i (weight 3^i) for variable bit i: 0 = '-', 1 = '0', 2 = '1'.
+struct SliceLayout {
+    vector<PackedCube> cubes;
+    vector<int> dashWeight;       // 3^i of the lowest dash, 0 for a single term
+    vector<int> term;             // The term of a cube without dashes
+    vector<int> parentStart;      // parents[parentStart[k]..parentStart[k + 1]) are the
+    vector<int> parents;          // cubes with one more dash than k that contain it
+    vector<int> covering;         // covering[t << variables | s]: cube with dashes s containing term t
+};
+
+static SliceLayout makeLayout(int variables) {
+    int count = 1;
+    for (int i = 0; i < variables; i++) count *= 3;
+
+    SliceLayout layout;
+    for (int key = 0; key < count; key++) {
+        PackedCube cube{0, 0};
+        int lowestDash = 0;
+        layout.parentStart.push_back(static_cast<int>(layout.parents.size()));
+        for (int i = 0, weight = 1, digits = key; i < variables; i++, weight *= 3, digits /= 3) {
+            int digit = digits % 3;
+            if (digit == 0 && lowestDash == 0) lowestDash = weight;
+            if (digit != 0) {
+                cube.care |= 1u << i;
+                layout.parents.push_back(key - digit * weight);
+            }
+            if (digit == 2) cube.value |= 1u << i;
+        }
+        layout.cubes.push_back(cube);
+        layout.dashWeight.push_back(lowestDash);
+        layout.term.push_back(static_cast<int>(cube.value));
+    }
+    layout.parentStart.push_back(static_cast<int>(layout.parents.size()));
+
+    for (int t = 0; t < (1 << variables); t++) {
+        for (int dashes = 0; dashes < (1 << variables); dashes++) {
+            int key = 0;
+            for (int i = 0, weight = 1; i < variables; i++, weight *= 3) {
+                if (!(dashes & (1 << i))) key += ((t >> i) & 1 ? 2 : 1) * weight;
+            }
+            layout.covering.push_back(key);
+        }
+    }
+    return layout;
+}
+
+static const SliceLayout& sliceLayout(int variables) {
+    static const array<SliceLayout, BIT_SLICE_VARIABLES + 1> layouts = []() {
+        array<SliceLayout, BIT_SLICE_VARIABLES + 1> all;
+        for (int n = 1; n <= BIT_SLICE_VARIABLES; n++) all[n] = makeLayout(n);
+        return all;
+    }();
+    return layouts[variables];
+}
+
+// Solves up to BIT_SLICE_LANES problems of the same width: lane j is
+// *problems[j], its result goes to results[lanes[j]] and its time is added to
+// latencies[lanes[j]]
+static void solveLanes(const vector<const Problem*>& problems, const vector<size_t>& lanes, int variables,
+                       SolverContext& context, QM& solver, vector<QMResult>& results,
+                       vector<chrono::nanoseconds>& latencies) {
+    TraceSpan span("bit_slice_lanes", "lanes", static_cast<long long>(lanes.size()));
+    auto kernelStart = chrono::steady_clock::now();
+    const SliceLayout& layout = sliceLayout(variables);
+    size_t cubeCount = layout.cubes.size();
+    int terms = 1 << variables;
+
+    // One word per term: bit j is set when the term is in ON (or ON + DC) of lane j
+    vector<uint64_t> on(terms, 0);
+    vector<uint64_t> care(terms, 0);
+    for (size_t j = 0; j < lanes.size(); j++) {
+        uint64_t bit = uint64_t(1) << j;
+        for (int m : problems[j]->minterms) on[m] |= bit;
+        for (int d : problems[j]->dontCares) care[d] |= bit;
+    }
+    for (int t = 0; t < terms; t++) care[t] |= on[t];
+
+    // Implicants: a cube with a dash is an implicant when both halves are
+    vector<uint64_t> inside(cubeCount);
+    for (size_t k = cubeCount; k-- > 0;) {
+        int weight = layout.dashWeight[k];
+        inside[k] = weight ? inside[k + weight] & inside[k + 2 * weight] : care[layout.term[k]];
+    }
+    vector<uint64_t> prime(inside);
+    for (size_t k = 0; k < cubeCount; k++) {
+        for (int p = layout.parentStart[k]; p < layout.parentStart[k + 1]; p++) {
+            prime[k] &= ~inside[layout.parents[p]];
+        }
+    }
+
+    // Terms of ON covered by exactly one prime, and the essentials that cover them
+    vector<uint64_t> single(terms, 0);
+    vector<uint64_t> essential(cubeCount, 0);
+    for (int t = 0; t < terms; t++) {
+        if (!on[t]) continue;
+        const int* covering = &layout.covering[t << variables];
+        uint64_t once = 0;
+        uint64_t twice = 0;
+        for (int s = 0; s < terms; s++) {
+            twice |= once & prime[covering[s]];
+            once |= prime[covering[s]];
+        }
+        single[t] = on[t] & ~twice;
+        for (int s = 0; s < terms; s++) essential[covering[s]] |= prime[covering[s]] & single[t];
+    }
+
+    // Lanes with minterms left after the essentials need the cover search
+    uint64_t residual = 0;
+    for (int t = 0; t < terms; t++) {
+        if (!on[t]) continue;
+        const int* covering = &layout.covering[t << variables];
+        uint64_t covered = 0;
+        for (int s = 0; s < terms; s++) covered |= essential[covering[s]];
+        residual |= on[t] & ~covered;
+    }
+
+    auto kernelShare = (chrono::steady_clock::now() - kernelStart) / lanes.size();
+
+    vector<PackedCube> primes;
+    vector<int> primeIndex(cubeCount);
+    vector<char> added;
+    for (size_t j = 0; j < lanes.size(); j++) {
+        auto laneStart = chrono::steady_clock::now();
+        uint64_t bit = uint64_t(1) << j;
+        const Problem& problem = *problems[j];
+        primes.clear();
+        for (size_t k = 0; k < cubeCount; k++) {
+            if (prime[k] & bit) {
+                primeIndex[k] = static_cast<int>(primes.size());
+                primes.push_back(layout.cubes[k]);
+            }
+        }
+
+        QMResult& result = results[lanes[j]];
+        auto& latency = latencies[lanes[j]];
+        if ((residual & bit) && variables <= SMALL_TABLE_VARIABLES) {
+            // The table of solve() beats the scalar cover steps here
+            result = solve(problem, context);
+            latency += kernelShare + (chrono::steady_clock::now() - laneStart);
+            continue;
+        }
+        if (residual & bit) {
+            solver.load(problem);
+            result = solver.solveFromPrimes(primes);
+            result.stats.bitSliced = true;
+            latency += kernelShare + (chrono::steady_clock::now() - laneStart);
+            continue;
+        }
+
+        result = QMResult();
+        result.variables = variables;
+        result.stats.bitSliced = true;
+        for (PackedCube cube : primes) result.primeImplicants.push_back(unpackCube(cube, variables));
+
+        // Essentials in the order solve() finds them: by their first minterm
+        added.assign(primes.size(), 0);
+        for (int m : problem.minterms) {
+            if (!(single[m] & bit)) continue;
+            const int* covering = &layout.covering[m << variables];
+            for (int s = 0; s < terms; s++) {
+                if (!(essential[covering[s]] & bit)) continue;
+                int index = primeIndex[covering[s]];
+                if (!added[index]) {
+                    added[index] = 1;
+                    result.essentialPrimeImplicants.push_back(result.primeImplicants[index]);
+                }
+                break;
+            }
+        }
+        result.cover = result.essentialPrimeImplicants;
+        latency += kernelShare + (chrono::steady_clock::now() - laneStart);
+    }
+}
+
+vector<QMResult> solveBitSliced(const vector<Problem>& problems, SolverContext& context,
+                                vector<chrono::nanoseconds>* latencies) {
+    vector<QMResult> results(problems.size());
+    vector<chrono::nanoseconds> times(problems.size());
+    ResultCache* cache = context.qm.cache();
+    vector<ResultCache::Key> keys(cache ? problems.size() : 0);
+    array<vector<size_t>, BIT_SLICE_VARIABLES + 1> lanes;
+    array<vector<const Problem*>, BIT_SLICE_VARIABLES + 1> laneProblems;
+
+    // Solves the lanes of one width; canonical lanes are stored and mapped back as solve() does
+    auto solveWidth = [&](int variables) {
+        solveLanes(laneProblems[variables], lanes[variables], variables, context, context.qm, results, times);
+        for (size_t i : lanes[variables]) {
+            if (!cache || keys[i].bytes.empty()) continue;
+            auto start = chrono::steady_clock::now();
+            cache->store(keys[i], results[i]);
+            results[i] = fromCanonical(results[i], keys[i].transform);
+            times[i] += chrono::steady_clock::now() - start;
+        }
+        lanes[variables].clear();
+        laneProblems[variables].clear();
+    };
+
+    for (size_t i = 0; i < problems.size(); i++) {
+        auto start = chrono::steady_clock::now();
+        const Problem& problem = problems[i];
+        int variables = problem.variables;
+        if (problem.isMultiOutput() || variables < 1 || variables > BIT_SLICE_VARIABLES) {
+            results[i] = solve(problem, context);
+            times[i] = chrono::steady_clock::now() - start;
+            continue;
+        }
+        // solve() answers functions up to the size of the small table from the table
+        const Problem* lane = &problem;
+        if (cache && variables > SMALL_TABLE_VARIABLES) {
+            keys[i] = ResultCache::key(problem);
+            bool hit = cache->lookup(keys[i], results[i]);
+            times[i] = chrono::steady_clock::now() - start;
+            if (hit) continue;
+            lane = &keys[i].canonical;
+        }
+        lanes[variables].push_back(i);
+        laneProblems[variables].push_back(lane);
+        if (lanes[variables].size() == BIT_SLICE_LANES) solveWidth(variables);
+    }
+    for (int variables = 1; variables <= BIT_SLICE_VARIABLES; variables++) {
+        if (!lanes[variables].empty()) solveWidth(variables);
+    }
+    if (latencies) *latencies = move(times);
+    return results;
+}
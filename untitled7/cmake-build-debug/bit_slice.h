@@ -0,0 +1,37 @@
+#ifndef BIT_SLICE_H
+#define BIT_SLICE_H
+
+#include <chrono>
+#include <cstddef>
+#include <vector>
+#include "problem.h"
+#include "qm.h"
+
+// Minimizes many small functions at once. The truth table of a function of up
+// to BIT_SLICE_VARIABLES variables fits in a 64-bit word, so BIT_SLICE_LANES
+// such functions of the same width are stored bit-sliced: one word per term,
+// bit j of it for function j. Prime detection (a cube is an implicant when all
+// its terms are in ON + DC, and prime when no cube with one more dash is) and
+// essential detection (terms covered by exactly one prime) then take a few
+// word operations per cube for all lanes together. Functions left with
+// uncovered minterms after their essentials finish on the scalar cover steps
+// (QM::solveFromPrimes) without generating their primes again, or, when they
+// are small enough, on the table of small_table.h.
+const int BIT_SLICE_VARIABLES = 6;
+const size_t BIT_SLICE_LANES = 64;
+
+// Solves validated problems exactly like solve() (stats aside). Single-output
+// problems of up to BIT_SLICE_VARIABLES variables go through the bit-sliced
+// kernel, grouped by width; the rest are solved one by one. With a result cache
+// in the context, functions that solve() would look up in the cache are looked
+// up first, and the misses are sliced in canonical form and stored.
+//
+// latencies, when given, receives the solve time of every problem. Problems
+// solved one by one, cache hits and lanes that need the scalar cover steps are
+// timed on their own (the lanes plus an even share of the kernel they went
+// through); only lanes the kernel finishes by itself have nothing of their own
+// to time, so they get their share of the kernel and of unpacking their result.
+std::vector<QMResult> solveBitSliced(const std::vector<Problem>& problems, SolverContext& context,
+                                     std::vector<std::chrono::nanoseconds>* latencies = nullptr);
+
+#endif // BIT_SLICE_H
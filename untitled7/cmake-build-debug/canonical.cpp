@@ -0,0 +1,325 @@
+#include "canonical.h"
+#include <algorithm>
+#include <bit>
+#include <numeric>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Exact canonicalization searches the pruned transforms directly up to this
+// many (each rebuilds the tables), and all n! 2^n transforms otherwise
+const size_t PRUNED_SEARCH_LIMIT = 256;
+
+// Moves bit permutation[j] of bits to bit j
+static uint32_t permuteBits(uint32_t bits, const InputTransform& transform) {
+    uint32_t permuted = 0;
+    for (int j = 0; j < transform.variables; j++) {
+        permuted |= ((bits >> transform.permutation[j]) & 1u) << j;
+    }
+    return permuted;
+}
+
+// Moves bit j of bits back to bit permutation[j]
+static uint32_t unpermuteBits(uint32_t bits, const InputTransform& transform) {
+    uint32_t original = 0;
+    for (int j = 0; j < transform.variables; j++) {
+        original |= ((bits >> j) & 1u) << transform.permutation[j];
+    }
+    return original;
+}
+
+uint32_t InputTransform::toCanonical(uint32_t term) const {
+    return permuteBits(term, *this) ^ negation;
+}
+
+uint32_t InputTransform::fromCanonical(uint32_t term) const {
+    return unpermuteBits(term ^ negation, *this);
+}
+
+PackedCube InputTransform::toCanonical(PackedCube cube) const {
+    uint32_t care = permuteBits(cube.care, *this);
+    return {permuteBits(cube.value, *this) ^ (negation & care), care};
+}
+
+PackedCube InputTransform::fromCanonical(PackedCube cube) const {
+    return {unpermuteBits(cube.value ^ (negation & cube.care), *this), unpermuteBits(cube.care, *this)};
+}
+
+// The term lists of a problem in a fixed order: ON and DC of every output
+static vector<const vector<int>*> termLists(const Problem& problem) {
+    vector<const vector<int>*> lists;
+    if (problem.isMultiOutput()) {
+        for (size_t k = 0; k < problem.outputMinterms.size(); k++) {
+            lists.push_back(&problem.outputMinterms[k]);
+            lists.push_back(&problem.outputDontCares[k]);
+        }
+    } else {
+        lists.push_back(&problem.minterms);
+        lists.push_back(&problem.dontCares);
+    }
+    return lists;
+}
+
+// How many terms of every list have each variable set, after negating every
+// variable whose terms lean to 0 (in the first list where they lean at all).
+// Tied variables lean nowhere, so negating them changes no count.
+struct VariableCounts {
+    vector<vector<int64_t>> ones;
+    uint32_t negated = 0;
+    uint32_t tied = 0;
+    vector<int> order; // Variables by decreasing counts; equal counts keep the original order
+};
+
+static VariableCounts countVariables(const Problem& problem) {
+    int n = problem.variables;
+    vector<const vector<int>*> lists = termLists(problem);
+
+    VariableCounts counts;
+    counts.ones.assign(n, vector<int64_t>(lists.size(), 0));
+    for (size_t l = 0; l < lists.size(); l++) {
+        for (int term : *lists[l]) {
+            for (int i = 0; i < n; i++) counts.ones[i][l] += (term >> i) & 1;
+        }
+    }
+
+    for (int i = 0; i < n; i++) {
+        counts.tied |= 1u << i;
+        for (size_t l = 0; l < lists.size(); l++) {
+            int64_t zeros = static_cast<int64_t>(lists[l]->size()) - counts.ones[i][l];
+            if (counts.ones[i][l] == zeros) continue;
+            counts.tied &= ~(1u << i);
+            if (counts.ones[i][l] < zeros) {
+                counts.negated |= 1u << i;
+                for (size_t k = 0; k < lists.size(); k++) {
+                    counts.ones[i][k] = static_cast<int64_t>(lists[k]->size()) - counts.ones[i][k];
+                }
+            }
+            break;
+        }
+    }
+
+    counts.order.resize(n);
+    iota(counts.order.begin(), counts.order.end(), 0);
+    stable_sort(counts.order.begin(), counts.order.end(),
+                [&](int a, int b) { return counts.ones[a] > counts.ones[b]; });
+    return counts;
+}
+
+// The transform putting the variables in order, with their negations
+static InputTransform orderTransform(const vector<int>& order, uint32_t negated) {
+    InputTransform transform;
+    transform.variables = static_cast<int>(order.size());
+    for (size_t j = 0; j < order.size(); j++) {
+        transform.permutation[j] = static_cast<uint8_t>(order[j]);
+        if (negated & (1u << order[j])) transform.negation |= 1u << j;
+    }
+    return transform;
+}
+
+// Truth tables of the lists (up to 6 variables) under a transform
+static void transformTables(const vector<const vector<int>*>& lists, const InputTransform& transform,
+                            vector<uint64_t>& tables) {
+    for (size_t l = 0; l < lists.size(); l++) {
+        tables[l] = 0;
+        for (int term : *lists[l]) tables[l] |= uint64_t(1) << transform.toCanonical(static_cast<uint32_t>(term));
+    }
+}
+
+// Searches only the transforms whose tables pass the ordering of countVariables
+// (every variable leaning to 1, counts not increasing); they are the same for
+// every function of a class. Returns false when there are more than limit.
+static bool prunedTransform(const Problem& problem, size_t limit, InputTransform& best) {
+    VariableCounts counts = countVariables(problem);
+    int n = problem.variables;
+
+    // Runs of equal counts may be permuted; tied variables may be negated
+    vector<pair<int, int>> runs;
+    size_t transforms = size_t(1) << popcount(counts.tied);
+    for (int start = 0; start < n;) {
+        int end = start + 1;
+        while (end < n && counts.ones[counts.order[end]] == counts.ones[counts.order[start]]) end++;
+        for (int k = 2; k <= end - start; k++) transforms *= k;
+        if (transforms > limit) return false;
+        runs.push_back({start, end});
+        start = end;
+    }
+
+    vector<const vector<int>*> lists = termLists(problem);
+    vector<uint64_t> tables(lists.size());
+    vector<uint64_t> bestTables;
+    vector<int> order = counts.order;
+    size_t run;
+    do {
+        InputTransform transform = orderTransform(order, counts.negated);
+        uint32_t tiedPositions = 0;
+        for (int j = 0; j < n; j++) {
+            if (counts.tied & (1u << order[j])) tiedPositions |= 1u << j;
+        }
+        uint32_t negation = transform.negation;
+        for (uint32_t flips = tiedPositions;; flips = (flips - 1) & tiedPositions) {
+            transform.negation = negation ^ flips;
+            transformTables(lists, transform, tables);
+            if (bestTables.empty() || tables < bestTables) {
+                bestTables = tables;
+                best = transform;
+            }
+            if (flips == 0) break;
+        }
+
+        // Next arrangement of the runs, like an odometer
+        for (run = 0; run < runs.size(); run++) {
+            if (next_permutation(order.begin() + runs[run].first, order.begin() + runs[run].second)) break;
+        }
+    } while (run < runs.size());
+    return true;
+}
+
+// Tries every permutation (Heap's algorithm, one swap per step) and every
+// negation (Gray code, one flip per step) on 64-bit truth tables and keeps the
+// transform giving the smallest tables
+static InputTransform fullTransform(const Problem& problem) {
+    int n = problem.variables;
+    vector<uint64_t> tables;
+    for (const vector<int>* list : termLists(problem)) {
+        uint64_t table = 0;
+        for (int term : *list) table |= uint64_t(1) << term;
+        tables.push_back(table);
+    }
+
+    // clear[i]: terms with bit i clear; only[i][j]: terms with bit i set and bit j clear
+    uint64_t clear[EXACT_CANONICAL_VARIABLES] = {};
+    uint64_t only[EXACT_CANONICAL_VARIABLES][EXACT_CANONICAL_VARIABLES] = {};
+    for (int t = 0; t < 64; t++) {
+        for (int i = 0; i < EXACT_CANONICAL_VARIABLES; i++) {
+            if (!(t & (1 << i))) clear[i] |= uint64_t(1) << t;
+            for (int j = 0; j < EXACT_CANONICAL_VARIABLES; j++) {
+                if ((t & (1 << i)) && !(t & (1 << j))) only[i][j] |= uint64_t(1) << t;
+            }
+        }
+    }
+
+    InputTransform current;
+    current.variables = n;
+    for (int j = 0; j < n; j++) current.permutation[j] = static_cast<uint8_t>(j);
+    InputTransform best = current;
+    vector<uint64_t> bestTables = tables;
+
+    auto consider = [&]() {
+        if (tables < bestTables) {
+            bestTables = tables;
+            best = current;
+        }
+    };
+    // Table of f(x ^ bit i)
+    auto flip = [&](int i) {
+        int shift = 1 << i;
+        for (uint64_t& table : tables) {
+            table = ((table >> shift) & clear[i]) | ((table & clear[i]) << shift);
+        }
+        current.negation ^= 1u << i;
+    };
+    // Table of f(x with bits i < j swapped)
+    auto swapVariables = [&](int i, int j) {
+        if (i > j) swap(i, j);
+        int shift = (1 << j) - (1 << i);
+        uint64_t up = only[i][j];
+        uint64_t down = only[j][i];
+        for (uint64_t& table : tables) {
+            table = (table & ~(up | down)) | ((table >> shift) & up) | ((table << shift) & down);
+        }
+        swap(current.permutation[i], current.permutation[j]);
+        uint32_t bits = ((current.negation >> i) ^ (current.negation >> j)) & 1u;
+        current.negation ^= (bits << i) | (bits << j);
+    };
+    // The Gray code ends at the top bit, which the last flip clears again
+    auto visitNegations = [&]() {
+        consider();
+        for (uint32_t k = 1; k < (1u << n); k++) {
+            flip(countr_zero(k));
+            consider();
+        }
+        flip(n - 1);
+    };
+
+    vector<int> counters(n, 0);
+    visitNegations();
+    for (int i = 1; i < n;) {
+        if (counters[i] < i) {
+            swapVariables(i % 2 == 0 ? 0 : counters[i], i);
+            visitNegations();
+            counters[i]++;
+            i = 1;
+        } else {
+            counters[i] = 0;
+            i++;
+        }
+    }
+    return best;
+}
+
+// Exact: the smallest tables over the pruned transforms when there are few of
+// them (most functions), otherwise over all transforms. Which search runs
+// depends only on the counts, so functions of one class agree on it.
+static InputTransform exactTransform(const Problem& problem) {
+    InputTransform transform;
+    if (prunedTransform(problem, PRUNED_SEARCH_LIMIT, transform)) return transform;
+    return fullTransform(problem);
+}
+
+// The ordering of countVariables alone; ties keep the original order
+static InputTransform heuristicTransform(const Problem& problem) {
+    VariableCounts counts = countVariables(problem);
+    return orderTransform(counts.order, counts.negated);
+}
+
+Problem canonicalProblem(const Problem& problem, InputTransform& transform) {
+    transform = problem.variables <= EXACT_CANONICAL_VARIABLES ? exactTransform(problem)
+                                                               : heuristicTransform(problem);
+
+    auto mapTerms = [&](const vector<int>& terms) {
+        vector<int> mapped;
+        mapped.reserve(terms.size());
+        for (int term : terms) mapped.push_back(static_cast<int>(transform.toCanonical(static_cast<uint32_t>(term))));
+        sort(mapped.begin(), mapped.end());
+        return mapped;
+    };
+    Problem canonical;
+    canonical.variables = problem.variables;
+    canonical.minterms = mapTerms(problem.minterms);
+    canonical.dontCares = mapTerms(problem.dontCares);
+    for (size_t k = 0; k < problem.outputMinterms.size(); k++) {
+        canonical.outputMinterms.push_back(mapTerms(problem.outputMinterms[k]));
+        canonical.outputDontCares.push_back(mapTerms(problem.outputDontCares[k]));
+    }
+    return canonical;
+}
+
+// Maps every cube and minterm of a result with the given functions
+template <typename MapCube, typename MapTerm>
+static QMResult mapResult(const QMResult& result, MapCube mapCube, MapTerm mapTerm) {
+    auto mapCubes = [&](const vector<string>& cubes) {
+        vector<string> mapped;
+        mapped.reserve(cubes.size());
+        for (const string& cube : cubes) mapped.push_back(unpackCube(mapCube(packCube(cube)), result.variables));
+        return mapped;
+    };
+    QMResult mapped = result;
+    mapped.primeImplicants = mapCubes(result.primeImplicants);
+    mapped.essentialPrimeImplicants = mapCubes(result.essentialPrimeImplicants);
+    mapped.cover = mapCubes(result.cover);
+    for (vector<string>& alternative : mapped.alternatives) alternative = mapCubes(alternative);
+    for (int& m : mapped.uncoveredAfterEssentials) m = static_cast<int>(mapTerm(static_cast<uint32_t>(m)));
+    sort(mapped.uncoveredAfterEssentials.begin(), mapped.uncoveredAfterEssentials.end());
+    return mapped;
+}
+
+QMResult toCanonical(const QMResult& result, const InputTransform& transform) {
+    return mapResult(result, [&](PackedCube cube) { return transform.toCanonical(cube); },
+                     [&](uint32_t term) { return transform.toCanonical(term); });
+}
+
+QMResult fromCanonical(const QMResult& result, const InputTransform& transform) {
+    return mapResult(result, [&](PackedCube cube) { return transform.fromCanonical(cube); },
+                     [&](uint32_t term) { return transform.fromCanonical(term); });
+}
@@ -0,0 +1,41 @@
+#ifndef CANONICAL_H
+#define CANONICAL_H
+
+#include <array>
+#include <cstdint>
+#include "cube_table.h"
+#include "problem.h"
+#include "qm_result.h"
+
+// Functions that differ only by permuting or negating inputs have the same
+// minimal covers up to the same permutation and negation of their literals,
+// so they can share one solution. This finds a representative of such a
+// class (the NP class of the function): exact, the smallest truth table over
+// all transforms, for up to EXACT_CANONICAL_VARIABLES variables, and a
+// signature based heuristic above that (a valid transform that merges fewer
+// functions). Output negation is not used: covers of a function's complement
+// cannot be turned into covers of the function.
+const int EXACT_CANONICAL_VARIABLES = 6;
+
+// An input transform: canonical variable j (a bit index, like PackedCube) is
+// original variable permutation[j], negated when bit j of negation is set
+struct InputTransform {
+    int variables = 0;
+    std::array<uint8_t, 20> permutation{};
+    uint32_t negation = 0;
+
+    uint32_t toCanonical(uint32_t term) const;
+    uint32_t fromCanonical(uint32_t term) const;
+    PackedCube toCanonical(PackedCube cube) const;
+    PackedCube fromCanonical(PackedCube cube) const;
+};
+
+// The canonical representative of problem, and the transform leading to it
+Problem canonicalProblem(const Problem& problem, InputTransform& transform);
+
+// Moves a result between the original and the canonical variables; the order
+// of every list is kept, so a round trip gives back the same result
+QMResult toCanonical(const QMResult& result, const InputTransform& transform);
+QMResult fromCanonical(const QMResult& result, const InputTransform& transform);
+
+#endif // CANONICAL_H
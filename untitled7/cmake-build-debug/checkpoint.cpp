@@ -0,0 +1,168 @@
+#include "checkpoint.h"
+#include "binary_format.h"
+#include "mapped_file.h"
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <stdexcept>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static const char CHECKPOINT_MAGIC[4] = {'Q', 'M', 'C', 'K'};
+
+static void writeCubes(BinaryWriter& writer, const vector<PackedCube>& cubes) {
+    writer.u32(static_cast<uint32_t>(cubes.size()));
+    for (const PackedCube& cube : cubes) writer.cube(cube);
+}
+
+static vector<PackedCube> readCubes(BinaryReader& reader) {
+    uint32_t count = reader.u32();
+    vector<PackedCube> cubes;
+    for (uint32_t i = 0; i < count; i++) cubes.push_back(reader.cube());
+    return cubes;
+}
+
+static void writeColumns(BinaryWriter& writer, const vector<uint32_t>& columns) {
+    writer.u32(static_cast<uint32_t>(columns.size()));
+    for (uint32_t c : columns) writer.u32(c);
+}
+
+static vector<uint32_t> readColumns(BinaryReader& reader) {
+    uint32_t count = reader.u32();
+    vector<uint32_t> columns;
+    for (uint32_t i = 0; i < count; i++) columns.push_back(reader.u32());
+    return columns;
+}
+
+static void writeCheckpointTo(BinaryWriter& writer, const SolverCheckpoint& checkpoint) {
+    writer.raw(string_view(CHECKPOINT_MAGIC, 4));
+    writer.u16(CHECKPOINT_VERSION);
+    string problem = encodeBinaryProblem(checkpoint.problem);
+    writer.u32(static_cast<uint32_t>(problem.size()));
+    writer.raw(problem);
+
+    writer.u8(static_cast<uint8_t>(checkpoint.stage));
+    writer.u32(checkpoint.levels);
+    writeCubes(writer, checkpoint.level);
+    writeCubes(writer, checkpoint.primes);
+    writer.u32(checkpoint.petrickStep);
+    writer.u32(static_cast<uint32_t>(checkpoint.products.size()));
+    for (const vector<uint32_t>& product : checkpoint.products) {
+        writer.varint(product.size());
+        for (uint32_t c : product) writer.varint(c);
+    }
+    writeColumns(writer, checkpoint.path);
+    writeColumns(writer, checkpoint.best);
+}
+
+string encodeCheckpoint(const SolverCheckpoint& checkpoint) {
+    BinaryWriter writer;
+    writeCheckpointTo(writer, checkpoint);
+    return writer.bytes();
+}
+
+SolverCheckpoint parseCheckpoint(string_view data) {
+    if (data.size() < 4 || data.substr(0, 4) != string_view(CHECKPOINT_MAGIC, 4)) {
+        throw runtime_error("Not a checkpoint file");
+    }
+    BinaryReader reader(data);
+    reader.raw(4);
+    uint16_t version = reader.u16();
+    if (version != CHECKPOINT_VERSION) {
+        throw runtime_error("Unsupported checkpoint version " + to_string(version));
+    }
+
+    SolverCheckpoint checkpoint;
+    checkpoint.problem = parseBinaryProblem(reader.raw(reader.u32()));
+    uint8_t stage = reader.u8();
+    if (stage < static_cast<uint8_t>(CheckpointStage::Primes) ||
+        stage > static_cast<uint8_t>(CheckpointStage::BranchAndBound)) {
+        throw runtime_error("Unknown checkpoint stage " + to_string(stage));
+    }
+    checkpoint.stage = static_cast<CheckpointStage>(stage);
+    checkpoint.levels = reader.u32();
+    checkpoint.level = readCubes(reader);
+    checkpoint.primes = readCubes(reader);
+    checkpoint.petrickStep = reader.u32();
+    uint32_t productCount = reader.u32();
+    for (uint32_t i = 0; i < productCount; i++) {
+        uint64_t length = reader.varint();
+        if (length > data.size()) {
+            throw runtime_error("Product longer than the checkpoint file");
+        }
+        vector<uint32_t> product(length);
+        for (uint32_t& c : product) c = static_cast<uint32_t>(reader.varint());
+        checkpoint.products.push_back(move(product));
+    }
+    checkpoint.path = readColumns(reader);
+    checkpoint.best = readColumns(reader);
+    if (!reader.atEnd()) {
+        throw runtime_error("Trailing data in checkpoint file");
+    }
+    return checkpoint;
+}
+
+// Writes data to filename and returns once it is on the disk, so a rename
+// that follows cannot reach the disk before it
+static void writeSynced(const string& data, const string& filename) {
+#ifdef _WIN32
+    HANDLE file = CreateFileA(filename.c_str(), GENERIC_WRITE, 0, nullptr, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) {
+        throw runtime_error("Could not open file for writing: " + filename);
+    }
+    DWORD written = 0;
+    bool ok = WriteFile(file, data.data(), static_cast<DWORD>(data.size()), &written, nullptr) &&
+              written == data.size() && FlushFileBuffers(file);
+    CloseHandle(file);
+    if (!ok) {
+        throw runtime_error("Could not write file: " + filename);
+    }
+#else
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        throw runtime_error("Could not open file for writing: " + filename + ": " + strerror(errno));
+    }
+    size_t done = 0;
+    while (done < data.size()) {
+        ssize_t count = write(fd, data.data() + done, data.size() - done);
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) break;
+        done += static_cast<size_t>(count);
+    }
+    bool ok = done == data.size() && fsync(fd) == 0;
+    int error = errno;
+    close(fd);
+    if (!ok) {
+        throw runtime_error("Could not write file: " + filename + ": " + strerror(error));
+    }
+#endif
+}
+
+void writeCheckpoint(const SolverCheckpoint& checkpoint, const string& filename) {
+    string temporary = filename + ".tmp";
+    BinaryWriter writer;
+    writeCheckpointTo(writer, checkpoint);
+    writeSynced(writer.bytes(), temporary);
+    filesystem::rename(temporary, filename);
+#ifndef _WIN32
+    // The rename itself lasts once the directory is on the disk too
+    filesystem::path directory = filesystem::absolute(filename).parent_path();
+    int fd = open(directory.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+#endif
+}
+
+SolverCheckpoint readCheckpoint(const string& filename) {
+    MappedFile file(filename);
+    return parseCheckpoint(file.contents());
+}
@@ -0,0 +1,52 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "cube_table.h"
+#include "problem.h"
+
+// Snapshot of a long single-output solve, written periodically (see
+// QM::setCheckpointing) so that a preempted run can pick up where it stopped
+// (QM::resumeFrom) and still give the result of an uninterrupted run.
+//
+// File (integers little endian, see binary_format.h): "QMCK", u16 version,
+// u32 length + the problem as a binary problem file, u8 stage, u32 combining
+// levels done, the cubes of the level to combine next and the primes found so
+// far (u32 count + cubes each), u32 Petrick sums multiplied, u32 product count
+// and every product as varint length + varint columns, then the branch and
+// bound path (u32 depth + the position of the column taken at every depth)
+// and incumbent (u32 count + columns). Columns index the covering table left
+// after the essentials, which the resumed run builds again from the primes.
+const uint16_t CHECKPOINT_VERSION = 1;
+
+enum class CheckpointStage : uint8_t {
+    Primes = 1,          // Combining: level and primes hold the state before the next level
+    Petrick = 2,         // All primes known; Petrick's method has multiplied petrickStep sums
+    BranchAndBound = 3,  // All primes known; branch and bound is at path with incumbent best
+};
+
+struct SolverCheckpoint {
+    Problem problem;
+    CheckpointStage stage = CheckpointStage::Primes;
+    uint32_t levels = 0;
+    std::vector<PackedCube> level;
+    std::vector<PackedCube> primes;
+    uint32_t petrickStep = 0;
+    std::vector<std::vector<uint32_t>> products;
+    std::vector<uint32_t> path;
+    std::vector<uint32_t> best;
+};
+
+std::string encodeCheckpoint(const SolverCheckpoint& checkpoint);
+SolverCheckpoint parseCheckpoint(std::string_view data);
+
+// Replaces the file through a temporary one that is synced to the disk first,
+// so a crash or power loss leaves the previous checkpoint or the new one, never
+// half of one. Throws runtime_error.
+void writeCheckpoint(const SolverCheckpoint& checkpoint, const std::string& filename);
+SolverCheckpoint readCheckpoint(const std::string& filename);
+
+#endif // CHECKPOINT_H
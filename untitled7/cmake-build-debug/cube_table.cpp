@@ -0,0 +1,51 @@
+#include "cube_table.h"
+
+using namespace std;
+
+// Packs a cube string ("1-0") into value/care bit masks
+PackedCube packCube(const string& cube) {
+    PackedCube packed = {0, 0};
+    for (char c : cube) {
+        packed.value <<= 1;
+        packed.care <<= 1;
+        if (c != '-') {
+            packed.care |= 1;
+            if (c == '1') packed.value |= 1;
+        }
+    }
+    return packed;
+}
+
+// Expands a packed cube back to its string form
+string unpackCube(PackedCube cube, int variables) {
+    string result(variables, '-');
+    for (int i = 0; i < variables; i++) {
+        uint32_t bit = 1u << (variables - 1 - i);
+        if (cube.care & bit) result[i] = (cube.value & bit) ? '1' : '0';
+    }
+    return result;
+}
+
+void CubeTable::clear(int variables) {
+    this->variables = variables;
+    // Swapping with empty containers releases the memory (clear() would keep it)
+    pmr::vector<PackedCube>(cubes.get_allocator()).swap(cubes);
+    pmr::unordered_map<uint64_t, CubeId>(ids.get_allocator()).swap(ids);
+}
+
+pair<CubeId, bool> CubeTable::intern(PackedCube cube) {
+    uint64_t key = (static_cast<uint64_t>(cube.care) << 32) | cube.value;
+    auto [it, added] = ids.try_emplace(key, static_cast<CubeId>(cubes.size()));
+    if (added) cubes.push_back(cube);
+    return {it->second, added};
+}
+
+uint64_t CubeTable::sortKey(CubeId id) const {
+    PackedCube cube = cubes[id];
+    uint64_t key = 0;
+    for (int i = variables - 1; i >= 0; i--) {
+        uint32_t bit = 1u << i;
+        key = key * 3 + (!(cube.care & bit) ? 0 : (cube.value & bit) ? 2 : 1);
+    }
+    return key;
+}
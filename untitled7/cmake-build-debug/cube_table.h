@@ -0,0 +1,56 @@
+#ifndef CUBE_TABLE_H
+#define CUBE_TABLE_H
+
+#include <cstdint>
+#include <memory_resource>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+// A cube as two bit masks: bit i of care is set when variable (n-1-i) is fixed,
+// and value holds the fixed bits. "1-0" is value 0b100, care 0b101.
+struct PackedCube {
+    uint32_t value;
+    uint32_t care;
+};
+
+PackedCube packCube(const std::string& cube);
+std::string unpackCube(PackedCube cube, int variables);
+
+// ID of an interned cube (its index in the table)
+using CubeId = uint32_t;
+
+// Every distinct cube of one minimization, stored once in a contiguous array.
+// Cubes get their IDs in insertion order, so anything attached to a cube can
+// live in an array indexed by ID, and comparing cubes is comparing integers.
+class CubeTable {
+public:
+    explicit CubeTable(std::pmr::memory_resource* resource) : cubes(resource), ids(resource) {}
+
+    // Forgets all cubes and gives their memory back to the resource
+    void clear(int variables);
+
+    // Returns the ID of cube, and whether it was added by this call
+    std::pair<CubeId, bool> intern(PackedCube cube);
+
+    PackedCube cube(CubeId id) const { return cubes[id]; }
+    size_t size() const { return cubes.size(); }
+
+    bool covers(CubeId id, int minterm) const {
+        return (static_cast<uint32_t>(minterm) & cubes[id].care) == cubes[id].value;
+    }
+
+    // The cube in its string form ("1-0")
+    std::string toString(CubeId id) const { return unpackCube(cubes[id], variables); }
+
+    // Orders cubes like their strings ('-' < '0' < '1', first variable first)
+    uint64_t sortKey(CubeId id) const;
+
+private:
+    int variables = 0;
+    std::pmr::vector<PackedCube> cubes;
+    std::pmr::unordered_map<uint64_t, CubeId> ids;
+};
+
+#endif // CUBE_TABLE_H
@@ -0,0 +1,261 @@
+#include "flight_recorder.h"
+#include "binary_format.h"
+#include "bit_slice.h"
+#include "mapped_file.h"
+#include "qm.h"
+#include "trace.h"
+#include <algorithm>
+#include <filesystem>
+#include <iomanip>
+#include <stdexcept>
+
+using namespace std;
+
+static const char FLIGHT_MAGIC[4] = {'Q', 'M', 'F', 'R'};
+
+// Heap order that keeps the fastest record on top
+static bool slower(const FlightRecord& a, const FlightRecord& b) {
+    return a.latencyNs > b.latencyNs;
+}
+
+static void writeText(BinaryWriter& writer, const string& text) {
+    writer.varint(text.size());
+    writer.raw(text);
+}
+
+static string readText(BinaryReader& reader) {
+    uint64_t size = reader.varint();
+    return string(reader.raw(static_cast<size_t>(size)));
+}
+
+static void writeRecord(BinaryWriter& writer, const FlightRecord& record) {
+    writeText(writer, record.name);
+    writer.u64(record.latencyNs);
+    writer.u8(record.flags);
+    writer.varint(record.memoryBudget);
+    writeText(writer, record.failedPhase);
+    const QMStats& stats = record.stats;
+    for (uint64_t value : {uint64_t(stats.combiningLevels), uint64_t(stats.remainingPIs),
+                           uint64_t(stats.remainingMinterms), uint64_t(stats.petrickProducts),
+                           uint64_t(stats.scratchBytes), uint64_t(stats.adjacencyTests), uint64_t(stats.merges),
+                           uint64_t(stats.dedupHits), uint64_t(stats.petrickPartialProducts), uint64_t(stats.timed),
+                           uint64_t(stats.parseNs), uint64_t(stats.primesNs), uint64_t(stats.coverageNs),
+                           uint64_t(stats.essentialsNs), uint64_t(stats.coverSearchNs)}) {
+        writer.varint(value);
+    }
+    writer.varint(stats.levelCubes.size());
+    for (size_t cubes : stats.levelCubes) writer.varint(cubes);
+    string problem = encodeBinaryProblem(record.problem);
+    writer.u32(static_cast<uint32_t>(problem.size()));
+    writer.raw(problem);
+}
+
+static FlightRecord readRecord(BinaryReader& reader) {
+    FlightRecord record;
+    record.name = readText(reader);
+    record.latencyNs = reader.u64();
+    record.flags = reader.u8();
+    record.memoryBudget = reader.varint();
+    record.failedPhase = readText(reader);
+    QMStats& stats = record.stats;
+    stats.combiningLevels = reader.varint();
+    stats.remainingPIs = reader.varint();
+    stats.remainingMinterms = reader.varint();
+    stats.petrickProducts = reader.varint();
+    stats.scratchBytes = reader.varint();
+    stats.adjacencyTests = reader.varint();
+    stats.merges = reader.varint();
+    stats.dedupHits = reader.varint();
+    stats.petrickPartialProducts = reader.varint();
+    stats.timed = reader.varint() != 0;
+    stats.parseNs = reader.varint();
+    stats.primesNs = reader.varint();
+    stats.coverageNs = reader.varint();
+    stats.essentialsNs = reader.varint();
+    stats.coverSearchNs = reader.varint();
+    uint64_t levels = reader.varint();
+    for (uint64_t l = 0; l < levels; l++) stats.levelCubes.push_back(reader.varint());
+    stats.fromTable = (record.flags & FLIGHT_FROM_TABLE) != 0;
+    stats.fromCache = (record.flags & FLIGHT_FROM_CACHE) != 0;
+    stats.bitSliced = (record.flags & FLIGHT_BIT_SLICED) != 0;
+    stats.usedBranchAndBound = (record.flags & FLIGHT_BRANCH_AND_BOUND) != 0;
+    stats.budgetFallback = (record.flags & FLIGHT_BUDGET_FALLBACK) != 0;
+    stats.budgetExceeded = (record.flags & FLIGHT_BUDGET_EXCEEDED) != 0;
+    record.problem = parseBinaryProblem(reader.raw(reader.u32()));
+    return record;
+}
+
+string encodeFlightLog(const vector<FlightRecord>& records) {
+    BinaryWriter writer;
+    writer.raw(string_view(FLIGHT_MAGIC, 4));
+    writer.u16(FLIGHT_LOG_VERSION);
+    writer.u32(static_cast<uint32_t>(records.size()));
+    for (const FlightRecord& record : records) {
+        BinaryWriter body;
+        writeRecord(body, record);
+        writer.u32(static_cast<uint32_t>(body.bytes().size()));
+        writer.raw(body.bytes());
+    }
+    return writer.bytes();
+}
+
+vector<FlightRecord> parseFlightLog(string_view data) {
+    if (data.size() < 4 || data.substr(0, 4) != string_view(FLIGHT_MAGIC, 4)) {
+        throw runtime_error("Not a flight recorder log");
+    }
+    BinaryReader reader(data);
+    reader.raw(4);
+    uint16_t version = reader.u16();
+    if (version != FLIGHT_LOG_VERSION) {
+        throw runtime_error("Unsupported flight recorder log version " + to_string(version));
+    }
+    uint32_t count = reader.u32();
+    vector<FlightRecord> records;
+    for (uint32_t i = 0; i < count; i++) {
+        BinaryReader body(reader.raw(reader.u32()));
+        records.push_back(readRecord(body));
+    }
+    return records;
+}
+
+vector<FlightRecord> readFlightLog(const string& filename) {
+    MappedFile file(filename);
+    return parseFlightLog(file.contents());
+}
+
+FlightRecorder::FlightRecorder(const string& filename, chrono::nanoseconds threshold, size_t capacity)
+    : filename(filename), threshold(threshold), capacity(max<size_t>(capacity, 1)) {
+    writer = thread(&FlightRecorder::writeLoop, this);
+}
+
+FlightRecorder::~FlightRecorder() {
+    {
+        lock_guard<mutex> lock(recordsMutex);
+        stopping = true;
+    }
+    recordsChanged.notify_all();
+    writer.join();
+    try {
+        flush();
+    }
+    catch (const exception&) {
+        // Nothing to report to from a destructor
+    }
+}
+
+void FlightRecorder::record(const string& name, const Problem& problem, const QMResult& result,
+                            chrono::nanoseconds latency, size_t memoryBudget) {
+    FlightRecord record;
+    record.name = name;
+    record.latencyNs = static_cast<uint64_t>(latency.count());
+    record.flags = (result.valid ? FLIGHT_VALID : 0) | (result.stats.fromTable ? FLIGHT_FROM_TABLE : 0) |
+                   (result.stats.fromCache ? FLIGHT_FROM_CACHE : 0) | (result.stats.bitSliced ? FLIGHT_BIT_SLICED : 0) |
+                   (result.stats.usedBranchAndBound ? FLIGHT_BRANCH_AND_BOUND : 0) |
+                   (result.stats.budgetFallback ? FLIGHT_BUDGET_FALLBACK : 0) |
+                   (result.stats.budgetExceeded ? FLIGHT_BUDGET_EXCEEDED : 0);
+    record.memoryBudget = memoryBudget;
+    record.failedPhase = result.failedPhase;
+    record.stats = result.stats;
+    record.problem = problem;
+
+    {
+        lock_guard<mutex> lock(recordsMutex);
+        if (records.size() == capacity) {
+            if (!slower(record, records.front())) return;
+            pop_heap(records.begin(), records.end(), slower);
+            records.pop_back();
+        }
+        records.push_back(move(record));
+        push_heap(records.begin(), records.end(), slower);
+        changed = true;
+    }
+    recordsChanged.notify_one();
+}
+
+// Writes the log once records changed, then waits out the interval so that
+// the records coming in meanwhile go into the next write together
+void FlightRecorder::writeLoop() {
+    unique_lock<mutex> lock(recordsMutex);
+    for (;;) {
+        recordsChanged.wait(lock, [&]() { return changed || stopping; });
+        if (stopping) return;
+        lock.unlock();
+        try {
+            flush();
+        }
+        catch (const exception&) {
+            // The next change tries again, and the final flush() reports it
+        }
+        lock.lock();
+        recordsChanged.wait_for(lock, chrono::milliseconds(FLIGHT_WRITE_INTERVAL_MS), [&]() { return stopping; });
+    }
+}
+
+// Writes the log, slowest record first, to a temporary file renamed over it
+void FlightRecorder::flush() {
+    lock_guard<mutex> writing(fileMutex);
+    vector<FlightRecord> sorted;
+    {
+        lock_guard<mutex> lock(recordsMutex);
+        if (!changed) return;
+        sorted = records;
+        changed = false;
+    }
+    try {
+        sort(sorted.begin(), sorted.end(), slower);
+        string temporary = filename + ".tmp";
+        BinaryWriter log;
+        log.raw(encodeFlightLog(sorted));
+        log.writeToFile(temporary);
+        filesystem::rename(temporary, filename);
+    }
+    catch (const exception&) {
+        lock_guard<mutex> lock(recordsMutex);
+        changed = true;
+        throw;
+    }
+}
+
+// Names the engines a solve went through, e.g. "bit_sliced+branch_and_bound"
+static string engineName(const QMStats& stats) {
+    if (stats.fromTable) return "small_table";
+    if (stats.fromCache) return "result_cache";
+    string name = stats.bitSliced ? "bit_sliced+" : "";
+    if (stats.usedBranchAndBound) name += stats.budgetFallback ? "branch_and_bound(memory_budget)" : "branch_and_bound";
+    else name += "petrick";
+    return name;
+}
+
+void replayFlightLog(const string& filename, ostream& out) {
+    vector<FlightRecord> records = readFlightLog(filename);
+    setTracing(true);
+    SolverContext context;
+    context.setDetailedStats(true);
+    out << fixed << setprecision(3);
+    for (size_t i = 0; i < records.size(); i++) {
+        const FlightRecord& record = records[i];
+        TraceSpan span("replay_record", "record", static_cast<long long>(i));
+        // A memory budget stop is met again by the same budget; a cancelled or
+        // timed out solve gets as long as it had
+        context.setMemoryBudget(static_cast<size_t>(record.memoryBudget));
+        auto start = chrono::steady_clock::now();
+        if (record.failedPhase.empty() || (record.flags & FLIGHT_BUDGET_EXCEEDED)) context.clearDeadline();
+        else context.setDeadline(start + chrono::nanoseconds(record.latencyNs));
+        QMResult result;
+        if (record.flags & FLIGHT_BIT_SLICED) {
+            result = solveBitSliced({record.problem}, context).front();
+        } else {
+            result = solve(record.problem, context);
+        }
+        double replayMs = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+
+        out << record.name << ": recorded " << record.latencyNs / 1e6 << " ms (" << engineName(record.stats);
+        if (!record.failedPhase.empty()) out << ", stopped in " << record.failedPhase;
+        out << "), replayed " << replayMs << " ms (" << engineName(result.stats);
+        if (!result.failedPhase.empty()) out << ", stopped in " << result.failedPhase;
+        out << ")\n";
+        out << "  recorded: " << statsToJson(record.stats) << "\n";
+        out << "  replayed: " << statsToJson(result.stats) << "\n";
+    }
+    out << defaultfloat;
+}
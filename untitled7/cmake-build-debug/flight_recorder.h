@@ -0,0 +1,107 @@
+#ifndef FLIGHT_RECORDER_H
+#define FLIGHT_RECORDER_H
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "problem.h"
+#include "qm_result.h"
+
+// Bounded log of slow solves, so that the outlier of a long batch (or of a
+// server's traffic) can be investigated without running everything again.
+// Solves that took at least the threshold are kept with their exact input,
+// their stats and the engine choices of the solver. Once capacity records are
+// held a new one replaces the fastest, so the log keeps the slowest solves
+// seen. untitled7 --replay runs the inputs of a log again with tracing on.
+//
+// File (integers little endian, see binary_format.h): "QMFR", u16 version,
+// u32 record count, then every record as u32 length + record. A record is the
+// name (varint length + bytes), u64 latency in nanoseconds, u8 engine flags,
+// the memory budget of the solve in bytes (varint, 0 = none), the failed phase
+// (varint length + bytes), the QMStats counters and phase times as varints,
+// the cubes per combining level (varint count + varints), and u32 length + the
+// problem as a binary problem file.
+const uint16_t FLIGHT_LOG_VERSION = 2;
+
+// Records kept unless the caller asks for another number
+const size_t DEFAULT_FLIGHT_RECORDS = 256;
+
+// The log file is rewritten in the background at most this often while records come in
+const int FLIGHT_WRITE_INTERVAL_MS = 1000;
+
+// Engine flags of a record
+const uint8_t FLIGHT_VALID = 1;
+const uint8_t FLIGHT_FROM_TABLE = 2;
+const uint8_t FLIGHT_FROM_CACHE = 4;
+const uint8_t FLIGHT_BIT_SLICED = 8;
+const uint8_t FLIGHT_BRANCH_AND_BOUND = 16;
+const uint8_t FLIGHT_BUDGET_FALLBACK = 32;
+const uint8_t FLIGHT_BUDGET_EXCEEDED = 64;
+
+struct FlightRecord {
+    std::string name;
+    uint64_t latencyNs = 0;
+    uint8_t flags = 0;
+    uint64_t memoryBudget = 0;
+    std::string failedPhase;
+    QMStats stats;
+    Problem problem;
+};
+
+// Keeps the slow solves of one run; record() may be called from any thread and
+// only touches memory, while a thread of the recorder writes the file
+class FlightRecorder {
+public:
+    FlightRecorder(const std::string& filename, std::chrono::nanoseconds threshold,
+                   size_t capacity = DEFAULT_FLIGHT_RECORDS);
+    ~FlightRecorder();
+
+    FlightRecorder(const FlightRecorder&) = delete;
+    FlightRecorder& operator=(const FlightRecorder&) = delete;
+
+    bool isSlow(std::chrono::nanoseconds latency) const { return latency >= threshold; }
+
+    // Keeps a solve that isSlow(), run with memoryBudget (see QM::setMemoryBudget);
+    // the log file follows within FLIGHT_WRITE_INTERVAL_MS
+    void record(const std::string& name, const Problem& problem, const QMResult& result,
+                std::chrono::nanoseconds latency, size_t memoryBudget = 0);
+
+    // Writes the log file (to a temporary name, then renamed over it); throws
+    // runtime_error if it cannot be written
+    void flush();
+
+private:
+    void writeLoop();
+
+    std::string filename;
+    std::chrono::nanoseconds threshold;
+    size_t capacity;
+    std::mutex recordsMutex;              // Guards records, changed and stopping
+    std::condition_variable recordsChanged;
+    std::vector<FlightRecord> records;    // A min-heap by latency
+    bool changed = false;
+    bool stopping = false;
+    std::mutex fileMutex;                 // Held while the file is written
+    std::thread writer;
+};
+
+std::string encodeFlightLog(const std::vector<FlightRecord>& records);
+std::vector<FlightRecord> parseFlightLog(std::string_view data);
+std::vector<FlightRecord> readFlightLog(const std::string& filename);
+
+// Solves every record of a log again, slowest first, with tracing and phase
+// timers on (see trace.h), and prints what was recorded next to what the
+// replay did. Records that were solved bit-sliced are replayed bit-sliced;
+// the result cache is not used, so cache hits are solved for real. Every
+// record runs with its recorded memory budget, and records that were cancelled
+// or passed their deadline get their recorded time as the time limit.
+void replayFlightLog(const std::string& filename, std::ostream& out);
+
+#endif // FLIGHT_RECORDER_H
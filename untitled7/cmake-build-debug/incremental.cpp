@@ -0,0 +1,322 @@
+#include "incremental.h"
+#include "problem.h"
+#include <algorithm>
+#include <bit>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <unordered_map>
+
+using namespace std;
+
+// Growing primes from a new term walks the implicants through it; past this
+// many the edit is not local any more and the primes are regenerated instead
+constexpr size_t GROW_LIMIT = 1 << 14;
+
+// Whether cube inner lies inside cube outer
+static bool contains(PackedCube outer, PackedCube inner) {
+    return (inner.care & outer.care) == outer.care && (inner.value & outer.care) == outer.value;
+}
+
+static bool covers(PackedCube cube, int term) {
+    return (static_cast<uint32_t>(term) & cube.care) == cube.value;
+}
+
+// Calls visit for every term of a cube
+template <typename Visit>
+static void forEachTerm(PackedCube cube, uint32_t allVariables, Visit visit) {
+    uint32_t dashes = allVariables & ~cube.care;
+    for (uint32_t s = dashes;; s = (s - 1) & dashes) {
+        visit(static_cast<int>(cube.value | s));
+        if (s == 0) break;
+    }
+}
+
+IncrementalQM::IncrementalQM(const Problem& problem) : variables(problem.variables), solver(problem.variables) {
+    if (problem.isMultiOutput()) {
+        throw invalid_argument("Error: Incremental minimization supports single-output problems only.");
+    }
+    states.assign(size_t(1) << variables, Off);
+    for (int m : problem.minterms) states[m] = On;
+    for (int d : problem.dontCares) states[d] = DontCare;
+    rebuild();
+}
+
+void IncrementalQM::addMinterm(int term) {
+    setState(term, On);
+}
+
+void IncrementalQM::removeMinterm(int term) {
+    if (term >= 0 && term < static_cast<int>(states.size()) && states[term] != On) return;
+    setState(term, Off);
+}
+
+void IncrementalQM::addDontCare(int term) {
+    setState(term, DontCare);
+}
+
+void IncrementalQM::removeDontCare(int term) {
+    if (term >= 0 && term < static_cast<int>(states.size()) && states[term] != DontCare) return;
+    setState(term, Off);
+}
+
+// Moves a term to a new state, then re-covers the components the edit reached
+void IncrementalQM::setState(int term, TermState state) {
+    if (term < 0 || term >= static_cast<int>(states.size())) {
+        throw invalid_argument("Error: Term " + to_string(term) + " is out of range (0-" +
+                               to_string(states.size() - 1) + ")");
+    }
+    TermState old = states[term];
+    recovered = 0;
+    if (old == state) return;
+
+    // Moving between ON and don't-care keeps the care set, and so the primes
+    vector<PackedCube> removed;
+    bool local = true;
+    if (old == Off) local = growPrimes(term, removed);
+    else if (state == Off) splitPrimes(term, removed);
+    states[term] = state;
+    if (!local) {
+        rebuild();
+        return;
+    }
+
+    // Reached components: those of the minterms of every removed prime and every prime through term
+    uint32_t allVariables = (1u << variables) - 1;
+    vector<char> reached(components.size(), 0);
+    vector<size_t> reachedComponents;
+    auto reach = [&](PackedCube cube) {
+        forEachTerm(cube, allVariables, [&](int m) {
+            int c = componentOf[m];
+            if (c >= 0 && !reached[c]) {
+                reached[c] = 1;
+                reachedComponents.push_back(c);
+            }
+        });
+    };
+    for (PackedCube prime : removed) reach(prime);
+    for (PackedCube prime : primes) {
+        if (covers(prime, term)) reach(prime);
+    }
+
+    // Dissolve them and cover their minterms again
+    vector<int> region;
+    for (size_t c : reachedComponents) {
+        for (int m : components[c].minterms) {
+            componentOf[m] = -1;
+            if (m != term) region.push_back(m);
+        }
+        components[c] = Component();
+        freeComponents.push_back(c);
+    }
+    if (state == On) region.push_back(term);
+    recover(move(region));
+}
+
+// Adds the primes through a term that joined the care set, and removes the old
+// primes they contain. Returns false when there are too many implicants through it.
+bool IncrementalQM::growPrimes(int term, vector<PackedCube>& removed) {
+    uint32_t allVariables = (1u << variables) - 1;
+    uint32_t t = static_cast<uint32_t>(term);
+
+    // Breadth-first over the dash sets whose cube through term is an implicant;
+    // the ones that cannot take another dash are the new primes
+    unordered_map<uint32_t, bool> implicant{{0u, true}};
+    vector<uint32_t> queue{0};
+    vector<PackedCube> grown;
+    for (size_t i = 0; i < queue.size(); i++) {
+        uint32_t dashes = queue[i];
+        bool maximal = true;
+        for (uint32_t free = allVariables & ~dashes; free != 0; free &= free - 1) {
+            uint32_t bit = free & (~free + 1);
+            auto [it, added] = implicant.try_emplace(dashes | bit, false);
+            if (added) {
+                // The half across bit does not contain term, so it must lie in the old care set
+                it->second = insideCareSet({(t ^ bit) & ~dashes, allVariables & ~dashes});
+                if (it->second) queue.push_back(dashes | bit);
+                if (queue.size() > GROW_LIMIT) return false;
+            }
+            if (it->second) maximal = false;
+        }
+        if (maximal) grown.push_back({t & ~dashes, allVariables & ~dashes});
+    }
+
+    erase_if(primes, [&](PackedCube prime) {
+        bool swallowed = any_of(grown.begin(), grown.end(), [&](PackedCube g) { return contains(g, prime); });
+        if (swallowed) removed.push_back(prime);
+        return swallowed;
+    });
+    primes.insert(primes.end(), grown.begin(), grown.end());
+    return true;
+}
+
+// Replaces the primes through a term that left the care set by their largest
+// pieces without it. Every implicant now lies in a surviving prime or in one
+// of these pieces, so the new primes are the pieces no other cube contains.
+void IncrementalQM::splitPrimes(int term, vector<PackedCube>& removed) {
+    uint32_t allVariables = (1u << variables) - 1;
+    uint32_t t = static_cast<uint32_t>(term);
+
+    vector<PackedCube> survivors;
+    vector<PackedCube> pieces;
+    for (PackedCube prime : primes) {
+        if (!covers(prime, term)) {
+            survivors.push_back(prime);
+            continue;
+        }
+        removed.push_back(prime);
+        for (uint32_t free = allVariables & ~prime.care; free != 0; free &= free - 1) {
+            uint32_t bit = free & (~free + 1);
+            pieces.push_back({prime.value | (~t & bit), prime.care | bit});
+        }
+    }
+
+    auto key = [](PackedCube cube) { return (static_cast<uint64_t>(cube.care) << 32) | cube.value; };
+    sort(pieces.begin(), pieces.end(), [&](PackedCube a, PackedCube b) { return key(a) < key(b); });
+    pieces.erase(unique(pieces.begin(), pieces.end(), [&](PackedCube a, PackedCube b) { return key(a) == key(b); }),
+                 pieces.end());
+
+    primes = survivors;
+    for (PackedCube piece : pieces) {
+        auto inside = [&](PackedCube other) { return key(other) != key(piece) && contains(other, piece); };
+        if (none_of(survivors.begin(), survivors.end(), inside) && none_of(pieces.begin(), pieces.end(), inside)) {
+            primes.push_back(piece);
+        }
+    }
+}
+
+// Whether every term of cube is ON or don't-care (small cubes are checked term
+// by term, large ones against the primes, since every implicant lies in a prime)
+bool IncrementalQM::insideCareSet(PackedCube cube) const {
+    uint32_t allVariables = (1u << variables) - 1;
+    if ((size_t(1) << popcount(allVariables & ~cube.care)) <= primes.size()) {
+        bool inside = true;
+        forEachTerm(cube, allVariables, [&](int m) { inside = inside && states[m] != Off; });
+        return inside;
+    }
+    return any_of(primes.begin(), primes.end(), [&](PackedCube prime) { return contains(prime, cube); });
+}
+
+// Splits minterms (whole components, or the minterms of none) into components
+// over the current primes and covers each of them
+void IncrementalQM::recover(vector<int> minterms) {
+    recovered = minterms.size();
+    if (minterms.empty()) return;
+    sort(minterms.begin(), minterms.end());
+    uint32_t allVariables = (1u << variables) - 1;
+
+    // Rows of minterms every prime covers, found term by term for small primes
+    vector<int> row(states.size(), -1);
+    for (size_t i = 0; i < minterms.size(); i++) row[minterms[i]] = static_cast<int>(i);
+    vector<PackedCube> reaching;
+    vector<vector<uint32_t>> reachingRows;
+    for (PackedCube prime : primes) {
+        vector<uint32_t> rows;
+        if ((size_t(1) << popcount(allVariables & ~prime.care)) <= minterms.size()) {
+            forEachTerm(prime, allVariables, [&](int m) {
+                if (row[m] >= 0) rows.push_back(row[m]);
+            });
+        } else {
+            for (size_t i = 0; i < minterms.size(); i++) {
+                if (covers(prime, minterms[i])) rows.push_back(static_cast<uint32_t>(i));
+            }
+        }
+        if (!rows.empty()) {
+            reaching.push_back(prime);
+            reachingRows.push_back(move(rows));
+        }
+    }
+
+    // Minterms sharing a prime end up in one component
+    vector<uint32_t> parent(minterms.size());
+    iota(parent.begin(), parent.end(), 0);
+    auto find = [&](uint32_t r) {
+        while (parent[r] != r) r = parent[r] = parent[parent[r]];
+        return r;
+    };
+    for (const vector<uint32_t>& rows : reachingRows) {
+        for (uint32_t r : rows) parent[find(r)] = find(rows[0]);
+    }
+
+    vector<int> groupOf(minterms.size(), -1);
+    vector<vector<int>> groupMinterms;
+    vector<vector<PackedCube>> groupPrimes;
+    for (size_t i = 0; i < minterms.size(); i++) {
+        uint32_t root = find(static_cast<uint32_t>(i));
+        if (groupOf[root] < 0) {
+            groupOf[root] = static_cast<int>(groupMinterms.size());
+            groupMinterms.emplace_back();
+        }
+        groupMinterms[groupOf[root]].push_back(minterms[i]);
+    }
+    groupPrimes.resize(groupMinterms.size());
+    for (size_t p = 0; p < reaching.size(); p++) {
+        groupPrimes[groupOf[find(reachingRows[p][0])]].push_back(reaching[p]);
+    }
+
+    for (size_t g = 0; g < groupMinterms.size(); g++) {
+        size_t slot;
+        if (freeComponents.empty()) {
+            slot = components.size();
+            components.emplace_back();
+        } else {
+            slot = freeComponents.back();
+            freeComponents.pop_back();
+        }
+        for (int m : groupMinterms[g]) componentOf[m] = static_cast<int>(slot);
+        components[slot].cover = solver.selectCover(groupPrimes[g], groupMinterms[g]);
+        components[slot].minterms = move(groupMinterms[g]);
+    }
+}
+
+// Regenerates the primes with a full run and covers every component again
+void IncrementalQM::rebuild() {
+    Problem problem;
+    problem.variables = variables;
+    for (size_t term = 0; term < states.size(); term++) {
+        if (states[term] == On) problem.minterms.push_back(static_cast<int>(term));
+        else if (states[term] == DontCare) problem.dontCares.push_back(static_cast<int>(term));
+    }
+
+    solver.load(problem);
+    primes.clear();
+    for (const string& prime : solver.solve().primeImplicants) primes.push_back(packCube(prime));
+
+    components.clear();
+    freeComponents.clear();
+    componentOf.assign(states.size(), -1);
+    recover(problem.minterms);
+}
+
+QMResult IncrementalQM::result() const {
+    // Strings sort like the full solver orders its cubes ('-' < '0' < '1')
+    auto toStrings = [&](const vector<PackedCube>& cubes) {
+        vector<string> strings;
+        strings.reserve(cubes.size());
+        for (PackedCube cube : cubes) strings.push_back(unpackCube(cube, variables));
+        sort(strings.begin(), strings.end());
+        return strings;
+    };
+
+    vector<PackedCube> essentials;
+    vector<PackedCube> chosen;
+    QMResult result;
+    result.variables = variables;
+    for (const Component& component : components) {
+        const CoverSelection& cover = component.cover;
+        essentials.insert(essentials.end(), cover.essentials.begin(), cover.essentials.end());
+        chosen.insert(chosen.end(), cover.chosen.begin(), cover.chosen.end());
+        result.uncoveredAfterEssentials.insert(result.uncoveredAfterEssentials.end(),
+                                               cover.uncovered.begin(), cover.uncovered.end());
+    }
+    sort(result.uncoveredAfterEssentials.begin(), result.uncoveredAfterEssentials.end());
+
+    result.primeImplicants = toStrings(primes);
+    result.essentialPrimeImplicants = toStrings(essentials);
+    result.cover = result.essentialPrimeImplicants;
+    if (!chosen.empty()) {
+        result.alternatives.push_back(toStrings(chosen));
+        result.cover.insert(result.cover.end(), result.alternatives[0].begin(), result.alternatives[0].end());
+    }
+    return result;
+}
@@ -0,0 +1,69 @@
+#ifndef INCREMENTAL_H
+#define INCREMENTAL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "cube_table.h"
+#include "qm.h"
+#include "qm_result.h"
+
+struct Problem;
+
+// A solved single-output problem that stays solved while its ON and don't-care
+// sets are edited one term at a time.
+//
+// An edit only touches the primes through the edited term: a term joining the
+// care set grows new primes from it (dropping the old primes they swallow), a
+// term leaving it splits the primes through it around it. The covering table
+// falls apart into components (minterms linked by shared primes) whose minimum
+// covers together form a minimum cover, so only the components reached by the
+// touched primes are re-covered; every other component keeps its cached cover.
+class IncrementalQM {
+public:
+    // Solves problem from scratch. Throws invalid_argument for multi-output problems.
+    explicit IncrementalQM(const Problem& problem);
+
+    // Each edit moves one term between the OFF, ON and don't-care sets: adding a
+    // don't-care as a minterm (or the other way round) moves it, and removing a
+    // term that is not in the set does nothing. Throw invalid_argument when term
+    // is out of range.
+    void addMinterm(int term);
+    void removeMinterm(int term);
+    void addDontCare(int term);
+    void removeDontCare(int term);
+
+    // The current solution; alternatives holds the one minimal solution in cover
+    QMResult result() const;
+
+    // Minterms whose cover was recomputed by the last edit (or construction)
+    size_t lastRecovered() const { return recovered; }
+
+private:
+    enum TermState : uint8_t { Off, On, DontCare };
+
+    struct Component {
+        std::vector<int> minterms;
+        CoverSelection cover;
+    };
+
+    void setState(int term, TermState state);
+    bool growPrimes(int term, std::vector<PackedCube>& removed);
+    void splitPrimes(int term, std::vector<PackedCube>& removed);
+    bool insideCareSet(PackedCube cube) const;
+    void recover(std::vector<int> minterms);
+    void rebuild();
+
+    int variables;
+    std::vector<TermState> states;     // State of every term
+    std::vector<PackedCube> primes;    // Prime implicants of ON + don't-care, unordered
+    std::vector<Component> components;
+    std::vector<size_t> freeComponents; // Slots of dissolved components
+    std::vector<int> componentOf;      // Component of every minterm, -1 for other terms
+    size_t recovered = 0;
+
+    // Scratch solver for the covers of single components
+    QM solver;
+};
+
+#endif // INCREMENTAL_H
@@ -1,55 +1,323 @@
 #include "qm.h"
-#include <iostream>
+#include "problem.h"
+#include "binary_format.h"
+#include "batch.h"
+#include "checkpoint.h"
+#include "flight_recorder.h"
+#include "result_cache.h"
+#include "server.h"
+#include "trace.h"
+#include <chrono>
+#include <csignal>
 #include <fstream>
+#include <iostream>
+#include <memory>
+#include <optional>
 #include <stdexcept>
 
 using namespace std;
 
-int main() {
+// Stops the server on Ctrl+C or SIGTERM
+static Server* runningServer = nullptr;
+
+static void stopServer(int) {
+    if (runningServer) runningServer->stop();
+}
+
+// Cancels the running minimization on Ctrl+C
+static CancellationToken interruptToken;
+
+extern "C" void cancelOnInterrupt(int) {
+    interruptToken.cancel();
+}
+
+// Writes the recorded trace to a file
+static void saveTrace(const string& filename) {
+    ofstream file(filename, ios::trunc);
+    if (!file.is_open()) {
+        throw runtime_error("Could not open " + filename + " for writing");
+    }
+    writeTrace(file);
+}
+
+// Usage: untitled7 [options] [file]   ("-" reads the problem from standard input;
+// without a file the name is asked for interactively)
+//   --to-binary FILE      write the problem as a binary problem file and exit
+//   --result-binary FILE  also write the result as a binary result file
+//   --stats               print phase times and solver counters after the results
+//   --stats-json          the same as one JSON object on a line of its own
+//   --trace FILE          record a timeline of the run (see trace.h) and write it to FILE
+//   --memory-budget-mb N  cap the scratch arena of every solve (see QM::setMemoryBudget)
+//   --time-limit SECONDS  stop the minimization after SECONDS and print what was found
+//   --progress            report the phase and work done on standard error while solving
+//   --checkpoint FILE     save the state of the minimization to FILE now and then (see checkpoint.h)
+//   --checkpoint-interval SECONDS  time between checkpoints (default 60)
+//   --resume FILE         continue the minimization saved in FILE (no input file is read)
+// Ctrl+C stops a single minimization the same way.
+// Batch mode (see batch.h), one result line per problem on standard output:
+//   --batch-dir DIR       solve every file in DIR
+//   --batch-manifest FILE solve the problem files listed in FILE
+//   --batch-stream FILE   solve the "---" separated problems in FILE ("-" = stdin)
+//   --threads N           number of worker threads (default: one per hardware thread)
+// Result cache (see result_cache.h), for single problems and batches:
+//   --cache FILE          reuse results stored in FILE and store new ones
+//   --cache-mb N          size of a new cache file in MiB (default 64)
+// Server mode (see server.h):
+//   --serve SOCKET        serve requests on a Unix domain socket until Ctrl+C or SIGTERM, with
+//                         --threads solver threads, --memory-budget-mb and --time-limit per request
+//                         (unless it brings its own) and the --cache file (default SOCKET.cache)
+//   --metrics-port N      also serve metrics in the Prometheus text format at http://127.0.0.1:N/metrics
+//   --connect SOCKET      solve a batch on the server listening on SOCKET instead of locally
+// Flight recorder (see flight_recorder.h), for batches and servers:
+//   --flight-recorder FILE  keep the slowest problems with their stats in FILE
+//   --slow-ms N           problems solved in at least N ms are recorded (default 100)
+//   --flight-records N    records kept (default 256)
+//   --replay FILE         solve the problems of a flight recorder log again with tracing on
+//                         (the trace goes to --trace FILE, default FILE.trace.json)
+int main(int argc, char* argv[]) {
     try {
         string filename;
-        cout << "Quine-McCluskey Boolean Function Minimizer\n";
-        cout << "Supports functions with up to 20 variables\n";
-        cout << "Enter input file name: ";
-        getline(cin, filename);
-
-        ifstream testFile(filename);
-        if (!testFile.is_open()) {
-            cerr << "Error: Could not open file " << filename << endl;
-            return 1;
+        string problemBinaryFile;
+        string resultBinaryFile;
+        string batchPath;
+        BatchSource batchSource = BatchSource::Directory;
+        unsigned threads = 0;
+        string cacheFile;
+        size_t cacheBytes = DEFAULT_CACHE_BYTES;
+        bool statsText = false;
+        bool statsJson = false;
+        string traceFile;
+        size_t memoryBudget = 0;
+        double timeLimit = 0;
+        bool progress = false;
+        string checkpointFile;
+        double checkpointInterval = 60;
+        string resumeFile;
+        string serveSocket;
+        string connectSocket;
+        uint16_t metricsPort = 0;
+        string flightFile;
+        double slowMs = 100;
+        size_t flightRecords = DEFAULT_FLIGHT_RECORDS;
+        string replayFile;
+        for (int i = 1; i < argc; i++) {
+            string arg = argv[i];
+            if (arg == "--to-binary" && i + 1 < argc) {
+                problemBinaryFile = argv[++i];
+            } else if (arg == "--result-binary" && i + 1 < argc) {
+                resultBinaryFile = argv[++i];
+            } else if (arg == "--stats") {
+                statsText = true;
+            } else if (arg == "--stats-json") {
+                statsJson = true;
+            } else if (arg == "--trace" && i + 1 < argc) {
+                traceFile = argv[++i];
+            } else if (arg == "--memory-budget-mb" && i + 1 < argc) {
+                memoryBudget = static_cast<size_t>(stoul(argv[++i])) << 20;
+            } else if (arg == "--time-limit" && i + 1 < argc) {
+                timeLimit = stod(argv[++i]);
+            } else if (arg == "--progress") {
+                progress = true;
+            } else if (arg == "--checkpoint" && i + 1 < argc) {
+                checkpointFile = argv[++i];
+            } else if (arg == "--checkpoint-interval" && i + 1 < argc) {
+                checkpointInterval = stod(argv[++i]);
+            } else if (arg == "--resume" && i + 1 < argc) {
+                resumeFile = argv[++i];
+            } else if (arg == "--batch-dir" && i + 1 < argc) {
+                batchSource = BatchSource::Directory;
+                batchPath = argv[++i];
+            } else if (arg == "--batch-manifest" && i + 1 < argc) {
+                batchSource = BatchSource::Manifest;
+                batchPath = argv[++i];
+            } else if (arg == "--batch-stream" && i + 1 < argc) {
+                batchSource = BatchSource::Stream;
+                batchPath = argv[++i];
+            } else if (arg == "--threads" && i + 1 < argc) {
+                threads = static_cast<unsigned>(stoul(argv[++i]));
+            } else if (arg == "--cache" && i + 1 < argc) {
+                cacheFile = argv[++i];
+            } else if (arg == "--cache-mb" && i + 1 < argc) {
+                cacheBytes = static_cast<size_t>(stoul(argv[++i])) << 20;
+            } else if (arg == "--serve" && i + 1 < argc) {
+                serveSocket = argv[++i];
+            } else if (arg == "--metrics-port" && i + 1 < argc) {
+                metricsPort = static_cast<uint16_t>(stoul(argv[++i]));
+            } else if (arg == "--connect" && i + 1 < argc) {
+                connectSocket = argv[++i];
+            } else if (arg == "--flight-recorder" && i + 1 < argc) {
+                flightFile = argv[++i];
+            } else if (arg == "--slow-ms" && i + 1 < argc) {
+                slowMs = stod(argv[++i]);
+            } else if (arg == "--flight-records" && i + 1 < argc) {
+                flightRecords = static_cast<size_t>(stoul(argv[++i]));
+            } else if (arg == "--replay" && i + 1 < argc) {
+                replayFile = argv[++i];
+            } else {
+                filename = arg;
+            }
         }
 
-        string firstLine;
-        getline(testFile, firstLine);
-        testFile.close();
+        if (!traceFile.empty()) {
+            setTracing(true);
+        }
 
-        int numVariables;
-        try {
-            numVariables = stoi(firstLine);
-            if (numVariables < 1 || numVariables > 20) {
-                throw out_of_range("Number of variables must be between 1 and 20");
-            }
+        if (!replayFile.empty()) {
+            replayFlightLog(replayFile, cout);
+            saveTrace(traceFile.empty() ? replayFile + ".trace.json" : traceFile);
+            return 0;
         }
-        catch (const exception& e) {
-            cerr << "Error in input file: " << e.what() << endl;
-            cerr << "First line must be number of variables (1-20)" << endl;
-            return 1;
+
+        unique_ptr<FlightRecorder> recorder;
+        if (!flightFile.empty()) {
+            recorder = make_unique<FlightRecorder>(
+                flightFile, chrono::duration_cast<chrono::nanoseconds>(chrono::duration<double, milli>(slowMs)),
+                flightRecords);
+        }
+
+        // A server always keeps a cache, so repeated functions stay warm
+        if (!serveSocket.empty() && cacheFile.empty()) {
+            cacheFile = serveSocket + ".cache";
+        }
+
+        unique_ptr<ResultCache> cache;
+        if (!cacheFile.empty()) {
+            cache = make_unique<ResultCache>(cacheFile, cacheBytes);
+        }
+
+        if (!serveSocket.empty()) {
+            ServerOptions options;
+            options.socketPath = serveSocket;
+            options.threads = threads;
+            options.cache = cache.get();
+            options.memoryBudget = memoryBudget;
+            options.defaultTimeLimitMs = static_cast<uint32_t>(timeLimit * 1000);
+            options.metricsPort = metricsPort;
+            options.recorder = recorder.get();
+            Server server(options);
+            runningServer = &server;
+            signal(SIGINT, stopServer);
+            signal(SIGTERM, stopServer);
+            server.run();
+            runningServer = nullptr;
+            if (recorder) recorder->flush();
+            if (!traceFile.empty()) saveTrace(traceFile);
+            return 0;
+        }
+
+        if (!batchPath.empty() && !connectSocket.empty()) {
+            BatchSummary summary = runRemoteBatch(batchSource, batchPath, cout, connectSocket,
+                                                  static_cast<uint32_t>(timeLimit * 1000));
+            printBatchSummary(summary, cerr);
+            return summary.failures == 0 ? 0 : 1;
         }
 
-        QM qm(numVariables);
+        if (!batchPath.empty()) {
+            BatchSummary summary =
+                runBatch(batchSource, batchPath, cout, threads, cache.get(), memoryBudget, recorder.get());
+            printBatchSummary(summary, cerr);
+            if (recorder) recorder->flush();
+            if (!traceFile.empty()) saveTrace(traceFile);
+            return summary.failures == 0 ? 0 : 1;
+        }
+
+        // A resumed minimization takes its problem from the checkpoint
+        optional<SolverCheckpoint> checkpoint;
+        if (!resumeFile.empty()) {
+            checkpoint = readCheckpoint(resumeFile);
+        }
+
+        if (filename.empty() && !checkpoint) {
+            cout << "Quine-McCluskey Boolean Function Minimizer\n";
+            cout << "Supports functions with up to 20 variables\n";
+            cout << "Enter input file name: ";
+            getline(cin, filename);
+        }
+
+        // The input is read and validated exactly once
+        Problem problem;
+        auto parseStart = chrono::steady_clock::now();
         try {
-            qm.readFromFile(filename);
+            TraceSpan span("load_problem");
+            problem = checkpoint ? checkpoint->problem : loadProblem(filename);
+        }
+        catch (const invalid_argument& e) {
+            cerr << e.what() << endl;
+            cerr << "Input validation failed. Cannot proceed with minimization.\n";
+            return 1;
         }
         catch (const exception& e) {
-            cerr << "Error reading file: " << e.what() << endl;
+            cerr << "Error in input file: " << e.what() << endl;
             cerr << "File format must be:\n";
-            cerr << "Line 1: Number of variables\n";
+            cerr << "Line 1: Number of variables (1-20)\n";
             cerr << "Line 2: 'maxterms' (optional) followed by terms\n";
             cerr << "Line 3: Don't-care terms (optional)\n";
+            cerr << "Multi-output: Line 2 'outputs N', then a terms line and a don't-care line per output\n";
+            cerr << "Truth table: Line 2 'truthtable', Line 3 hex table, Line 4 hex don't-care mask (optional)\n";
             return 1;
         }
 
-        qm.minimize();
+        for (const string& warning : problem.warnings) {
+            cerr << "Warning: " << warning << "\n";
+        }
+        for (const string& note : problem.notes) {
+            cout << note << "\n";
+        }
+
+        if (!problemBinaryFile.empty()) {
+            writeBinaryProblem(problem, problemBinaryFile);
+            cout << "Wrote binary problem to " << problemBinaryFile << "\n";
+            return 0;
+        }
+
+        auto parseNs = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - parseStart).count();
+
+        QM qm(problem);
+        qm.setResultCache(cache.get());
+        qm.setDetailedStats(statsText || statsJson);
+        qm.setMemoryBudget(memoryBudget);
+        qm.setCancellation(&interruptToken);
+        signal(SIGINT, cancelOnInterrupt);
+        if (timeLimit > 0) {
+            qm.setDeadline(chrono::steady_clock::now() +
+                           chrono::duration_cast<chrono::steady_clock::duration>(chrono::duration<double>(timeLimit)));
+        }
+        if (!checkpointFile.empty()) {
+            qm.setCheckpointing(checkpointFile, chrono::duration_cast<chrono::steady_clock::duration>(
+                                                    chrono::duration<double>(checkpointInterval)));
+        }
+        if (checkpoint) {
+            qm.resumeFrom(*checkpoint);
+        }
+        if (progress) {
+            // At most two reports a second
+            auto lastReport = chrono::steady_clock::now();
+            qm.setProgressCallback([lastReport](const SolveProgress& at) mutable {
+                auto now = chrono::steady_clock::now();
+                if (now - lastReport < chrono::milliseconds(500)) return;
+                lastReport = now;
+                cerr << "Progress: " << at.phase << ", level " << at.level << ", " << at.cubes << " cubes, "
+                     << at.coverNodes << " cover nodes\n";
+            });
+        }
+        QMResult result = qm.minimize();
+        if (result.stats.timed) {
+            result.stats.parseNs = static_cast<unsigned long long>(parseNs);
+        }
+        if (statsText) {
+            printStats(result.stats, cout);
+        }
+        if (statsJson) {
+            cout << statsToJson(result.stats) << "\n";
+        }
+        if (!resultBinaryFile.empty()) {
+            TraceSpan span("write_binary_result");
+            qm.writeBinaryResult(result, resultBinaryFile);
+        }
+        if (!traceFile.empty()) saveTrace(traceFile);
+        if (!result.failedPhase.empty()) {
+            return 1;
+        }
     }
     catch (const exception& e) {
         cerr << "Error: " << e.what() << endl;
@@ -57,4 +325,4 @@ int main() {
     }
 
     return 0;
-}
\ No newline at end of file
+}
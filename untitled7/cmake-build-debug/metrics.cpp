@@ -0,0 +1,185 @@
+#include "metrics.h"
+#include "result_cache.h"
+#include <algorithm>
+#include <charconv>
+#include <fstream>
+#include <iterator>
+#include <string>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Label values, in the order of ResponseStatus, MetricPhase and StopReason
+static const char* const STATUS_NAMES[] = {"solved", "stopped", "invalid", "error"};
+static const char* const PHASE_NAMES[] = {"parse", "primes", "coverage", "essentials", "cover_search"};
+static const char* const STOP_NAMES[] = {"timeout", "cancelled", "memory_budget"};
+
+void LatencyHistogram::observe(uint64_t ns) {
+    size_t bucket = 0;
+    while (bucket < LATENCY_BUCKETS && ns > LATENCY_BUCKET_NS[bucket]) bucket++;
+    counts[bucket].store(counts[bucket].load(memory_order_relaxed) + 1, memory_order_relaxed);
+    sumNs.store(sumNs.load(memory_order_relaxed) + ns, memory_order_relaxed);
+}
+
+void LatencyHistogram::addTo(vector<uint64_t>& totals, uint64_t& totalNs) const {
+    totals.resize(LATENCY_BUCKETS + 1);
+    for (size_t b = 0; b <= LATENCY_BUCKETS; b++) totals[b] += counts[b].load(memory_order_relaxed);
+    totalNs += sumNs.load(memory_order_relaxed);
+}
+
+void WorkerMetrics::recordSolve(const QMStats& stats, bool withCache) {
+    // Answers from the cache or the table ran no phases, so they would only add zeros
+    if (stats.timed && !stats.fromCache && !stats.fromTable) {
+        phases[static_cast<size_t>(MetricPhase::Parse)].observe(stats.parseNs);
+        phases[static_cast<size_t>(MetricPhase::Primes)].observe(stats.primesNs);
+        phases[static_cast<size_t>(MetricPhase::Coverage)].observe(stats.coverageNs);
+        phases[static_cast<size_t>(MetricPhase::Essentials)].observe(stats.essentialsNs);
+        phases[static_cast<size_t>(MetricPhase::CoverSearch)].observe(stats.coverSearchNs);
+    }
+    if (stats.fromTable) {
+        tableHits.add();
+    } else if (withCache) {
+        if (stats.fromCache) cacheHits.add();
+        else cacheMisses.add();
+    }
+    if (stats.scratchBytes > maxScratchBytes.load(memory_order_relaxed)) {
+        maxScratchBytes.store(stats.scratchBytes, memory_order_relaxed);
+    }
+}
+
+ServerMetrics::ServerMetrics(size_t workerCount) : start(chrono::steady_clock::now()) {
+    for (size_t w = 0; w < workerCount; w++) workers.push_back(make_unique<WorkerMetrics>());
+}
+
+// Writes a value with as many digits as it takes to read back the same double,
+// so large sums and uptimes keep their resolution
+static void writeNumber(ostream& out, double value) {
+    char buffer[32];
+    char* end = to_chars(buffer, buffer + sizeof(buffer), value).ptr;
+    out.write(buffer, end - buffer);
+}
+
+static void writeHeader(ostream& out, const char* name, const char* type, const char* help) {
+    out << "# HELP " << name << " " << help << "\n# TYPE " << name << " " << type << "\n";
+}
+
+// Writes one histogram series; labels is empty or "name=\"value\","
+static void writeHistogram(ostream& out, const char* name, const string& labels,
+                           const vector<uint64_t>& counts, uint64_t sumNs) {
+    uint64_t cumulative = 0;
+    for (size_t b = 0; b <= LATENCY_BUCKETS; b++) {
+        cumulative += counts[b];
+        out << name << "_bucket{" << labels << "le=\"";
+        if (b < LATENCY_BUCKETS) writeNumber(out, LATENCY_BUCKET_NS[b] / 1e9);
+        else out << "+Inf";
+        out << "\"} " << cumulative << "\n";
+    }
+    string selector = labels.empty() ? "" : "{" + labels.substr(0, labels.size() - 1) + "}";
+    out << name << "_sum" << selector << " ";
+    writeNumber(out, sumNs / 1e9);
+    out << "\n";
+    out << name << "_count" << selector << " " << cumulative << "\n";
+}
+
+// Resident memory of the process, where /proc tells it
+static bool residentBytes(uint64_t& bytes) {
+#ifdef _WIN32
+    return false;
+#else
+    ifstream statm("/proc/self/statm");
+    uint64_t size = 0;
+    uint64_t resident = 0;
+    if (!(statm >> size >> resident)) return false;
+    bytes = resident * static_cast<uint64_t>(sysconf(_SC_PAGESIZE));
+    return true;
+#endif
+}
+
+// Writes every metric in the Prometheus text exposition format (version 0.0.4)
+void ServerMetrics::write(ostream& out, size_t queueDepth, ResultCache* cache) const {
+    // Adds up one counter of every worker
+    auto sum = [&](auto counter) {
+        uint64_t total = 0;
+        for (const auto& worker : workers) total += counter(*worker).get();
+        return total;
+    };
+
+    writeHeader(out, "qm_uptime_seconds", "gauge", "Time since the server started.");
+    out << "qm_uptime_seconds ";
+    writeNumber(out, chrono::duration<double>(chrono::steady_clock::now() - start).count());
+    out << "\n";
+
+    writeHeader(out, "qm_connections_total", "counter", "Connections accepted.");
+    out << "qm_connections_total " << connectionsAccepted.get() << "\n";
+    writeHeader(out, "qm_bad_frames_total", "counter", "Connections dropped for a malformed request frame.");
+    out << "qm_bad_frames_total " << badFrames.get() << "\n";
+    writeHeader(out, "qm_requests_received_total", "counter", "Requests read from the connections.");
+    out << "qm_requests_received_total " << requestsRead.get() << "\n";
+
+    writeHeader(out, "qm_requests_total", "counter", "Requests answered, by response status.");
+    for (size_t s = 0; s < size(STATUS_NAMES); s++) {
+        out << "qm_requests_total{status=\"" << STATUS_NAMES[s] << "\"} "
+            << sum([&](const WorkerMetrics& worker) -> const ThreadCounter& { return worker.responses[s]; }) << "\n";
+    }
+    writeHeader(out, "qm_stopped_requests_total", "counter",
+                "Requests stopped before finishing, by reason (time limit, cancellation, memory budget).");
+    for (size_t r = 0; r < STOP_REASONS; r++) {
+        out << "qm_stopped_requests_total{reason=\"" << STOP_NAMES[r] << "\"} "
+            << sum([&](const WorkerMetrics& worker) -> const ThreadCounter& { return worker.stopped[r]; }) << "\n";
+    }
+
+    writeHeader(out, "qm_queue_depth", "gauge", "Requests waiting for a solver thread.");
+    out << "qm_queue_depth " << queueDepth << "\n";
+
+    vector<uint64_t> counts;
+    uint64_t sumNs = 0;
+    writeHeader(out, "qm_request_duration_seconds", "histogram", "Time from reading a request to answering it.");
+    for (const auto& worker : workers) worker->requestTime.addTo(counts, sumNs);
+    writeHistogram(out, "qm_request_duration_seconds", "", counts, sumNs);
+
+    counts.assign(LATENCY_BUCKETS + 1, 0);
+    sumNs = 0;
+    writeHeader(out, "qm_queue_wait_seconds", "histogram", "Time requests waited for a solver thread.");
+    for (const auto& worker : workers) worker->queueWait.addTo(counts, sumNs);
+    writeHistogram(out, "qm_queue_wait_seconds", "", counts, sumNs);
+
+    writeHeader(out, "qm_phase_duration_seconds", "histogram", "Time spent in each solver phase per solve.");
+    for (size_t p = 0; p < METRIC_PHASES; p++) {
+        counts.assign(LATENCY_BUCKETS + 1, 0);
+        sumNs = 0;
+        for (const auto& worker : workers) worker->phases[p].addTo(counts, sumNs);
+        writeHistogram(out, "qm_phase_duration_seconds", "phase=\"" + string(PHASE_NAMES[p]) + "\",", counts, sumNs);
+    }
+
+    writeHeader(out, "qm_result_cache_hits_total", "counter", "Solves answered from the result cache.");
+    out << "qm_result_cache_hits_total "
+        << sum([](const WorkerMetrics& worker) -> const ThreadCounter& { return worker.cacheHits; }) << "\n";
+    writeHeader(out, "qm_result_cache_misses_total", "counter", "Solves that missed the result cache.");
+    out << "qm_result_cache_misses_total "
+        << sum([](const WorkerMetrics& worker) -> const ThreadCounter& { return worker.cacheMisses; }) << "\n";
+    writeHeader(out, "qm_small_table_hits_total", "counter", "Solves answered from the small function table.");
+    out << "qm_small_table_hits_total "
+        << sum([](const WorkerMetrics& worker) -> const ThreadCounter& { return worker.tableHits; }) << "\n";
+    if (cache) {
+        ResultCache::Counters counters = cache->counters();
+        writeHeader(out, "qm_result_cache_entries", "gauge", "Results held by the cache file.");
+        out << "qm_result_cache_entries " << counters.entries << "\n";
+        writeHeader(out, "qm_result_cache_bytes", "gauge", "Data area of the cache file in use.");
+        out << "qm_result_cache_bytes " << counters.bytesUsed << "\n";
+        writeHeader(out, "qm_result_cache_capacity_bytes", "gauge", "Size of the data area of the cache file.");
+        out << "qm_result_cache_capacity_bytes " << counters.capacity << "\n";
+    }
+
+    uint64_t maxScratch = 0;
+    for (const auto& worker : workers) maxScratch = max(maxScratch, worker->maxScratchBytes.load(memory_order_relaxed));
+    writeHeader(out, "qm_scratch_bytes_max", "gauge", "Most scratch memory taken by a single solve.");
+    out << "qm_scratch_bytes_max " << maxScratch << "\n";
+    uint64_t resident = 0;
+    if (residentBytes(resident)) {
+        writeHeader(out, "process_resident_memory_bytes", "gauge", "Resident memory size in bytes.");
+        out << "process_resident_memory_bytes " << resident << "\n";
+    }
+}
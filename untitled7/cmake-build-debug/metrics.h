@@ -0,0 +1,101 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <iterator>
+#include <memory>
+#include <ostream>
+#include <vector>
+#include "qm_result.h"
+
+class ResultCache;
+
+// Operational metrics of the server (see server.h) in the Prometheus text
+// format. Every solver thread writes counters and histograms of its own, with
+// relaxed loads and stores only (no locks, no read-modify-write); a scrape
+// adds the threads up. A scrape may see a histogram one observation behind
+// its count, which Prometheus tolerates.
+
+// A counter with a single writer thread
+class ThreadCounter {
+public:
+    void add(uint64_t n = 1) { value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed); }
+    uint64_t get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<uint64_t> value{0};
+};
+
+// Upper bounds of the latency buckets in nanoseconds (100 us to 10 s)
+const uint64_t LATENCY_BUCKET_NS[] = {
+    100000, 250000, 500000, 1000000, 2500000, 5000000, 10000000, 25000000, 50000000,
+    100000000, 250000000, 500000000, 1000000000, 2500000000, 5000000000, 10000000000,
+};
+const size_t LATENCY_BUCKETS = std::size(LATENCY_BUCKET_NS);
+
+// A latency histogram with a single writer thread
+class LatencyHistogram {
+public:
+    void observe(uint64_t ns);
+    void observe(std::chrono::steady_clock::duration time) {
+        observe(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(time).count()));
+    }
+
+    // Adds the observations per bucket (not cumulative; the last one is +Inf) and their sum
+    void addTo(std::vector<uint64_t>& counts, uint64_t& sumNs) const;
+
+private:
+    std::atomic<uint64_t> counts[LATENCY_BUCKETS + 1] = {};
+    std::atomic<uint64_t> sumNs{0};
+};
+
+// Solver phases with a histogram each, fed by the phase timers of QMStats
+enum class MetricPhase { Parse, Primes, Coverage, Essentials, CoverSearch };
+const size_t METRIC_PHASES = 5;
+
+// Why a request was answered as Stopped
+enum class StopReason { Timeout, Cancelled, MemoryBudget };
+const size_t STOP_REASONS = 3;
+
+// What one solver thread records; only that thread writes it
+struct WorkerMetrics {
+    LatencyHistogram requestTime;      // From reading a request to answering it
+    LatencyHistogram queueWait;        // From reading a request to a worker taking it
+    LatencyHistogram phases[METRIC_PHASES];
+    ThreadCounter responses[4];        // By ResponseStatus (see server.h)
+    ThreadCounter stopped[STOP_REASONS];
+    ThreadCounter cacheHits;
+    ThreadCounter cacheMisses;
+    ThreadCounter tableHits;           // Answered from the small function table
+    std::atomic<uint64_t> maxScratchBytes{0};
+
+    // Takes the phase times (when the solve was timed and not answered from the
+    // cache or the small table), scratch memory and, when it ran with a result
+    // cache, the cache use of a solve
+    void recordSolve(const QMStats& stats, bool withCache);
+    void recordStop(StopReason reason) { stopped[static_cast<size_t>(reason)].add(); }
+};
+
+class ServerMetrics {
+public:
+    explicit ServerMetrics(size_t workers);
+
+    WorkerMetrics& worker(size_t index) { return *workers[index]; }
+
+    // Written by the thread reading the connections only
+    ThreadCounter requestsRead;
+    ThreadCounter connectionsAccepted;
+    ThreadCounter badFrames;
+
+    // Writes every metric; queueDepth is the number of requests waiting for a worker
+    void write(std::ostream& out, size_t queueDepth, ResultCache* cache) const;
+
+private:
+    std::vector<std::unique_ptr<WorkerMetrics>> workers;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif // METRICS_H
@@ -0,0 +1,272 @@
+#include "problem.h"
+#include "binary_format.h"
+#include "mapped_file.h"
+#include "term_parser.h"
+#include <algorithm>
+#include <bit>
+#include <cctype>
+#include <cstdint>
+#include <iostream>
+#include <iterator>
+#include <stdexcept>
+
+using namespace std;
+
+// Parses one term list, turning rejected tokens into warnings
+static vector<int> parseTerms(string_view line, Problem& problem) {
+    vector<int> terms;
+    vector<TermParseIssue> issues;
+    if (!parseTermList(line, terms, &issues)) {
+        for (const TermParseIssue& issue : issues) {
+            if (issue.kind == TermParseIssue::OutOfRange) {
+                problem.warnings.push_back("Term '" + issue.token + "' is out of range and will be ignored.");
+            } else if (issue.kind == TermParseIssue::InvalidRange) {
+                problem.warnings.push_back("Invalid range '" + issue.token + "' will be ignored.");
+            } else {
+                problem.warnings.push_back("Invalid term '" + issue.token + "' will be ignored.");
+            }
+        }
+    }
+    return terms;
+}
+
+// Sorts a term list and removes duplicates
+static void normalize(vector<int>& terms) {
+    sort(terms.begin(), terms.end());
+    terms.erase(unique(terms.begin(), terms.end()), terms.end());
+}
+
+// Checks ranges and overlap of one normalized pair of lists, appending error messages
+static void validate(const vector<int>& minterms, const vector<int>& dontCares, int variables,
+                     const string& prefix, vector<string>& errors) {
+    int maxTerm = (1 << variables) - 1;
+
+    vector<int> intersection;
+    set_intersection(minterms.begin(), minterms.end(), dontCares.begin(), dontCares.end(),
+                     back_inserter(intersection));
+    if (!intersection.empty()) {
+        string message = prefix + "Error: The following terms appear in both minterm and don't-care lists: ";
+        for (size_t i = 0; i < intersection.size(); i++) {
+            if (i != 0) message += ", ";
+            message += to_string(intersection[i]);
+        }
+        errors.push_back(message);
+    }
+
+    // Lists are sorted, so only the ends can be out of range
+    for (auto it = minterms.begin(); it != minterms.end() && *it < 0; ++it) {
+        errors.push_back(prefix + "Error: Minterm " + to_string(*it) + " is out of range (0-" + to_string(maxTerm) + ")");
+    }
+    for (auto it = minterms.rbegin(); it != minterms.rend() && *it > maxTerm; ++it) {
+        errors.push_back(prefix + "Error: Minterm " + to_string(*it) + " is out of range (0-" + to_string(maxTerm) + ")");
+    }
+    for (auto it = dontCares.begin(); it != dontCares.end() && *it < 0; ++it) {
+        errors.push_back(prefix + "Error: Don't-care term " + to_string(*it) + " is out of range (0-" + to_string(maxTerm) + ")");
+    }
+    for (auto it = dontCares.rbegin(); it != dontCares.rend() && *it > maxTerm; ++it) {
+        errors.push_back(prefix + "Error: Don't-care term " + to_string(*it) + " is out of range (0-" + to_string(maxTerm) + ")");
+    }
+}
+
+// Decodes a hex truth table (most significant digit first, bit t = value of term t)
+// straight into a bitmap of 64-bit words. "0x", whitespace and '_' are ignored.
+static vector<uint64_t> parseHexTable(string_view line, int variables, size_t lineNum) {
+    string digits;
+    for (char c : line) {
+        if (!isspace(static_cast<unsigned char>(c)) && c != '_') digits += c;
+    }
+    if (digits.size() > 2 && digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X')) {
+        digits.erase(0, 2);
+    }
+
+    size_t totalTerms = size_t(1) << variables;
+    size_t expectedDigits = variables >= 2 ? totalTerms / 4 : 1;
+    if (digits.size() != expectedDigits) {
+        throw runtime_error("Line " + to_string(lineNum) + ": Truth table must have " +
+                            to_string(expectedDigits) + " hex digits, found " + to_string(digits.size()));
+    }
+
+    vector<uint64_t> words((totalTerms + 63) / 64, 0);
+    for (size_t d = 0; d < digits.size(); d++) {
+        char c = digits[digits.size() - 1 - d];
+        uint64_t value;
+        if (c >= '0' && c <= '9') value = c - '0';
+        else if (c >= 'a' && c <= 'f') value = c - 'a' + 10;
+        else if (c >= 'A' && c <= 'F') value = c - 'A' + 10;
+        else throw runtime_error("Line " + to_string(lineNum) + ": Invalid hex digit '" + string(1, c) + "'");
+        words[(4 * d) / 64] |= value << ((4 * d) % 64);
+    }
+    if (totalTerms < 64 && (words[0] >> totalTerms) != 0) {
+        throw runtime_error("Line " + to_string(lineNum) + ": Truth table has bits beyond the last term");
+    }
+    return words;
+}
+
+// Lists the set bits of a bitmap; the result is sorted and unique by construction
+static vector<int> bitmapToTerms(const vector<uint64_t>& words) {
+    vector<int> terms;
+    for (size_t w = 0; w < words.size(); w++) {
+        for (uint64_t word = words[w]; word != 0; word &= word - 1) {
+            terms.push_back(static_cast<int>(w * 64) + countr_zero(word));
+        }
+    }
+    return terms;
+}
+
+// Parses and validates a problem from text in the file format
+Problem parseProblem(string_view text) {
+    vector<string_view> lines = splitLines(text);
+    size_t lineNum = 0;
+    Problem problem;
+
+    // Read number of variables (first line)
+    if (lineNum >= lines.size()) {
+        throw runtime_error("File is empty");
+    }
+    string_view firstLine = lines[lineNum++];
+    if (!parseInt(firstLine, problem.variables)) {
+        throw runtime_error("Line 1: Invalid number of variables. '" + string(firstLine) + "' is not a number");
+    }
+    if (problem.variables < 1 || problem.variables > 20) {
+        throw runtime_error("Line 1: Number of variables must be between 1 and 20");
+    }
+
+    // Read second line to determine if minterms, maxterms or several outputs follow
+    if (lineNum >= lines.size()) {
+        throw runtime_error("Missing minterms/maxterms line");
+    }
+    string_view line = lines[lineNum++];
+    string lowercaseLine(line);
+    transform(lowercaseLine.begin(), lowercaseLine.end(), lowercaseLine.begin(), ::tolower);
+
+    if (lowercaseLine.find("truthtable") != string::npos) {
+        // Truth table file: the ON table in hex, then optionally a hex don't-care mask.
+        // Tables go straight into bitmaps, so no term parsing, sorting or range checks are needed.
+        if (lineNum >= lines.size()) throw runtime_error("Missing truth table line");
+        vector<uint64_t> onTable = parseHexTable(lines[lineNum], problem.variables, lineNum + 1);
+        lineNum++;
+        vector<uint64_t> dcTable(onTable.size(), 0);
+        if (lineNum < lines.size() && lines[lineNum].find_first_not_of(" \t") != string_view::npos) {
+            dcTable = parseHexTable(lines[lineNum], problem.variables, lineNum + 1);
+        }
+
+        vector<uint64_t> overlap(onTable.size());
+        bool overlapping = false;
+        for (size_t w = 0; w < onTable.size(); w++) {
+            overlap[w] = onTable[w] & dcTable[w];
+            overlapping = overlapping || overlap[w] != 0;
+        }
+        if (overlapping) {
+            vector<int> terms = bitmapToTerms(overlap);
+            string message = "Error: The following terms appear in both minterm and don't-care lists: ";
+            for (size_t i = 0; i < terms.size(); i++) {
+                if (i != 0) message += ", ";
+                message += to_string(terms[i]);
+            }
+            throw invalid_argument(message);
+        }
+
+        problem.minterms = bitmapToTerms(onTable);
+        problem.dontCares = bitmapToTerms(dcTable);
+        return problem;
+    }
+
+    if (lowercaseLine.find("outputs") != string::npos) {
+        // Multi-output file: "outputs N", then a terms line and a don't-care line per output
+        int outputs;
+        if (!parseInt(string_view(lowercaseLine).substr(lowercaseLine.find("outputs") + 7), outputs) ||
+            outputs < 1 || outputs > 64) {
+            throw runtime_error("Line 2: Number of outputs must be between 1 and 64");
+        }
+        problem.outputMinterms.resize(outputs);
+        problem.outputDontCares.resize(outputs);
+        for (int k = 0; k < outputs; k++) {
+            if (lineNum < lines.size()) problem.outputMinterms[k] = parseTerms(lines[lineNum++], problem);
+            if (lineNum < lines.size()) problem.outputDontCares[k] = parseTerms(lines[lineNum++], problem);
+            normalize(problem.outputMinterms[k]);
+            normalize(problem.outputDontCares[k]);
+        }
+    } else {
+        if (lowercaseLine.find("maxterms") != string::npos) {
+            if (lineNum >= lines.size()) throw runtime_error("Missing maxterms line");
+            problem.fromMaxterms = true;
+
+            // All terms not in the maxterm list are minterms
+            vector<int> maxterms = parseTerms(lines[lineNum++], problem);
+            int totalTerms = 1 << problem.variables;
+            vector<char> isMaxterm(totalTerms, 0);
+            for (int m : maxterms) {
+                if (m >= 0 && m < totalTerms) isMaxterm[m] = 1;
+            }
+            for (int i = 0; i < totalTerms; i++) {
+                if (!isMaxterm[i]) problem.minterms.push_back(i);
+            }
+        } else if (lowercaseLine.find("minterms") != string::npos) {
+            if (lineNum >= lines.size()) throw runtime_error("Missing minterms line");
+            problem.minterms = parseTerms(lines[lineNum++], problem);
+            normalize(problem.minterms);
+        } else {
+            // Assume line contains minterms without keyword
+            problem.minterms = parseTerms(line, problem);
+            normalize(problem.minterms);
+        }
+
+        // Read don't-care terms if present (third line)
+        if (lineNum < lines.size()) {
+            problem.dontCares = parseTerms(lines[lineNum++], problem);
+            normalize(problem.dontCares);
+        }
+
+        if (problem.fromMaxterms) {
+            problem.notes.push_back("Processed maxterm file. Converted maxterms to minterms for minimization.");
+            // Remove don't-care terms from minterm list if they overlap
+            vector<int> newMinterms;
+            set_difference(problem.minterms.begin(), problem.minterms.end(),
+                           problem.dontCares.begin(), problem.dontCares.end(),
+                           back_inserter(newMinterms));
+            if (newMinterms.size() != problem.minterms.size()) {
+                problem.notes.push_back("Note: Removed " + to_string(problem.minterms.size() - newMinterms.size()) +
+                                        " don't-care terms from minterm list.");
+                problem.minterms = newMinterms;
+            }
+        }
+    }
+
+    validateProblem(problem);
+    return problem;
+}
+
+// Checks ranges and overlaps of a problem whose lists are already normalized
+void validateProblem(const Problem& problem) {
+    vector<string> errors;
+    if (problem.isMultiOutput()) {
+        for (size_t k = 0; k < problem.outputMinterms.size(); k++) {
+            validate(problem.outputMinterms[k], problem.outputDontCares[k], problem.variables,
+                     "F" + to_string(k) + ": ", errors);
+        }
+    } else {
+        validate(problem.minterms, problem.dontCares, problem.variables, "", errors);
+    }
+
+    if (!errors.empty()) {
+        string message = errors[0];
+        for (size_t i = 1; i < errors.size(); i++) message += "\n" + errors[i];
+        throw invalid_argument(message);
+    }
+}
+
+// Loads a problem from a file, or from standard input when source is "-"
+Problem loadProblem(const string& source) {
+    if (source == "-") {
+        string text((istreambuf_iterator<char>(cin)), istreambuf_iterator<char>());
+        if (isBinaryProblem(text)) {
+            return parseBinaryProblem(text);
+        }
+        return parseProblem(text);
+    }
+    MappedFile file(source);
+    if (isBinaryProblem(file.contents())) {
+        return parseBinaryProblem(file.contents());
+    }
+    return parseProblem(file.contents());
+}
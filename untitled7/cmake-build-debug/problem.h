@@ -0,0 +1,39 @@
+#ifndef PROBLEM_H
+#define PROBLEM_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// A minimization problem as handed to the solver: every term list is sorted,
+// duplicate free and range checked, and minterms never overlap don't-cares.
+struct Problem {
+    int variables = 0;
+    std::vector<int> minterms;
+    std::vector<int> dontCares;
+
+    // Multi-output problems use one list per output instead of the lists above
+    std::vector<std::vector<int>> outputMinterms;
+    std::vector<std::vector<int>> outputDontCares;
+
+    bool fromMaxterms = false;
+    std::vector<std::string> notes;    // Informational messages about the conversion
+    std::vector<std::string> warnings; // Ignored tokens
+
+    bool isMultiOutput() const { return !outputMinterms.empty(); }
+};
+
+// Loads a problem from a file, or from standard input when source is "-".
+// Text and binary (see binary_format.h) problem files are both accepted.
+// The input is read exactly once. Throws runtime_error if it is malformed and
+// invalid_argument (one "Error: ..." line per problem) if its terms are invalid.
+Problem loadProblem(const std::string& source);
+
+// Parses and validates a problem from text in the file format
+Problem parseProblem(std::string_view text);
+
+// Checks ranges and overlaps of a problem whose lists are already normalized.
+// Throws invalid_argument like loadProblem.
+void validateProblem(const Problem& problem);
+
+#endif // PROBLEM_H
@@ -1,19 +1,70 @@
 #include "qm.h"
+#include "problem.h"
+#include "binary_format.h"
+#include "checkpoint.h"
+#include "result_cache.h"
+#ifdef QM_SMALL_TABLE
+#include "small_table.h"
+#endif
+#include "term_parser.h"
+#include "trace.h"
 #include <iostream>
-#include <sstream>
 #include <algorithm>
+#include <bit>
+#include <chrono>
 #include <iomanip>
 #include <cmath>
-#include <fstream>
 #include <stdexcept>
 #include <cctype>
 #include <map>
+#include <memory_resource>
+#include <numeric>
 #include <set>
 #include <vector>
-#include <bitset>
+#include <functional>
 
 using namespace std;
 
+// Largest number of partial products Petrick's method may hold before switching to branch and bound
+const size_t PETRICK_PRODUCT_LIMIT = 2000;
+
+// Cover search subtrees shallower than this get a trace span of their own
+const size_t TRACE_SUBTREE_DEPTH = 2;
+
+// Calls a function when it goes out of scope, however the scope is left
+template <typename Function>
+class ScopeExit {
+public:
+    explicit ScopeExit(Function function) : function(std::move(function)) {}
+    ~ScopeExit() { function(); }
+
+    ScopeExit(const ScopeExit&) = delete;
+    ScopeExit& operator=(const ScopeExit&) = delete;
+
+private:
+    Function function;
+};
+
+// Adds the time of each phase to a QMStats field, when detailed stats are on
+class PhaseTimer {
+public:
+    explicit PhaseTimer(bool on) : on(on) {
+        if (on) start = chrono::steady_clock::now();
+    }
+
+    // Adds the time since construction or the previous lap to total
+    void lap(unsigned long long& total) {
+        if (!on) return;
+        auto now = chrono::steady_clock::now();
+        total += static_cast<unsigned long long>(chrono::duration_cast<chrono::nanoseconds>(now - start).count());
+        start = now;
+    }
+
+private:
+    bool on;
+    chrono::steady_clock::time_point start;
+};
+
 // Initializes the QM minimizer with number of variables (up to 20)
 QM::QM(int variables) : VARIABLES(variables) {
     if (variables < 1 || variables > 20) {
@@ -21,11 +72,124 @@ QM::QM(int variables) : VARIABLES(variables) {
     }
 }
 
+// Initializes the QM minimizer from an already validated problem
+QM::QM(const Problem& problem) : VARIABLES(problem.variables) {
+    load(problem);
+}
+
+// Replaces the current input with a validated problem and clears previous results
+void QM::load(const Problem& problem) {
+    if (problem.variables < 1 || problem.variables > 20) {
+        throw invalid_argument("Number of variables must be between 1 and 20.");
+    }
+    VARIABLES = problem.variables;
+    mintermList = problem.minterms;
+    dontCareList = problem.dontCares;
+    outputMintermLists = problem.outputMinterms;
+    outputDontCareLists = problem.outputDontCares;
+    inputValidated = true; // Problems are validated when they are loaded
+    clearResults();
+}
+
+// Forgets the input and all results; the scratch arena keeps its capacity
+void QM::reset() {
+    mintermList.clear();
+    dontCareList.clear();
+    outputMintermLists.clear();
+    outputDontCareLists.clear();
+    inputValidated = false;
+    clearResults();
+}
+
+// Drops the results of the last run and releases its scratch memory
+void QM::clearResults() {
+    stats = QMStats();
+    stats.timed = detailedStats;
+    phase = "";
+    interruptible = cancellation || deadline != chrono::steady_clock::time_point::max() || progressCallback;
+    polls = 0;
+    cubesProcessed = 0;
+    coverNodes = 0;
+    incumbentCover.clear();
+    checkpointError.clear();
+    primeImplicants.clear();
+    essentialPrimeImplicants.clear();
+    minimalSolutions.clear();
+    uncoveredMintermsAfterEPI.clear();
+    multiOutputPrimes.clear();
+    multiOutputTags.clear();
+    multiOutputEssentials.clear();
+    sharedProductTerms.clear();
+    outputProductTerms.clear();
+    cubes.clear(VARIABLES); // Before the arena it lives in is reset
+    arena.reset();
+}
+
+void QM::setCheckpointing(const string& filename, chrono::steady_clock::duration interval) {
+    checkpointFile = filename;
+    checkpointInterval = interval;
+    nextCheckpoint = chrono::steady_clock::now() + interval;
+}
+
+void QM::resumeFrom(const SolverCheckpoint& checkpoint) {
+    if (checkpoint.problem.isMultiOutput()) {
+        throw invalid_argument("Checkpoints only hold single-output solves");
+    }
+    load(checkpoint.problem);
+    resumeState = checkpoint;
+}
+
+bool QM::checkpointDue() const {
+    return !checkpointFile.empty() && !isMultiOutput() && chrono::steady_clock::now() >= nextCheckpoint;
+}
+
+// A checkpoint that cannot be written (full disk, unwritable directory) is
+// not worth the work done so far: the solve goes on and tries again later
+void QM::saveCheckpoint(SolverCheckpoint& checkpoint) {
+    TraceSpan span("checkpoint");
+    checkpoint.problem.variables = VARIABLES;
+    checkpoint.problem.minterms = mintermList;
+    checkpoint.problem.dontCares = dontCareList;
+    try {
+        writeCheckpoint(checkpoint, checkpointFile);
+    }
+    catch (const runtime_error& e) {
+        stats.checkpointFailures++;
+        checkpointError = e.what();
+    }
+    nextCheckpoint = chrono::steady_clock::now() + checkpointInterval;
+}
+
+vector<PackedCube> QM::packCubes(const vector<CubeId>& ids) const {
+    vector<PackedCube> packed;
+    packed.reserve(ids.size());
+    for (CubeId id : ids) packed.push_back(cubes.cube(id));
+    return packed;
+}
+
+// Reports progress, then stops solve() if it was cancelled or passed its deadline
+void QM::checkInterrupt() {
+    if (!interruptible) return;
+    if (progressCallback) {
+        progressCallback({phase, stats.combiningLevels, cubesProcessed, coverNodes});
+    }
+    if (cancellation && cancellation->cancelled()) {
+        throw SolveInterrupted("Minimization cancelled");
+    }
+    if (deadline != chrono::steady_clock::time_point::max() && chrono::steady_clock::now() >= deadline) {
+        throw SolveInterrupted("Minimization deadline passed");
+    }
+}
+
 // Converts a decimal number to binary string representation
 string QM::decToBin(int n) {
     if (VARIABLES == 0) return "";
-    // Uses bitset to handle conversion and pads to 20 bits, then truncates
-    return bitset<20>(n).to_string().substr(20 - VARIABLES);
+    // Built in place: short cubes then stay in the string's inline buffer
+    string binary(VARIABLES, '0');
+    for (int i = 0; i < VARIABLES; i++) {
+        if (n & (1 << (VARIABLES - 1 - i))) binary[i] = '1';
+    }
+    return binary;
 }
 
 //Checks if two terms differ by exactly one bit
@@ -64,7 +228,14 @@ bool QM::covers(const string& term, const string& binaryMinterm) {
 
 // Checks if a term covers a decimal minterm
 bool QM::covers(const string& term, int minterm) {
-    return covers(term, decToBin(minterm));
+    if (static_cast<int>(term.length()) != VARIABLES) return false;
+    for (int i = 0; i < VARIABLES; i++) {
+        char bit = (minterm & (1 << (VARIABLES - 1 - i))) ? '1' : '0';
+        if (term[i] != '-' && term[i] != bit) {
+            return false;
+        }
+    }
+    return true;
 }
 
 // Converts maxterms to minterms using complementation
@@ -82,298 +253,966 @@ vector<int> QM::convertMaxtermsToMinterms(const vector<int>& maxterms) {
     return minterms;
 }
 
+// Sorts cube IDs into the order of their strings
+static void sortCubes(vector<CubeId>& ids, const CubeTable& cubes) {
+    sort(ids.begin(), ids.end(),
+         [&](CubeId a, CubeId b) { return cubes.sortKey(a) < cubes.sortKey(b); });
+}
+
+// Builds the covering table of the given columns. columnKeys lists the sorted
+// row keys (minterms) every column covers; the rows are the union of them.
+static CoverTable makeCoverTable(const pmr::vector<CubeId>& columns,
+                                 const pmr::vector<pmr::vector<int>>& columnKeys,
+                                 pmr::memory_resource* scratch) {
+    CoverTable table(scratch);
+    table.columnCubes.assign(columns.begin(), columns.end());
+    for (const auto& keys : columnKeys) {
+        table.rowKeys.insert(table.rowKeys.end(), keys.begin(), keys.end());
+    }
+    sort(table.rowKeys.begin(), table.rowKeys.end());
+    table.rowKeys.erase(unique(table.rowKeys.begin(), table.rowKeys.end()), table.rowKeys.end());
+
+    table.rowColumns.resize(table.rowKeys.size());
+    table.columnRows.resize(columns.size());
+    for (size_t c = 0; c < columns.size(); c++) {
+        for (int key : columnKeys[c]) {
+            auto r = static_cast<uint32_t>(lower_bound(table.rowKeys.begin(), table.rowKeys.end(), key) -
+                                           table.rowKeys.begin());
+            table.columnRows[c].push_back(r);
+            table.rowColumns[r].push_back(static_cast<uint32_t>(c));
+        }
+    }
+    return table;
+}
+
+// Remembers the best cover the search has found so far, for partial results
+// (only kept when a solve can stop early)
+void QM::setIncumbent(const CoverTable& table, const vector<uint32_t>& columns) {
+    if (!interruptible && arena.budget() == 0) return;
+    vector<uint32_t> sorted(columns);
+    sort(sorted.begin(), sorted.end()); // Columns are in cube order
+    incumbentCover.clear();
+    for (uint32_t c : sorted) incumbentCover.push_back(table.columnCubes[c]);
+}
+
 // our function to generate all prime implicants
 void QM::generatePrimeImplicants() {
+    PhaseTimer timer(detailedStats);
+    phase = "primes";
+    primeImplicants.clear();
+    pmr::vector<CubeId> level(arena.resource());
+    if (resumeState) {
+        // Primes found before the checkpoint, and the level it was about to combine
+        for (PackedCube prime : resumeState->primes) primeImplicants.push_back(cubes.intern(prime).first);
+        if (resumeState->stage == CheckpointStage::Primes) {
+            for (PackedCube cube : resumeState->level) level.push_back(cubes.intern(cube).first);
+            stats.combiningLevels = resumeState->levels;
+        }
+    } else {
+        level = firstLevel();
+    }
+    while (!level.empty()) {
+        level = combineLevel(level);
+    }
+    sortCubes(primeImplicants, cubes);
+    timer.lap(stats.primesNs);
+}
+
+// Interns every term of ON + DC as a cube with all variables fixed
+pmr::vector<CubeId> QM::firstLevel() {
+    pmr::memory_resource* scratch = arena.resource();
+
     // Combine minterms and don't-cares, remove duplicates
-    vector<int> allTerms = mintermList;
+    pmr::vector<int> allTerms(mintermList.begin(), mintermList.end(), scratch);
     allTerms.insert(allTerms.end(), dontCareList.begin(), dontCareList.end());
     sort(allTerms.begin(), allTerms.end());
     allTerms.erase(unique(allTerms.begin(), allTerms.end()), allTerms.end());
 
-    // Convert all terms to binary strings
-    vector<string> binaryTerms;
+    uint32_t allVariables = (1u << VARIABLES) - 1;
+    pmr::vector<CubeId> level(scratch);
     for (int term : allTerms) {
-        binaryTerms.push_back(decToBin(term));
-    }
-
-    if (binaryTerms.empty()) {
-        primeImplicants.clear();
-        return;
+        level.push_back(cubes.intern({static_cast<uint32_t>(term), allVariables}).first);
     }
+    return level;
+}
 
-    // Group terms by number of 1s (key = count of 1s, value = list of terms)
-    map<int, vector<string>> groups;
-    for (const string& term : binaryTerms) {
-        int oneCount = count(term.begin(), term.end(), '1');
-        groups[oneCount].push_back(term);
+// One level of the combining loop: returns the cubes with one more dash and
+// adds the cubes of level that could not be combined to the primes
+pmr::vector<CubeId> QM::combineLevel(const pmr::vector<CubeId>& level) {
+    TraceSpan span("combine_level", "cubes", static_cast<long long>(level.size()));
+    pmr::memory_resource* scratch = arena.resource();
+    if (checkpointDue()) {
+        SolverCheckpoint checkpoint;
+        checkpoint.stage = CheckpointStage::Primes;
+        checkpoint.levels = static_cast<uint32_t>(stats.combiningLevels);
+        for (CubeId id : level) checkpoint.level.push_back(cubes.cube(id));
+        checkpoint.primes = packCubes(primeImplicants);
+        saveCheckpoint(checkpoint);
     }
-
-    // Track which terms have been combined
-    map<string, bool> isCombined;
-    for (const string& term : binaryTerms) {
-        isCombined[term] = false;
+    stats.combiningLevels++;
+    stats.levelCubes.push_back(level.size());
+    checkInterrupt();
+
+    // Group terms by number of 1s
+    pmr::vector<pmr::vector<CubeId>> groups(VARIABLES + 1, scratch);
+    for (CubeId id : level) {
+        groups[popcount(cubes.cube(id).value)].push_back(id);
     }
 
-    vector<string> currentPIs = binaryTerms;
-    bool changed = true;
-
-    // Main combining loop
-    while (changed) {
-        changed = false;
-        vector<string> nextPIs;
-        set<string> marked; // Terms that get combined
-
-        // Compare adjacent groups (terms differing by one 1 count)
-        for (auto it = groups.begin(); it != groups.end(); ++it) {
-            auto next = it;
-            ++next;
-            if (next == groups.end()) break;
-
-            // Compare all terms in current group with next group
-            for (const string& term1 : it->second) {
-                for (const string& term2 : next->second) {
-                    if (isGreyCode(term1, term2)) {
-                        string combined = combineTerms(term1, term2);
-                        if (find(nextPIs.begin(), nextPIs.end(), combined) == nextPIs.end()) {
-                            nextPIs.push_back(combined);
-                        }
-                        marked.insert(term1);
-                        marked.insert(term2);
-                        changed = true;
-                    }
-                }
-            }
-        }
-
-        // Add unmarked terms to prime implicants (they couldn't be combined further)
-        for (const string& term : currentPIs) {
-            if (marked.find(term) == marked.end()) {
-                if (find(primeImplicants.begin(), primeImplicants.end(), term) == primeImplicants.end()) {
-                    primeImplicants.push_back(term);
+    pmr::vector<CubeId> nextLevel(scratch);
+    pmr::vector<char> marked(cubes.size(), 0, scratch); // Terms that get combined
+
+    // Compare adjacent groups: cubes with the same dashes that differ in one bit combine
+    size_t tests = 0;
+    size_t merges = 0;
+    for (int ones = 0; ones < VARIABLES; ones++) {
+        if (groups[ones].empty() || groups[ones + 1].empty()) continue;
+        TraceSpan pairSpan("group_pair", "ones", ones);
+        tests += groups[ones].size() * groups[ones + 1].size();
+        for (CubeId id1 : groups[ones]) {
+            cubesProcessed++;
+            poll();
+            PackedCube term1 = cubes.cube(id1);
+            for (CubeId id2 : groups[ones + 1]) {
+                PackedCube term2 = cubes.cube(id2);
+                uint32_t difference = term1.value ^ term2.value;
+                if (term1.care != term2.care || !has_single_bit(difference)) continue;
+
+                auto [combined, added] = cubes.intern({term1.value & ~difference, term1.care & ~difference});
+                if (added) {
+                    nextLevel.push_back(combined);
                 }
+                merges++;
+                marked[id1] = 1;
+                marked[id2] = 1;
             }
         }
-
-        // Prepare for next iteration
-        if (changed) {
-            groups.clear();
-            currentPIs = nextPIs;
-            // Regroup the new combined terms
-            for (const string& term : nextPIs) {
-                int oneCount = count(term.begin(), term.end(), '1');
-                groups[oneCount].push_back(term);
-            }
+    }
+    stats.adjacencyTests += tests;
+    stats.merges += merges;
+    stats.dedupHits += merges - nextLevel.size();
+
+    // Add unmarked terms to prime implicants (they couldn't be combined further)
+    for (CubeId id : level) {
+        if (!marked[id]) {
+            primeImplicants.push_back(id);
         }
     }
+    return nextLevel;
+}
 
-    // If no combining occurred, each term is its own PI
+//Identifies essential prime implicants
+void QM::findEssentialPrimeImplicants() {
+    essentialPrimeImplicants.clear();
+    minimalSolutions.clear();
+    uncoveredMintermsAfterEPI.clear();
     if (primeImplicants.empty()) {
-        primeImplicants = binaryTerms;
+        return;
     }
-
-    // Remove duplicate prime implicants
-    sort(primeImplicants.begin(), primeImplicants.end());
-    primeImplicants.erase(unique(primeImplicants.begin(), primeImplicants.end()), primeImplicants.end());
-
-    // Build coverage map (only for minterms, not don't-cares)
-    implicantCoverage.clear();
-    for (const string& pi : primeImplicants) {
-        set<int> covered;
-        for (int minterm : mintermList) {
-            if (covers(pi, minterm)) {
-                covered.insert(minterm);
-            }
+    pmr::memory_resource* scratch = arena.resource();
+    PhaseTimer timer(detailedStats);
+
+    size_t primeCount = primeImplicants.size();
+    PrimeCoverage primeCoverage = buildCoverage();
+    timer.lap(stats.coverageNs);
+    pmr::vector<char> essential(scratch);
+    pmr::vector<char> covered(scratch);
+    selectEssentials(primeCoverage, essential, covered);
+    timer.lap(stats.essentialsNs);
+    if (uncoveredMintermsAfterEPI.empty()) {
+        return;
+    }
+    TraceSpan searchSpan("cover_search", "minterms", static_cast<long long>(uncoveredMintermsAfterEPI.size()));
+    phase = "cover_search";
+    checkInterrupt();
+
+    // Remaining PIs: non-essential ones that cover uncovered minterms
+    pmr::vector<CubeId> remainingPIs(scratch);
+    pmr::vector<pmr::vector<int>> remainingCoverage(scratch);
+    for (uint32_t p = 0; p < primeCount; p++) {
+        if (essential[p]) continue;
+
+        pmr::vector<int> coverage(scratch);
+        for (uint32_t m : primeCoverage.piMinterms[p]) {
+            if (!covered[m]) coverage.push_back(mintermList[m]);
         }
-        if (!covered.empty()) {
-            implicantCoverage[pi] = covered;
+        if (!coverage.empty()) {
+            remainingPIs.push_back(primeImplicants[p]);
+            remainingCoverage.push_back(move(coverage));
         }
     }
-}
 
-//Identifies essential prime implicants
-void QM::findEssentialPrimeImplicants() {
-    if (primeImplicants.empty()) {
-        essentialPrimeImplicants.clear();
-        minimalSolutions.clear();
+    if (remainingPIs.empty()) {
         return;
     }
 
-    // Create coverage map: minterm → list of PIs that cover it
-    map<int, vector<string>> mintermCoverage;
-    for (const auto& pi : primeImplicants) {
-        for (int minterm : mintermList) {
-            if (covers(pi, minterm)) {
-                mintermCoverage[minterm].push_back(pi);
+    // Use Petrick's method to select minimal set of remaining PIs
+    petricksMethod(makeCoverTable(remainingPIs, remainingCoverage, scratch));
+    timer.lap(stats.coverSearchNs);
+}
+
+// Coverage both ways; minterms are referred to by their index in mintermList
+PrimeCoverage QM::buildCoverage() {
+    TraceSpan span("coverage", "primes", static_cast<long long>(primeImplicants.size()));
+    phase = "coverage";
+    PrimeCoverage coverage(arena.resource());
+    size_t primeCount = primeImplicants.size();
+    coverage.mintermPIs.resize(mintermList.size());
+    coverage.piMinterms.resize(primeCount);
+    for (uint32_t p = 0; p < primeCount; p++) {
+        poll();
+        for (uint32_t m = 0; m < mintermList.size(); m++) {
+            if (cubes.covers(primeImplicants[p], mintermList[m])) {
+                coverage.mintermPIs[m].push_back(p);
+                coverage.piMinterms[p].push_back(m);
             }
         }
     }
+    return coverage;
+}
 
-    // Find essential PIs (terms that are the only cover for some minterm)
-    essentialPrimeImplicants.clear();
-    set<string> essentialPIs;
-    set<int> coveredMinterms;
-
-    for (const auto& entry : mintermCoverage) {
-        if (entry.second.size() == 1) { // Only one PI covers this minterm → essential
-            const string& essentialPI = entry.second[0];
-            if (essentialPIs.insert(essentialPI).second) {
-                essentialPrimeImplicants.push_back(essentialPI);
-                // Mark all minterms this essential PI covers
-                for (int m : implicantCoverage[essentialPI]) {
-                    coveredMinterms.insert(m);
-                }
+// Finds essential PIs (terms that are the only cover for some minterm) and the
+// minterms they leave uncovered; essential and covered are set per prime and minterm
+void QM::selectEssentials(const PrimeCoverage& coverage, pmr::vector<char>& essential, pmr::vector<char>& covered) {
+    TraceSpan span("essentials");
+    phase = "essentials";
+    essential.assign(primeImplicants.size(), 0);
+    covered.assign(mintermList.size(), 0);
+    for (const auto& pis : coverage.mintermPIs) {
+        if (pis.size() == 1 && !essential[pis[0]]) { // Only one PI covers this minterm → essential
+            essential[pis[0]] = 1;
+            essentialPrimeImplicants.push_back(primeImplicants[pis[0]]);
+            // Mark all minterms this essential PI covers
+            for (uint32_t m : coverage.piMinterms[pis[0]]) {
+                covered[m] = 1;
             }
         }
     }
 
     // Find minterms not covered by essential PIs
-    set<int> uncoveredMinterms;
-    for (int m : mintermList) {
-        if (coveredMinterms.find(m) == coveredMinterms.end()) {
-            uncoveredMinterms.insert(m);
+    for (size_t m = 0; m < mintermList.size(); m++) {
+        if (!covered[m]) {
+            uncoveredMintermsAfterEPI.push_back(mintermList[m]);
         }
     }
+}
 
-    uncoveredMintermsAfterEPI = vector<int>(uncoveredMinterms.begin(), uncoveredMinterms.end());
+// Runs essential detection and Petrick's method for minterms over the given
+// primes, without generating primes first. Replaces the results of the last run.
+CoverSelection QM::selectCover(const vector<PackedCube>& primes, const vector<int>& minterms) {
+    mintermList = minterms;
+    dontCareList.clear();
+    coverPrimes(primes);
 
-    if (uncoveredMinterms.empty()) {
-        minimalSolutions.clear();
-        return;
+    CoverSelection selection;
+    for (CubeId id : essentialPrimeImplicants) selection.essentials.push_back(cubes.cube(id));
+    if (!minimalSolutions.empty()) {
+        for (CubeId id : minimalSolutions[0]) selection.chosen.push_back(cubes.cube(id));
+    }
+    selection.uncovered = uncoveredMintermsAfterEPI;
+    return selection;
+}
+
+// Finishes solve() for the loaded problem from its primes
+QMResult QM::solveFromPrimes(const vector<PackedCube>& primes) {
+    inputValidated = false;
+    try {
+        coverPrimes(primes);
+    }
+    catch (const MemoryBudgetExceeded& e) {
+        return partialResult(e);
     }
+    catch (const SolveInterrupted& e) {
+        return partialResult(e);
+    }
+    return collectResult();
+}
 
-    // Find remaining PIs (non-essential ones that cover uncovered minterms)
-    map<string, set<int>> remainingCoverage;
-    vector<string> remainingPIs;
-    for (const string& pi : primeImplicants) {
-        if (essentialPIs.find(pi) != essentialPIs.end()) continue;
+// Runs the cover steps of solve() over the given primes of mintermList
+void QM::coverPrimes(const vector<PackedCube>& primes) {
+    clearResults();
+    for (PackedCube prime : primes) {
+        primeImplicants.push_back(cubes.intern(prime).first);
+    }
+    sortCubes(primeImplicants, cubes);
+    findEssentialPrimeImplicants();
+}
+
+// Shrinks the remaining covering table before Petrick's method.
+// Row dominance: a minterm whose PIs include all PIs of another minterm is
+// covered automatically, so it is dropped. Column dominance: a PI covering a
+// subset of another PI's minterms is never needed for a minimum cover.
+CoverTable QM::applyDominance(const CoverTable& table) {
+    pmr::memory_resource* scratch = arena.resource();
+    size_t rowCount = table.rowKeys.size();
+    size_t columnCount = table.columnCubes.size();
+    pmr::vector<char> activeRow(rowCount, 1, scratch);
+    pmr::vector<char> activeColumn(columnCount, 1, scratch);
+    pmr::vector<pmr::vector<uint32_t>> rowColumns(table.rowColumns, scratch);
+    pmr::vector<pmr::vector<uint32_t>> columnRows(table.columnRows, scratch);
 
-        set<int> coverage;
-        for (int m : uncoveredMinterms) {
-            if (covers(pi, m)) {
-                coverage.insert(m);
+    bool changed = true;
+    while (changed) {
+        changed = false;
+
+        // Row dominance
+        for (size_t r = 0; r < rowCount; r++) {
+            if (!activeRow[r]) continue;
+            for (size_t other = 0; other < rowCount; other++) {
+                if (other == r || !activeRow[other]) continue;
+                // Keep the lower minterm when two rows are identical
+                if (rowColumns[other].size() == rowColumns[r].size() && other > r) continue;
+                if (includes(rowColumns[r].begin(), rowColumns[r].end(),
+                             rowColumns[other].begin(), rowColumns[other].end())) {
+                    activeRow[r] = 0;
+                    changed = true;
+                    break;
+                }
             }
         }
-        if (!coverage.empty()) {
-            remainingPIs.push_back(pi);
-            remainingCoverage[pi] = coverage;
+        for (auto& rows : columnRows) {
+            erase_if(rows, [&](uint32_t r) { return !activeRow[r]; });
         }
-    }
 
-    if (remainingPIs.empty()) {
-        minimalSolutions.clear();
-        return;
+        // Column dominance
+        for (size_t c = 0; c < columnCount; c++) {
+            if (!activeColumn[c]) continue;
+            bool dominated = columnRows[c].empty();
+            for (size_t other = 0; other < columnCount && !dominated; other++) {
+                if (other == c || !activeColumn[other]) continue;
+                // Keep the earlier PI when two columns are identical
+                if (columnRows[other].size() == columnRows[c].size() && other > c) continue;
+                if (includes(columnRows[other].begin(), columnRows[other].end(),
+                             columnRows[c].begin(), columnRows[c].end())) {
+                    dominated = true;
+                }
+            }
+            if (dominated) {
+                activeColumn[c] = 0;
+                changed = true;
+            }
+        }
+        for (auto& columns : rowColumns) {
+            erase_if(columns, [&](uint32_t c) { return !activeColumn[c]; });
+        }
     }
 
-    // Use Petrick's method to select minimal set of remaining PIs
-    petricksMethod(remainingPIs, remainingCoverage, uncoveredMinterms);
+    // Rebuild the table from what is left
+    pmr::vector<CubeId> keptColumns(scratch);
+    pmr::vector<pmr::vector<int>> keptKeys(scratch);
+    for (size_t c = 0; c < columnCount; c++) {
+        if (!activeColumn[c]) continue;
+        keptColumns.push_back(table.columnCubes[c]);
+        pmr::vector<int> keys(scratch);
+        for (uint32_t r : columnRows[c]) keys.push_back(table.rowKeys[r]);
+        keptKeys.push_back(move(keys));
+    }
+    return makeCoverTable(keptColumns, keptKeys, scratch);
 }
 
 /* Petrick's method for selecting minimal cover of remaining minterms */
-void QM::petricksMethod(const vector<string>& remainingPIs,
-                       const map<string, set<int>>& remainingCoverage,
-                       const set<int>& uncoveredMinterms) {
+void QM::petricksMethod(const CoverTable& table) {
     minimalSolutions.clear();
 
-    if (remainingPIs.empty() || uncoveredMinterms.empty()) {
+    size_t rowCount = table.rowKeys.size();
+    size_t columnCount = table.columnCubes.size();
+    if (rowCount == 0 || columnCount == 0) {
         return;
     }
-
-    // Create product-of-sums: for each minterm, list of PIs that cover it
-    map<int, vector<string>> mintermToPIs;
-    for (int m : uncoveredMinterms) {
-        for (const string& pi : remainingPIs) {
-            if (remainingCoverage.at(pi).count(m)) {
-                mintermToPIs[m].push_back(pi);
+    stats.remainingPIs = columnCount;
+    stats.remainingMinterms = rowCount;
+    TraceSpan span("petrick", "rows", static_cast<long long>(rowCount));
+    phase = "petrick";
+    pmr::memory_resource* scratch = arena.resource();
+
+    // Product-of-sums: one sum of columns per row. Multiply the most
+    // constrained rows first to keep the products few
+    pmr::vector<uint32_t> sums(rowCount, scratch);
+    iota(sums.begin(), sums.end(), 0);
+    stable_sort(sums.begin(), sums.end(), [&](uint32_t a, uint32_t b) {
+        return table.rowColumns[a].size() < table.rowColumns[b].size();
+    });
+
+    // A greedy cover bounds the size of every minimal solution; bigger products are dropped
+    size_t bound = 0;
+    vector<uint32_t> greedy;
+    {
+        pmr::vector<char> uncovered(rowCount, 1, scratch);
+        size_t uncoveredCount = rowCount;
+        while (uncoveredCount > 0) {
+            size_t best = 0;
+            size_t bestCount = 0;
+            for (size_t c = 0; c < columnCount; c++) {
+                size_t count = 0;
+                for (uint32_t r : table.columnRows[c]) count += uncovered[r];
+                if (count > bestCount) {
+                    best = c;
+                    bestCount = count;
+                }
+            }
+            for (uint32_t r : table.columnRows[best]) {
+                uncoveredCount -= uncovered[r];
+                uncovered[r] = 0;
             }
+            greedy.push_back(static_cast<uint32_t>(best));
+            bound++;
         }
     }
 
-    // Initialize solutions with first minterm's PIs
-    vector<vector<string>> solutions;
-    if (!mintermToPIs.empty()) {
-        for (const string& pi : mintermToPIs.begin()->second) {
-            solutions.push_back({pi});
+    // Products are sorted column indices; initialize them with the first sum
+    using Product = pmr::vector<uint32_t>;
+    pmr::vector<Product> solutions(scratch);
+    for (uint32_t c : table.rowColumns[sums[0]]) {
+        solutions.emplace_back(1, c);
+    }
+    coverNodes += solutions.size();
+
+    setIncumbent(table, greedy);
+
+    // A resumed solve starts from the products of its checkpoint, or goes
+    // straight back to branch and bound
+    size_t firstSum = 1;
+    if (resumeState && resumeState->stage == CheckpointStage::BranchAndBound) {
+        minimalSolutions.push_back(branchAndBoundCover(applyDominance(table)));
+        stats.usedBranchAndBound = true;
+        return;
+    }
+    if (resumeState && resumeState->stage == CheckpointStage::Petrick) {
+        solutions.clear();
+        for (const vector<uint32_t>& product : resumeState->products) {
+            for (uint32_t c : product) {
+                if (c >= columnCount) throw runtime_error("Checkpoint does not match the problem");
+            }
+            solutions.emplace_back(product.begin(), product.end());
         }
+        firstSum = resumeState->petrickStep;
     }
 
     // Multiply solutions (AND operation between product terms)
-    for (auto it = next(mintermToPIs.begin()); it != mintermToPIs.end(); ++it) {
-        vector<vector<string>> newSolutions;
-        for (const vector<string>& sol : solutions) {
-            for (const string& pi : it->second) {
-                vector<string> newSol = sol;
-                if (find(newSol.begin(), newSol.end(), pi) == newSol.end()) {
-                    newSol.push_back(pi);
+    for (size_t i = firstSum; i < sums.size(); i++) {
+        const pmr::vector<uint32_t>& sum = table.rowColumns[sums[i]];
+
+        if (checkpointDue()) {
+            SolverCheckpoint checkpoint;
+            checkpoint.stage = CheckpointStage::Petrick;
+            checkpoint.primes = packCubes(primeImplicants);
+            checkpoint.petrickStep = static_cast<uint32_t>(i);
+            for (const Product& product : solutions) checkpoint.products.emplace_back(product.begin(), product.end());
+            saveCheckpoint(checkpoint);
+        }
+
+        // The arena keeps every step's products, so an expansion that might not
+        // fit the memory budget (counting vector growth twice) is not started
+        size_t expansionBytes = 2 * solutions.size() * sum.size() * (sizeof(Product) + bound * sizeof(uint32_t));
+        if (!arena.fits(expansionBytes)) {
+            minimalSolutions.push_back(branchAndBoundCover(applyDominance(table)));
+            stats.usedBranchAndBound = true;
+            stats.budgetFallback = true;
+            return;
+        }
+        pmr::vector<Product> newSolutions(scratch);
+        for (const Product& sol : solutions) {
+            // X(X + Y) = X: a product that already covers this minterm is kept as is
+            bool alreadyCovered = false;
+            for (uint32_t c : sum) {
+                if (binary_search(sol.begin(), sol.end(), c)) {
+                    alreadyCovered = true;
+                    break;
                 }
-                // Remove duplicates and keep sorted
-                sort(newSol.begin(), newSol.end());
-                newSol.erase(unique(newSol.begin(), newSol.end()), newSol.end());
-                // Add if not already present
-                if (find(newSolutions.begin(), newSolutions.end(), newSol) == newSolutions.end()) {
-                    newSolutions.push_back(newSol);
+            }
+            poll();
+            if (alreadyCovered) {
+                newSolutions.push_back(sol);
+                continue;
+            }
+            if (sol.size() >= bound) continue;
+
+            for (uint32_t c : sum) {
+                Product newSol(sol, scratch);
+                newSol.insert(upper_bound(newSol.begin(), newSol.end(), c), c);
+                newSolutions.push_back(move(newSol));
+            }
+        }
+        stats.petrickPartialProducts += newSolutions.size();
+        coverNodes += newSolutions.size();
+
+        // Absorption (X + XY = X): drop duplicates and products containing a smaller one
+        sort(newSolutions.begin(), newSolutions.end(), [](const Product& a, const Product& b) {
+            return a.size() != b.size() ? a.size() < b.size() : a < b;
+        });
+        solutions.clear();
+        for (Product& sol : newSolutions) {
+            bool absorbed = false;
+            for (const Product& kept : solutions) {
+                if (includes(sol.begin(), sol.end(), kept.begin(), kept.end())) {
+                    absorbed = true;
+                    break;
                 }
             }
+            if (!absorbed) {
+                solutions.push_back(move(sol));
+            }
         }
-        solutions = newSolutions;
+        stats.petrickProducts = max(stats.petrickProducts, solutions.size());
 
-        // Early exit if we find a solution with just one PI
-        bool hasMinimal = false;
-        for (const auto& sol : solutions) {
-            if (sol.size() == 1) {
-                hasMinimal = true;
-                break;
-            }
+        // Cyclic tables can make the expansion explode; find one minimum cover instead
+        if (solutions.size() > PETRICK_PRODUCT_LIMIT) {
+            minimalSolutions.push_back(branchAndBoundCover(applyDominance(table)));
+            stats.usedBranchAndBound = true;
+            return;
         }
-        if (hasMinimal) break;
     }
 
     // Find all solutions with minimal size
     if (!solutions.empty()) {
         size_t minSize = solutions[0].size();
-        for (const auto& sol : solutions) {
+        for (const Product& sol : solutions) {
             if (sol.size() < minSize) {
                 minSize = sol.size();
             }
         }
 
-        for (const auto& sol : solutions) {
+        for (const Product& sol : solutions) {
             if (sol.size() == minSize) {
-                minimalSolutions.push_back(sol);
+                vector<CubeId> solution;
+                for (uint32_t c : sol) solution.push_back(table.columnCubes[c]);
+                minimalSolutions.push_back(solution);
+            }
+        }
+    }
+}
+
+// True when the problem was given as several outputs over the same inputs
+bool QM::isMultiOutput() const {
+    return !outputMintermLists.empty();
+}
+
+// Generates multi-output prime implicants in a single combining pass.
+// Every cube carries a tag (bit k = cube lies inside ON/DC set of output k);
+// two cubes combine when their tags intersect, and a cube is only marked as
+// combined when the result keeps all of its outputs.
+void QM::generateMultiOutputPrimeImplicants() {
+    multiOutputPrimes.clear();
+    multiOutputTags.clear();
+    pmr::memory_resource* scratch = arena.resource();
+    PhaseTimer timer(detailedStats);
+    phase = "primes";
+
+    // Tag every term with the outputs for which it is a minterm or don't-care
+    pmr::map<int, unsigned long long> termTags(scratch);
+    for (size_t k = 0; k < outputMintermLists.size(); k++) {
+        unsigned long long bit = 1ULL << k;
+        for (int m : outputMintermLists[k]) termTags[m] |= bit;
+        for (int dc : outputDontCareLists[k]) termTags[dc] |= bit;
+    }
+
+    // Tags are indexed by cube ID
+    uint32_t allVariables = (1u << VARIABLES) - 1;
+    pmr::vector<unsigned long long> tags(scratch);
+    pmr::vector<CubeId> current(scratch);
+    for (const auto& entry : termTags) {
+        CubeId id = cubes.intern({static_cast<uint32_t>(entry.first), allVariables}).first;
+        tags.resize(cubes.size());
+        tags[id] = entry.second;
+        current.push_back(id);
+    }
+
+    vector<CubeId> primes;
+    while (!current.empty()) {
+        TraceSpan span("combine_level", "cubes", static_cast<long long>(current.size()));
+        stats.combiningLevels++;
+        stats.levelCubes.push_back(current.size());
+        checkInterrupt();
+
+        pmr::vector<pmr::vector<CubeId>> groups(VARIABLES + 1, scratch);
+        for (CubeId id : current) {
+            groups[popcount(cubes.cube(id).value)].push_back(id);
+        }
+        pmr::vector<CubeId> next(scratch);
+        pmr::vector<char> marked(cubes.size(), 0, scratch);
+
+        // Compare adjacent groups (terms differing by one 1 count)
+        size_t merges = 0;
+        size_t added = 0;
+        for (int ones = 0; ones < VARIABLES; ones++) {
+            if (groups[ones].empty() || groups[ones + 1].empty()) continue;
+            TraceSpan pairSpan("group_pair", "ones", ones);
+            stats.adjacencyTests += groups[ones].size() * groups[ones + 1].size();
+            for (CubeId id1 : groups[ones]) {
+                cubesProcessed++;
+                poll();
+                PackedCube term1 = cubes.cube(id1);
+                for (CubeId id2 : groups[ones + 1]) {
+                    PackedCube term2 = cubes.cube(id2);
+                    uint32_t difference = term1.value ^ term2.value;
+                    if (term1.care != term2.care || !has_single_bit(difference)) continue;
+                    unsigned long long sharedTag = tags[id1] & tags[id2];
+                    if (sharedTag == 0) continue; // No output can use the combined cube
+
+                    // The tag of a cube only depends on the cube, so duplicates can be skipped
+                    auto [combined, isNew] = cubes.intern({term1.value & ~difference, term1.care & ~difference});
+                    if (isNew) {
+                        tags.resize(cubes.size());
+                        tags[combined] = sharedTag;
+                        next.push_back(combined);
+                        added++;
+                    }
+                    merges++;
+                    if (sharedTag == tags[id1]) marked[id1] = 1;
+                    if (sharedTag == tags[id2]) marked[id2] = 1;
+                }
+            }
+        }
+
+        stats.merges += merges;
+        stats.dedupHits += merges - added;
+
+        // Unmarked cubes can't grow without losing an output: they are multi-output primes
+        for (CubeId id : current) {
+            if (!marked[id]) {
+                primes.push_back(id);
+            }
+        }
+        current.swap(next);
+    }
+
+    sortCubes(primes, cubes);
+    for (CubeId prime : primes) {
+        multiOutputPrimes.push_back(prime);
+        multiOutputTags.push_back(tags[prime]);
+    }
+    timer.lap(stats.primesNs);
+}
+
+// Selects one set of product terms covering every output, so terms are shared.
+// Rows of the covering table are (output, minterm) pairs, encoded as
+// (output << VARIABLES) | minterm, which lets Petrick's method be reused as is.
+void QM::findMultiOutputCover() {
+    multiOutputEssentials.clear();
+    sharedProductTerms.clear();
+    outputProductTerms.assign(outputMintermLists.size(), {});
+    minimalSolutions.clear();
+    pmr::memory_resource* scratch = arena.resource();
+    PhaseTimer timer(detailedStats);
+    TraceSpan span("multi_output_cover", "primes", static_cast<long long>(multiOutputPrimes.size()));
+    phase = "multi_output_cover";
+
+    // Rows of every prime restricted to the outputs it is tagged with (sorted by construction)
+    size_t primeCount = multiOutputPrimes.size();
+    pmr::vector<pmr::vector<int>> primeRows(primeCount, scratch);
+    pmr::map<int, pmr::vector<uint32_t>> rowToPIs(scratch);
+    for (uint32_t p = 0; p < primeCount; p++) {
+        for (size_t k = 0; k < outputMintermLists.size(); k++) {
+            if (!(multiOutputTags[p] & (1ULL << k))) continue;
+            for (int m : outputMintermLists[k]) {
+                if (cubes.covers(multiOutputPrimes[p], m)) {
+                    int row = (static_cast<int>(k) << VARIABLES) | m;
+                    primeRows[p].push_back(row);
+                    rowToPIs[row].push_back(p);
+                }
+            }
+        }
+    }
+    timer.lap(stats.coverageNs);
+
+    // Essential primes are the only cover of some (output, minterm) row
+    pmr::vector<char> essential(primeCount, 0, scratch);
+    pmr::set<int> coveredRows(scratch);
+    for (const auto& entry : rowToPIs) {
+        uint32_t p = entry.second[0];
+        if (entry.second.size() == 1 && !essential[p]) {
+            essential[p] = 1;
+            multiOutputEssentials.push_back(multiOutputPrimes[p]);
+            coveredRows.insert(primeRows[p].begin(), primeRows[p].end());
+        }
+    }
+
+    bool anyUncovered = false;
+    for (const auto& entry : rowToPIs) {
+        if (!coveredRows.count(entry.first)) anyUncovered = true;
+    }
+    timer.lap(stats.essentialsNs);
+
+    sharedProductTerms = multiOutputEssentials;
+    if (anyUncovered) {
+        pmr::vector<CubeId> remainingPIs(scratch);
+        pmr::vector<pmr::vector<int>> remainingCoverage(scratch);
+        for (uint32_t p = 0; p < primeCount; p++) {
+            if (essential[p]) continue;
+            pmr::vector<int> coverage(scratch);
+            for (int row : primeRows[p]) {
+                if (!coveredRows.count(row)) coverage.push_back(row);
             }
+            if (!coverage.empty()) {
+                remainingPIs.push_back(multiOutputPrimes[p]);
+                remainingCoverage.push_back(move(coverage));
+            }
+        }
+        petricksMethod(makeCoverTable(remainingPIs, remainingCoverage, scratch));
+        if (!minimalSolutions.empty()) {
+            sharedProductTerms.insert(sharedProductTerms.end(),
+                                      minimalSolutions[0].begin(), minimalSolutions[0].end());
         }
     }
+    timer.lap(stats.coverSearchNs);
+
+    // Rows of every selected term, found through the position of each prime
+    pmr::vector<uint32_t> primeIndex(cubes.size(), 0, scratch);
+    for (uint32_t p = 0; p < primeCount; p++) primeIndex[multiOutputPrimes[p]] = p;
+    pmr::vector<const pmr::vector<int>*> termRows(scratch);
+    for (CubeId term : sharedProductTerms) {
+        termRows.push_back(&primeRows[primeIndex[term]]);
+    }
+
+    // Connect each output to the selected terms it needs, dropping redundant ones
+    for (size_t k = 0; k < outputMintermLists.size(); k++) {
+        int rowBase = static_cast<int>(k) << VARIABLES;
+        int rowEnd = rowBase + (1 << VARIABLES);
+        vector<size_t> terms;
+        pmr::map<int, int> rowUses(scratch);
+        for (size_t t = 0; t < sharedProductTerms.size(); t++) {
+            const pmr::vector<int>& rows = *termRows[t];
+            auto first = lower_bound(rows.begin(), rows.end(), rowBase);
+            if (first == rows.end() || *first >= rowEnd) continue;
+            terms.push_back(t);
+            for (auto it = first; it != rows.end() && *it < rowEnd; ++it) rowUses[*it]++;
+        }
+
+        for (size_t i = terms.size(); i-- > 0;) {
+            const pmr::vector<int>& rows = *termRows[terms[i]];
+            auto first = lower_bound(rows.begin(), rows.end(), rowBase);
+            bool redundant = true;
+            for (auto it = first; it != rows.end() && *it < rowEnd; ++it) {
+                if (rowUses[*it] == 1) {
+                    redundant = false;
+                    break;
+                }
+            }
+            if (redundant) {
+                for (auto it = first; it != rows.end() && *it < rowEnd; ++it) rowUses[*it]--;
+                terms.erase(terms.begin() + i);
+            }
+        }
+        outputProductTerms[k] = terms;
+    }
+}
+
+// Exact minimum cover by branch and bound: branch on the uncovered minterm with
+// the fewest PIs, prune with a bound built from minterms that share no PI.
+// Returns one minimum cover (used when Petrick's expansion gets too large).
+vector<CubeId> QM::branchAndBoundCover(const CoverTable& table) {
+    TraceSpan span("branch_and_bound", "rows", static_cast<long long>(table.rowColumns.size()));
+    phase = "branch_and_bound";
+    const auto& rowColumns = table.rowColumns;
+    const auto& columnRows = table.columnRows;
+
+    vector<int> coverCount(rowColumns.size(), 0);
+    vector<uint32_t> selected;
+    vector<uint32_t> best;
+
+    // Start from a greedy cover so pruning is effective from the first branch
+    {
+        vector<int> counts(rowColumns.size(), 0);
+        size_t uncovered = rowColumns.size();
+        while (uncovered > 0) {
+            uint32_t bestColumn = 0;
+            int bestGain = 0;
+            for (size_t c = 0; c < columnRows.size(); c++) {
+                int gain = 0;
+                for (uint32_t r : columnRows[c]) gain += counts[r] == 0;
+                if (gain > bestGain) {
+                    bestGain = gain;
+                    bestColumn = static_cast<uint32_t>(c);
+                }
+            }
+            for (uint32_t r : columnRows[bestColumn]) {
+                if (counts[r]++ == 0) uncovered--;
+            }
+            best.push_back(bestColumn);
+        }
+    }
+    setIncumbent(table, best);
+
+    // Minterms with pairwise disjoint PI sets each need their own PI
+    auto lowerBound = [&]() {
+        vector<char> used(columnRows.size(), 0);
+        size_t bound = 0;
+        for (size_t r = 0; r < rowColumns.size(); r++) {
+            if (coverCount[r] > 0) continue;
+            bool independent = true;
+            for (uint32_t c : rowColumns[r]) {
+                if (used[c]) {
+                    independent = false;
+                    break;
+                }
+            }
+            if (!independent) continue;
+            for (uint32_t c : rowColumns[r]) used[c] = 1;
+            bound++;
+        }
+        return bound;
+    };
+
+    // Position of the column taken at every depth. A resumed search walks down
+    // the path of its checkpoint first, then carries on from there.
+    vector<uint32_t> path;
+    vector<uint32_t> resumePath;
+    if (resumeState && resumeState->stage == CheckpointStage::BranchAndBound) {
+        for (uint32_t c : resumeState->best) {
+            if (c >= columnRows.size()) throw runtime_error("Checkpoint does not match the problem");
+        }
+        best = resumeState->best;
+        resumePath = resumeState->path;
+        setIncumbent(table, best);
+    }
+    bool resuming = !resumePath.empty();
+
+    function<void()> search = [&]() {
+        coverNodes++;
+        poll();
+        if (resuming && path.size() == resumePath.size()) resuming = false;
+        if (!resuming && coverNodes % INTERRUPT_POLL_INTERVAL == 0 && checkpointDue()) {
+            SolverCheckpoint checkpoint;
+            checkpoint.stage = CheckpointStage::BranchAndBound;
+            checkpoint.primes = packCubes(primeImplicants);
+            checkpoint.path = path;
+            checkpoint.best = best;
+            saveCheckpoint(checkpoint);
+        }
+        int branchRow = -1;
+        for (size_t r = 0; r < rowColumns.size(); r++) {
+            if (coverCount[r] == 0 &&
+                (branchRow < 0 || rowColumns[r].size() < rowColumns[branchRow].size())) {
+                branchRow = static_cast<int>(r);
+            }
+        }
+        if (branchRow < 0) {
+            if (selected.size() < best.size()) {
+                best = selected;
+                setIncumbent(table, best);
+            }
+            return;
+        }
+        if (selected.size() + lowerBound() >= best.size()) return;
+
+        const auto& columns = rowColumns[branchRow];
+        size_t first = resuming ? resumePath[path.size()] : 0;
+        if (first >= columns.size()) throw runtime_error("Checkpoint does not match the problem");
+        for (size_t k = first; k < columns.size(); k++) {
+            uint32_t c = columns[k];
+            TraceSpan subtree(selected.size() < TRACE_SUBTREE_DEPTH ? "cover_subtree" : nullptr, "column", c);
+            selected.push_back(c);
+            path.push_back(static_cast<uint32_t>(k));
+            for (uint32_t r : columnRows[c]) coverCount[r]++;
+            search();
+            resuming = false;
+            for (uint32_t r : columnRows[c]) coverCount[r]--;
+            path.pop_back();
+            selected.pop_back();
+        }
+    };
+    search();
+
+    // Columns are in cube order, so sorting them sorts the cover
+    sort(best.begin(), best.end());
+    vector<CubeId> cover;
+    for (uint32_t c : best) cover.push_back(table.columnCubes[c]);
+    return cover;
 }
 
 // Converts binary representation to Boolean expression
 string QM::binaryToExpression(const string& binary) {
     if (VARIABLES == 0) return "";
+    return cubeToExpression(binary);
+}
 
-    vector<string> vars;
-    for (int i = 0; i < VARIABLES; i++) {
-        vars.push_back(string(1, 'A' + i)); // Variables are A, B, C, etc.
+// Counters and flags of QMStats by name, in the order both formats write them
+static vector<pair<const char*, unsigned long long>> statsFields(const QMStats& stats) {
+    vector<pair<const char*, unsigned long long>> fields = {
+        {"combining_levels", stats.combiningLevels},
+        {"adjacency_tests", stats.adjacencyTests},
+        {"merges", stats.merges},
+        {"dedup_hits", stats.dedupHits},
+        {"remaining_pis", stats.remainingPIs},
+        {"remaining_minterms", stats.remainingMinterms},
+        {"petrick_products", stats.petrickProducts},
+        {"petrick_partial_products", stats.petrickPartialProducts},
+        {"branch_and_bound", stats.usedBranchAndBound},
+        {"from_cache", stats.fromCache},
+        {"from_table", stats.fromTable},
+        {"bit_sliced", stats.bitSliced},
+        {"budget_fallback", stats.budgetFallback},
+        {"budget_exceeded", stats.budgetExceeded},
+        {"checkpoint_failures", stats.checkpointFailures},
+        {"scratch_bytes", stats.scratchBytes},
+    };
+    if (stats.timed) {
+        fields.insert(fields.end(), {{"parse_ns", stats.parseNs},
+                                     {"primes_ns", stats.primesNs},
+                                     {"coverage_ns", stats.coverageNs},
+                                     {"essentials_ns", stats.essentialsNs},
+                                     {"cover_search_ns", stats.coverSearchNs}});
+    }
+    return fields;
+}
+
+void printStats(const QMStats& stats, ostream& out) {
+    out << "\nStats:\n";
+    out << "  level_cubes:";
+    for (size_t count : stats.levelCubes) out << " " << count;
+    out << "\n";
+    for (const auto& [name, value] : statsFields(stats)) {
+        out << "  " << name << ": " << value << "\n";
+    }
+}
+
+string statsToJson(const QMStats& stats) {
+    string json = "{\"level_cubes\": [";
+    for (size_t i = 0; i < stats.levelCubes.size(); i++) {
+        if (i > 0) json += ", ";
+        json += to_string(stats.levelCubes[i]);
+    }
+    json += "]";
+    for (const auto& [name, value] : statsFields(stats)) {
+        json += ", \"" + string(name) + "\": " + to_string(value);
     }
+    return json + "}";
+}
 
+// Writes a cube as a product of literals, e.g. "1-0" as "AC'" (variables are A, B, C, ...)
+string cubeToExpression(const string& cube) {
     string expression;
-    for (size_t i = 0; i < binary.length(); i++) {
-        if (binary[i] == '0') {
-            expression += vars[i] + "'"; // Complemented variable
+    for (size_t i = 0; i < cube.length(); i++) {
+        if (cube[i] == '0') {
+            expression += string(1, 'A' + i) + "'"; // Complemented variable
         }
-        else if (binary[i] == '1') {
-            expression += vars[i];       // Normal variable
+        else if (cube[i] == '1') {
+            expression += string(1, 'A' + i);       // Normal variable
         }
         // '-' is ignored (don't-care)
     }
-
     return expression;
 }
 
+// Lists the outputs named by a multi-output tag, e.g. "F0, F2"
+string QM::tagToOutputs(unsigned long long tag) {
+    string outputs;
+    for (size_t k = 0; k < outputMintermLists.size(); k++) {
+        if (tag & (1ULL << k)) {
+            if (!outputs.empty()) outputs += ", ";
+            outputs += "F" + to_string(k);
+        }
+    }
+    return outputs;
+}
+
 // Prints a table showing coverage of each prime implicant
-void QM::printCoverageTable() {
+void QM::printCoverageTable(const QMResult& result) {
     cout << "\nPrime Implicants Coverage Table:\n";
     cout << "| Prime Implicant | Binary Representation | Covers Minterms | Covers Don't-cares |\n";
     cout << "|-----------------|-----------------------|-----------------|--------------------|\n";
 
-    for (const string& pi : primeImplicants) {
+    for (const string& pi : result.primeImplicants) {
         // Find covered minterms
         set<int> coveredMinterms;
         for (int m : mintermList) {
@@ -424,38 +1263,62 @@ void QM::printCoverageTable() {
     }
 }
 
-// Parses from input string ( they are comma seperated)
-vector<int> QM::parseIntegers(const string& input) {
+// Parses from input string ( they are comma seperated, "a-b" adds a whole range)
+vector<int> QM::parseIntegers(string_view input) {
     vector<int> result;
-    istringstream iss(input);
-    string token;
-    while (getline(iss, token, ',')) {
-        try {
-            // Remove whitespace
-            token.erase(remove_if(token.begin(), token.end(), ::isspace), token.end());
-            if (!token.empty()) {
-                int value = stoi(token);
-                result.push_back(value);
+    vector<TermParseIssue> issues;
+    if (!parseTermList(input, result, &issues)) {
+        for (const TermParseIssue& issue : issues) {
+            if (issue.kind == TermParseIssue::OutOfRange) {
+                cerr << "Warning: Term '" << issue.token << "' is out of range and will be ignored.\n";
+            } else if (issue.kind == TermParseIssue::InvalidRange) {
+                cerr << "Warning: Invalid range '" << issue.token << "' will be ignored.\n";
+            } else {
+                cerr << "Warning: Invalid term '" << issue.token << "' will be ignored.\n";
             }
         }
-        catch (const invalid_argument& e) {
-            cerr << "Warning: Invalid term '" << token << "' will be ignored.\n";
-        }
-        catch (const out_of_range& e) {
-            cerr << "Warning: Term '" << token << "' is out of range and will be ignored.\n";
-        }
     }
     return result;
 }
 
-// Validates input minterms and don't-cares
+// Validates input minterms and don't-cares, printing any errors
 bool QM::validateInput() {
-    // Remove duplicates
-    sort(mintermList.begin(), mintermList.end());
-    mintermList.erase(unique(mintermList.begin(), mintermList.end()), mintermList.end());
+    vector<string> errors;
+    bool valid = validateInput(errors);
+    for (const string& error : errors) {
+        cerr << error << "\n";
+    }
+    return valid;
+}
+
+// Validates input minterms and don't-cares, collecting error messages
+bool QM::validateInput(vector<string>& errors) {
+    bool valid = true;
+    if (isMultiOutput()) {
+        for (size_t k = 0; k < outputMintermLists.size(); k++) {
+            string prefix = "F" + to_string(k) + ": ";
+            if (!validateTermLists(outputMintermLists[k], outputDontCareLists[k], prefix, errors)) {
+                valid = false;
+            }
+        }
+    } else {
+        valid = validateTermLists(mintermList, dontCareList, "", errors);
+    }
+    return valid;
+}
 
-    sort(dontCareList.begin(), dontCareList.end());
-    dontCareList.erase(unique(dontCareList.begin(), dontCareList.end()), dontCareList.end());
+// Validates one pair of minterm/don't-care lists (prefix labels the output in messages)
+bool QM::validateTermLists(vector<int>& minterms, vector<int>& dontCares, const string& prefix,
+                           vector<string>& errors) {
+    // Remove duplicates (lists from loadProblem are already sorted and unique)
+    auto normalize = [](vector<int>& terms) {
+        if (adjacent_find(terms.begin(), terms.end(), greater_equal<int>()) != terms.end()) {
+            sort(terms.begin(), terms.end());
+            terms.erase(unique(terms.begin(), terms.end()), terms.end());
+        }
+    };
+    normalize(minterms);
+    normalize(dontCares);
 
     // Validate term ranges
     int maxTerm = (1 << VARIABLES) - 1;
@@ -463,49 +1326,60 @@ bool QM::validateInput() {
 
     // Check for overlapping minterms and don't-cares
     vector<int> intersection;
-    set_intersection(mintermList.begin(), mintermList.end(),
-                    dontCareList.begin(), dontCareList.end(),
+    set_intersection(minterms.begin(), minterms.end(),
+                    dontCares.begin(), dontCares.end(),
                     back_inserter(intersection));
 
     if (!intersection.empty()) {
-        cerr << "Error: The following terms appear in both minterm and don't-care lists: ";
+        string error = prefix + "Error: The following terms appear in both minterm and don't-care lists: ";
         for (size_t i = 0; i < intersection.size(); i++) {
-            if (i != 0) cerr << ", ";
-            cerr << intersection[i];
+            if (i != 0) error += ", ";
+            error += to_string(intersection[i]);
         }
-        cerr << endl;
+        errors.push_back(error);
         valid = false;
     }
 
-    // Check minterms are in valid range
-    vector<int> validMterms;
-    for (int m : mintermList) {
-        if (m < 0 || m > maxTerm) {
-            cerr << "Error: Minterm " << m << " is out of range (0-" << maxTerm << ")\n";
-            valid = false;
-        } else {
-            validMterms.push_back(m);
+    // Check minterms are in valid range (sorted, so only the ends need a look)
+    if (!minterms.empty() && (minterms.front() < 0 || minterms.back() > maxTerm)) {
+        vector<int> validMterms;
+        for (int m : minterms) {
+            if (m < 0 || m > maxTerm) {
+                errors.push_back(prefix + "Error: Minterm " + to_string(m) + " is out of range (0-" +
+                                 to_string(maxTerm) + ")");
+                valid = false;
+            } else {
+                validMterms.push_back(m);
+            }
         }
+        minterms = validMterms;
     }
-    mintermList = validMterms;
 
     // Check don't-cares are in valid range
-    vector<int> validDCs;
-    for (int dc : dontCareList) {
-        if (dc < 0 || dc > maxTerm) {
-            cerr << "Error: Don't-care term " << dc << " is out of range (0-" << maxTerm << ")\n";
-            valid = false;
-        } else {
-            validDCs.push_back(dc);
+    if (!dontCares.empty() && (dontCares.front() < 0 || dontCares.back() > maxTerm)) {
+        vector<int> validDCs;
+        for (int dc : dontCares) {
+            if (dc < 0 || dc > maxTerm) {
+                errors.push_back(prefix + "Error: Don't-care term " + to_string(dc) + " is out of range (0-" +
+                                 to_string(maxTerm) + ")");
+                valid = false;
+            } else {
+                validDCs.push_back(dc);
+            }
         }
+        dontCares = validDCs;
     }
-    dontCareList = validDCs;
 
     return valid;
 }
 
 // Generates Verilog module implementing the minimized function
-void QM::printVerilogModule() {
+void QM::printVerilogModule(const QMResult& result) {
+    if (isMultiOutput()) {
+        printMultiOutputVerilogModule(result);
+        return;
+    }
+
     cout << "\nVerilog Module (Structural):\n";
     // Module declaration
     cout << "module minimized_function(";
@@ -524,7 +1398,7 @@ void QM::printVerilogModule() {
     cout << ";\n";
     cout << "  output F;\n\n";
 
-    if (essentialPrimeImplicants.empty()) {
+    if (result.essentialPrimeImplicants.empty()) {
         // Handle constant outputs
         if (mintermList.empty()) {
             cout << "  // Constant 0 output\n";
@@ -535,28 +1409,28 @@ void QM::printVerilogModule() {
         }
     } else {
         // Declare wires for intermediate signals
-        for (size_t i = 0; i < essentialPrimeImplicants.size(); i++) {
+        for (size_t i = 0; i < result.essentialPrimeImplicants.size(); i++) {
             cout << "  wire p" << i << ";\n";
         }
-        if (!minimalSolutions.empty()) {
-            for (size_t i = 0; i < minimalSolutions[0].size(); i++) {
+        if (!result.alternatives.empty()) {
+            for (size_t i = 0; i < result.alternatives[0].size(); i++) {
                 cout << "  wire s" << i << ";\n";
             }
         }
         cout << "  wire or_out;\n\n";
 
         // Generate NOT gates for complemented inputs
-        for (size_t i = 0; i < essentialPrimeImplicants.size(); i++) {
-            const string& pi = essentialPrimeImplicants[i];
+        for (size_t i = 0; i < result.essentialPrimeImplicants.size(); i++) {
+            const string& pi = result.essentialPrimeImplicants[i];
             for (size_t j = 0; j < pi.length(); j++) {
                 if (pi[j] == '0') {
                     cout << "  not not_" << char('a' + j) << "_p" << i << "(not_" << char('a' + j) << "_p" << i << ", " << char('A' + j) << ");\n";
                 }
             }
         }
-        if (!minimalSolutions.empty()) {
-            for (size_t i = 0; i < minimalSolutions[0].size(); i++) {
-                const string& pi = minimalSolutions[0][i];
+        if (!result.alternatives.empty()) {
+            for (size_t i = 0; i < result.alternatives[0].size(); i++) {
+                const string& pi = result.alternatives[0][i];
                 for (size_t j = 0; j < pi.length(); j++) {
                     if (pi[j] == '0') {
                         cout << "  not not_" << char('a' + j) << "_s" << i << "(not_" << char('a' + j) << "_s" << i << ", " << char('A' + j) << ");\n";
@@ -567,8 +1441,8 @@ void QM::printVerilogModule() {
         cout << "\n";
 
         // Generate AND gates for product terms (essential PIs)
-        for (size_t i = 0; i < essentialPrimeImplicants.size(); i++) {
-            const string& pi = essentialPrimeImplicants[i];
+        for (size_t i = 0; i < result.essentialPrimeImplicants.size(); i++) {
+            const string& pi = result.essentialPrimeImplicants[i];
             cout << "  and and_p" << i << "(p" << i;
 
             for (size_t j = 0; j < pi.length(); j++) {
@@ -582,9 +1456,9 @@ void QM::printVerilogModule() {
         }
 
         // Generate AND gates for secondary PIs (if any)
-        if (!minimalSolutions.empty()) {
-            for (size_t i = 0; i < minimalSolutions[0].size(); i++) {
-                const string& pi = minimalSolutions[0][i];
+        if (!result.alternatives.empty()) {
+            for (size_t i = 0; i < result.alternatives[0].size(); i++) {
+                const string& pi = result.alternatives[0][i];
                 cout << "  and and_s" << i << "(s" << i;
 
                 for (size_t j = 0; j < pi.length(); j++) {
@@ -601,11 +1475,11 @@ void QM::printVerilogModule() {
 
         // Generate OR gate combining all product terms
         cout << "  or or_gate(or_out";
-        for (size_t i = 0; i < essentialPrimeImplicants.size(); i++) {
+        for (size_t i = 0; i < result.essentialPrimeImplicants.size(); i++) {
             cout << ", p" << i;
         }
-        if (!minimalSolutions.empty()) {
-            for (size_t i = 0; i < minimalSolutions[0].size(); i++) {
+        if (!result.alternatives.empty()) {
+            for (size_t i = 0; i < result.alternatives[0].size(); i++) {
                 cout << ", s" << i;
             }
         }
@@ -618,22 +1492,367 @@ void QM::printVerilogModule() {
     cout << "endmodule\n";
 }
 
+// Generates one Verilog module with an output per function; outputs share AND gates
+void QM::printMultiOutputVerilogModule(const QMResult& result) {
+    size_t outputs = outputMintermLists.size();
+    cout << "\nVerilog Module (Structural):\n";
+    // Module declaration
+    cout << "module minimized_function(";
+    for (int i = 0; i < VARIABLES; i++) {
+        if (i != 0) cout << ", ";
+        cout << char('A' + i);
+    }
+    for (size_t k = 0; k < outputs; k++) {
+        cout << ", F" << k;
+    }
+    cout << ");\n";
+
+    // Input/output declarations
+    cout << "  input ";
+    for (int i = 0; i < VARIABLES; i++) {
+        if (i != 0) cout << ", ";
+        cout << char('A' + i);
+    }
+    cout << ";\n";
+    cout << "  output ";
+    for (size_t k = 0; k < outputs; k++) {
+        if (k != 0) cout << ", ";
+        cout << "F" << k;
+    }
+    cout << ";\n\n";
+
+    // Declare one wire per shared product term and per output OR gate
+    for (size_t t = 0; t < result.cover.size(); t++) {
+        cout << "  wire t" << t << ";\n";
+    }
+    for (size_t k = 0; k < outputs; k++) {
+        cout << "  wire or_out" << k << ";\n";
+    }
+    cout << "\n";
+
+    // Generate NOT gates for complemented inputs
+    for (size_t t = 0; t < result.cover.size(); t++) {
+        const string& pi = result.cover[t];
+        for (size_t j = 0; j < pi.length(); j++) {
+            if (pi[j] == '0') {
+                cout << "  not not_" << char('a' + j) << "_t" << t << "(not_" << char('a' + j) << "_t" << t << ", " << char('A' + j) << ");\n";
+            }
+        }
+    }
+    cout << "\n";
+
+    // Generate one AND gate per product term, used by every output that needs it
+    for (size_t t = 0; t < result.cover.size(); t++) {
+        const string& pi = result.cover[t];
+        if (pi.find_first_not_of('-') == string::npos) {
+            cout << "  buf(t" << t << ", 1'b1);\n";
+            continue;
+        }
+        cout << "  and and_t" << t << "(t" << t;
+        for (size_t j = 0; j < pi.length(); j++) {
+            if (pi[j] == '0') {
+                cout << ", not_" << char('a' + j) << "_t" << t;
+            } else if (pi[j] == '1') {
+                cout << ", " << char('A' + j);
+            }
+        }
+        cout << ");\n";
+    }
+    cout << "\n";
+
+    // Generate one OR gate per output over its shared product terms
+    for (size_t k = 0; k < outputs; k++) {
+        if (result.outputTerms[k].empty()) {
+            cout << "  // Constant 0 output\n";
+            cout << "  buf(F" << k << ", 1'b0);\n";
+            continue;
+        }
+        cout << "  or or_gate" << k << "(or_out" << k;
+        for (size_t t : result.outputTerms[k]) {
+            cout << ", t" << t;
+        }
+        cout << ");\n";
+        cout << "  buf(F" << k << ", or_out" << k << ");\n";
+    }
+
+    cout << "endmodule\n";
+}
+
+// Multi-output minimization: shared primes, joint cover and per-output expressions
+void QM::printMultiOutputResults(const QMResult& result) {
+    cout << "\n--- Quine-McCluskey Multi-Output Minimization Results ---\n";
+    cout << "Number of variables: " << VARIABLES << "\n";
+    cout << "Number of outputs: " << outputMintermLists.size() << "\n";
+    for (size_t k = 0; k < outputMintermLists.size(); k++) {
+        cout << "F" << k << " minterms: ";
+        for (size_t i = 0; i < outputMintermLists[k].size(); i++) {
+            if (i != 0) cout << ", ";
+            cout << outputMintermLists[k][i];
+        }
+        if (outputMintermLists[k].empty()) cout << "None";
+        cout << "; don't-cares: ";
+        for (size_t i = 0; i < outputDontCareLists[k].size(); i++) {
+            if (i != 0) cout << ", ";
+            cout << outputDontCareLists[k][i];
+        }
+        if (outputDontCareLists[k].empty()) cout << "None";
+        cout << "\n";
+    }
+
+    // Print all multi-output prime implicants with the outputs they may feed
+    cout << "\nAll Multi-Output Prime Implicants (" << result.primeImplicants.size() << "):\n";
+    for (size_t i = 0; i < result.primeImplicants.size(); i++) {
+        cout << binaryToExpression(result.primeImplicants[i]) << " (" << result.primeImplicants[i]
+             << ") [" << tagToOutputs(result.primeTags[i]) << "]\n";
+    }
+
+    cout << "\nEssential Prime Implicants (" << result.essentialPrimeImplicants.size() << "):\n";
+    for (const string& epi : result.essentialPrimeImplicants) {
+        cout << binaryToExpression(epi) << " (" << epi << ")\n";
+    }
+
+    cout << "\nShared Product Terms (" << result.cover.size() << "):\n";
+    for (size_t t = 0; t < result.cover.size(); t++) {
+        string users;
+        for (size_t k = 0; k < result.outputTerms.size(); k++) {
+            if (find(result.outputTerms[k].begin(), result.outputTerms[k].end(), t) != result.outputTerms[k].end()) {
+                if (!users.empty()) users += ", ";
+                users += "F" + to_string(k);
+            }
+        }
+        string expression = binaryToExpression(result.cover[t]);
+        cout << "t" << t << " = " << (expression.empty() ? "1" : expression) << " (" << result.cover[t]
+             << ") used by [" << users << "]\n";
+    }
+
+    cout << "\nMinimized Boolean Expressions:\n";
+    for (size_t k = 0; k < result.outputTerms.size(); k++) {
+        cout << "F" << k << " = ";
+        if (result.outputTerms[k].empty()) {
+            cout << "0";
+        }
+        bool first = true;
+        for (size_t t : result.outputTerms[k]) {
+            if (!first) cout << " + ";
+            string expression = binaryToExpression(result.cover[t]);
+            cout << (expression.empty() ? "1" : expression);
+            first = false;
+        }
+        cout << "\n";
+    }
+
+    cout << endl;
+
+    // Generate Verilog implementation
+    printVerilogModule(result);
+}
+
+// Gathers the results of the last solve() call
+QMResult QM::collectResult() const {
+    // Cubes are only turned into strings here, once per result
+    auto toStrings = [&](const vector<CubeId>& ids) {
+        vector<string> strings;
+        strings.reserve(ids.size());
+        for (CubeId id : ids) strings.push_back(cubes.toString(id));
+        return strings;
+    };
+
+    QMResult result;
+    result.variables = VARIABLES;
+    result.stats = stats;
+    result.stats.scratchBytes = arena.used();
+    result.checkpointError = checkpointError;
+    if (isMultiOutput()) {
+        result.primeImplicants = toStrings(multiOutputPrimes);
+        result.primeTags = multiOutputTags;
+        result.essentialPrimeImplicants = toStrings(multiOutputEssentials);
+        result.cover = toStrings(sharedProductTerms);
+        result.outputTerms = outputProductTerms;
+        return result;
+    }
+
+    result.primeImplicants = toStrings(primeImplicants);
+    result.essentialPrimeImplicants = toStrings(essentialPrimeImplicants);
+    result.uncoveredAfterEssentials = uncoveredMintermsAfterEPI;
+    result.cover = result.essentialPrimeImplicants;
+    for (const vector<CubeId>& solution : minimalSolutions) {
+        result.alternatives.push_back(toStrings(solution));
+    }
+    if (!result.alternatives.empty()) {
+        result.cover.insert(result.cover.end(), result.alternatives[0].begin(), result.alternatives[0].end());
+    }
+    return result;
+}
+
+// What a solve() that ran out of its memory budget or was interrupted had found, marked invalid
+QMResult QM::partialResult(const runtime_error& error) const {
+    QMResult result = collectResult();
+    if (!isMultiOutput() && minimalSolutions.empty() && !incumbentCover.empty()) {
+        result.alternatives.emplace_back();
+        for (CubeId id : incumbentCover) result.alternatives[0].push_back(cubes.toString(id));
+        result.cover.insert(result.cover.end(), result.alternatives[0].begin(), result.alternatives[0].end());
+    }
+    result.valid = false;
+    result.failedPhase = phase;
+    result.stats.budgetExceeded = dynamic_cast<const MemoryBudgetExceeded*>(&error) != nullptr;
+    result.errors.push_back("Error: " + string(error.what()) + " in phase " + phase + ".");
+    return result;
+}
+
+// Writes a result as a binary result file
+void QM::writeBinaryResult(const QMResult& result, const string& filename) {
+    BinaryWriter writer;
+    writer.raw(encodeBinaryResult(packResult(result)));
+    writer.writeToFile(filename);
+}
+
+// Runs every minimization step without printing anything
+QMResult QM::solve() {
+    TraceSpan span("solve", "variables", VARIABLES);
+    clearResults();
+    // A checkpoint is resumed once, whether the solve finishes, stops or throws
+    ScopeExit forgetResumeState([&] { resumeState.reset(); });
+
+    // Input from load() was validated already; anything else is checked here
+    bool validated = inputValidated;
+    inputValidated = false;
+    vector<string> errors;
+    if (!validated && !validateInput(errors)) {
+        QMResult result;
+        result.valid = false;
+        result.errors = errors;
+        result.variables = VARIABLES;
+        return result;
+    }
+
+    QMResult result;
+#ifdef QM_SMALL_TABLE
+    // Small functions are looked up instead (qm-tablegen builds the table without this)
+    if (!resumeState && !isMultiOutput() && solveSmallFunction(VARIABLES, mintermList, dontCareList, result)) return result;
+#endif
+
+    // The cache is keyed by the NP class of the validated input. A miss solves
+    // the canonical representative and maps it back just like a hit, so the
+    // result does not depend on which member of the class was solved first.
+    // Checkpoints hold the input as given, so checkpointed solves skip the cache.
+    ResultCache::Key key;
+    bool cached = resultCache && !resumeState && checkpointFile.empty();
+    if (cached) {
+        Problem problem;
+        problem.variables = VARIABLES;
+        problem.minterms = mintermList;
+        problem.dontCares = dontCareList;
+        problem.outputMinterms = outputMintermLists;
+        problem.outputDontCares = outputDontCareLists;
+        key = ResultCache::key(problem);
+        TraceSpan span("cache_lookup");
+        if (resultCache->lookup(key, result)) return result;
+    }
+    // Swaps the input and the canonical problem; the input is back however
+    // the solve ends, exceptions included
+    auto swapCanonical = [&] {
+        if (!cached) return;
+        swap(mintermList, key.canonical.minterms);
+        swap(dontCareList, key.canonical.dontCares);
+        swap(outputMintermLists, key.canonical.outputMinterms);
+        swap(outputDontCareLists, key.canonical.outputDontCares);
+    };
+    // Maps a result of the canonical problem back to the input
+    auto fromSolved = [&](const QMResult& solved) {
+        return cached ? fromCanonical(solved, key.transform) : solved;
+    };
+
+    swapCanonical();
+    ScopeExit restoreInput(swapCanonical);
+    try {
+        if (isMultiOutput()) {
+            generateMultiOutputPrimeImplicants();
+            findMultiOutputCover();
+        } else if (!mintermList.empty() || !dontCareList.empty()) {
+            generatePrimeImplicants();
+            findEssentialPrimeImplicants();
+        }
+    }
+    catch (const MemoryBudgetExceeded& e) {
+        return fromSolved(partialResult(e));
+    }
+    catch (const SolveInterrupted& e) {
+        return fromSolved(partialResult(e));
+    }
+    result = collectResult();
+    if (cached) {
+        TraceSpan span("cache_store");
+        resultCache->store(key, result);
+    }
+    return fromSolved(result);
+}
+
+// Solves a validated problem without any I/O, using the scratch state of context
+QMResult solve(const Problem& problem, SolverContext& context) {
+    if (problem.variables < 1 || problem.variables > 20) {
+        QMResult result;
+        result.valid = false;
+        result.errors.push_back("Error: Number of variables must be between 1 and 20.");
+        result.variables = problem.variables;
+        return result;
+    }
+    context.qm.load(problem);
+    return context.qm.solve();
+}
+
+// Solves a validated problem with a context that lives only for this call
+QMResult solveProblem(const Problem& problem) {
+    SolverContext context;
+    return solve(problem, context);
+}
+
 // our minimization function that coordinates all steps ( output function)
-void QM::minimize() {
-    if (!validateInput()) {
+QMResult QM::minimize() {
+    QMResult result = solve();
+    if (!result.checkpointError.empty()) {
+        cerr << "Warning: " << result.stats.checkpointFailures
+             << " checkpoints could not be written, the last one: " << result.checkpointError << "\n";
+    }
+    if (!result.valid) {
+        for (const string& error : result.errors) {
+            cerr << error << "\n";
+        }
+        if (!result.failedPhase.empty()) {
+            cerr << "Minimization stopped with " << result.primeImplicants.size() << " prime implicants found.\n";
+            if (!result.isMultiOutput() && !result.alternatives.empty()) {
+                // Not known to be minimal
+                cout << "\nBest cover found (" << result.cover.size() << " terms): ";
+                for (size_t i = 0; i < result.cover.size(); i++) {
+                    if (i != 0) cout << " + ";
+                    cout << binaryToExpression(result.cover[i]);
+                }
+                cout << "\n";
+            }
+            return result;
+        }
         cerr << "Input validation failed. Cannot proceed with minimization.\n";
-        return;
+        return result;
     }
 
-    if (mintermList.empty() && dontCareList.empty()) {
+    bool anyTerms = !mintermList.empty() || !dontCareList.empty();
+    for (size_t k = 0; k < outputMintermLists.size(); k++) {
+        if (!outputMintermLists[k].empty() || !outputDontCareLists[k].empty()) anyTerms = true;
+    }
+    if (!anyTerms) {
         cout << "No minterms or don't-care terms provided. Nothing to minimize.\n";
-        return;
+        return result;
     }
 
-    // Execute minimization steps
-    generatePrimeImplicants();
-    findEssentialPrimeImplicants();
+    if (isMultiOutput()) {
+        printMultiOutputResults(result);
+    } else {
+        printResults(result);
+    }
+    return result;
+}
 
+// Prints the results of a single-output minimization
+void QM::printResults(const QMResult& result) {
     // Print results
     cout << "\n--- Quine-McCluskey Minimization Results ---\n";
     cout << "Number of variables: " << VARIABLES << "\n";
@@ -652,33 +1871,33 @@ void QM::minimize() {
     cout << "\n";
 
     // Print all prime implicants
-    cout << "\nAll Prime Implicants (" << primeImplicants.size() << "):\n";
-    for (const string& pi : primeImplicants) {
+    cout << "\nAll Prime Implicants (" << result.primeImplicants.size() << "):\n";
+    for (const string& pi : result.primeImplicants) {
         cout << binaryToExpression(pi) << " (" << pi << ")\n";
     }
 
     // Print essential prime implicants
-    cout << "\nEssential Prime Implicants (" << essentialPrimeImplicants.size() << "):\n";
-    for (const string& epi : essentialPrimeImplicants) {
+    cout << "\nEssential Prime Implicants (" << result.essentialPrimeImplicants.size() << "):\n";
+    for (const string& epi : result.essentialPrimeImplicants) {
         cout << binaryToExpression(epi) << " (" << epi << ")\n";
     }
 
     // Print uncovered minterms (if any)
-    if (!uncoveredMintermsAfterEPI.empty()) {
+    if (!result.uncoveredAfterEssentials.empty()) {
         cout << "\nMinterms not covered by essential PIs: ";
-        for (size_t i = 0; i < uncoveredMintermsAfterEPI.size(); i++) {
+        for (size_t i = 0; i < result.uncoveredAfterEssentials.size(); i++) {
             if (i != 0) cout << ", ";
-            cout << uncoveredMintermsAfterEPI[i];
+            cout << result.uncoveredAfterEssentials[i];
         }
         cout << "\n";
     }
 
     // Print coverage table
-    printCoverageTable();
+    printCoverageTable(result);
 
     // Print minimized expression
     cout << "\nMinimized Boolean Expression: ";
-    if (essentialPrimeImplicants.empty()) {
+    if (result.essentialPrimeImplicants.empty()) {
         if (mintermList.empty()) {
             cout << "0 (No minterms)";
         } else {
@@ -687,15 +1906,15 @@ void QM::minimize() {
     } else {
         bool first = true;
         // Print essential PIs
-        for (const string& epi : essentialPrimeImplicants) {
+        for (const string& epi : result.essentialPrimeImplicants) {
             if (!first) cout << " + ";
             cout << binaryToExpression(epi);
             first = false;
         }
 
         // Print additional PIs from minimal solution (if any)
-        if (!minimalSolutions.empty()) {
-            for (const string& pi : minimalSolutions[0]) {
+        if (!result.alternatives.empty()) {
+            for (const string& pi : result.alternatives[0]) {
                 if (!first) cout << " + ";
                 cout << binaryToExpression(pi);
                 first = false;
@@ -704,17 +1923,17 @@ void QM::minimize() {
     }
 
     // Print alternative solutions (if any)
-    if (!minimalSolutions.empty() && minimalSolutions.size() > 1) {
-        cout << "\n\nAlternative minimal solutions (" << minimalSolutions.size() << "):\n";
-        for (size_t i = 0; i < minimalSolutions.size(); i++) {
+    if (!result.alternatives.empty() && result.alternatives.size() > 1) {
+        cout << "\n\nAlternative minimal solutions (" << result.alternatives.size() << "):\n";
+        for (size_t i = 0; i < result.alternatives.size(); i++) {
             cout << "Solution " << (i+1) << ": ";
             bool firstTerm = true;
-            for (const string& pi : essentialPrimeImplicants) {
+            for (const string& pi : result.essentialPrimeImplicants) {
                 if (!firstTerm) cout << " + ";
                 cout << binaryToExpression(pi);
                 firstTerm = false;
             }
-            for (const string& pi : minimalSolutions[i]) {
+            for (const string& pi : result.alternatives[i]) {
                 if (!firstTerm) cout << " + ";
                 cout << binaryToExpression(pi);
                 firstTerm = false;
@@ -726,115 +1945,17 @@ void QM::minimize() {
     cout << endl;
 
     // Generate Verilog implementation
-    printVerilogModule();
+    printVerilogModule(result);
 }
 
 // Reads minimization problem from file
 void QM::readFromFile(const string& filename) {
-    ifstream infile(filename);
-    if (!infile.is_open()) {
-        throw runtime_error("Could not open file: " + filename);
-    }
-
-    string line;
-    int lineNum = 0;
-    bool isMaxtermFile = false;
-
-    // Reset previous data
-    mintermList.clear();
-    dontCareList.clear();
-    primeImplicants.clear();
-    essentialPrimeImplicants.clear();
-    implicantCoverage.clear();
-    minimalSolutions.clear();
-    uncoveredMintermsAfterEPI.clear();
-
-    // Read number of variables (first line)
-    if (getline(infile, line)) {
-        lineNum++;
-        try {
-            VARIABLES = stoi(line);
-            if (VARIABLES < 1 || VARIABLES > 20) {
-                throw out_of_range("Number of variables must be between 1 and 20");
-            }
-        }
-        catch (const exception& e) {
-            throw runtime_error("Line " + to_string(lineNum) + ": Invalid number of variables. " + e.what());
-        }
-    }
-    else {
-        throw runtime_error("File is empty");
-    }
-
-    // Read second line to determine if minterms or maxterms
-    if (getline(infile, line)) {
-        lineNum++;
-        string lowercaseLine = line;
-        transform(lowercaseLine.begin(), lowercaseLine.end(), lowercaseLine.begin(), ::tolower);
-
-        if (lowercaseLine.find("maxterms") != string::npos) {
-            isMaxtermFile = true;
-            // Read maxterms from next line
-            if (getline(infile, line)) {
-                lineNum++;
-                vector<int> maxterms = parseIntegers(line);
-                mintermList = convertMaxtermsToMinterms(maxterms);
-            }
-            else {
-                throw runtime_error("Missing maxterms line");
-            }
-        }
-        else if (lowercaseLine.find("minterms") != string::npos) {
-            // Read minterms from next line
-            if (getline(infile, line)) {
-                lineNum++;
-                mintermList = parseIntegers(line);
-            }
-            else {
-                throw runtime_error("Missing minterms line");
-            }
-        }
-        else {
-            // Assume line contains minterms without keyword
-            mintermList = parseIntegers(line);
-        }
+    Problem problem = loadProblem(filename);
+    for (const string& warning : problem.warnings) {
+        cerr << "Warning: " << warning << "\n";
     }
-    else {
-        throw runtime_error("Missing minterms/maxterms line");
-    }
-
-    // Read don't-care terms if present (third line)
-    if (getline(infile, line)) {
-        lineNum++;
-        dontCareList = parseIntegers(line);
+    for (const string& note : problem.notes) {
+        cout << note << "\n";
     }
-
-    infile.close();
-
-    // Remove duplicates
-    sort(mintermList.begin(), mintermList.end());
-    mintermList.erase(unique(mintermList.begin(), mintermList.end()), mintermList.end());
-
-    sort(dontCareList.begin(), dontCareList.end());
-    dontCareList.erase(unique(dontCareList.begin(), dontCareList.end()), dontCareList.end());
-
-    if (isMaxtermFile) {
-        cout << "Processed maxterm file. Converted maxterms to minterms for minimization.\n";
-        // Remove don't-care terms from minterm list if they overlap
-        vector<int> intersection;
-        set_intersection(mintermList.begin(), mintermList.end(),
-                        dontCareList.begin(), dontCareList.end(),
-                        back_inserter(intersection));
-
-        if (!intersection.empty()) {
-            vector<int> newMinterms;
-            set_difference(mintermList.begin(), mintermList.end(),
-                         dontCareList.begin(), dontCareList.end(),
-                         back_inserter(newMinterms));
-            mintermList = newMinterms;
-
-            cout << "Note: Removed " << intersection.size()
-                 << " don't-care terms from minterm list.\n";
-        }
-    }
-}
\ No newline at end of file
+    load(problem);
+}
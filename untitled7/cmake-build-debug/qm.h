@@ -1,34 +1,178 @@
 #ifndef QM_H
 #define QM_H
 
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <iosfwd>
 #include <vector>
+#include <stdexcept>
 #include <string>
+#include <string_view>
 #include <map>
 #include <set>
+#include <memory_resource>
+#include <optional>
+#include "arena.h"
+#include "checkpoint.h"
+#include "cube_table.h"
+#include "qm_result.h"
+
+struct Problem;
+class ResultCache;
+
+// Covering table left after the essential primes, allocated from the solver's
+// arena. Rows are minterms (or encoded output/minterm rows), columns are
+// candidate primes in cube order; both are referred to by index.
+struct CoverTable {
+    explicit CoverTable(std::pmr::memory_resource* resource)
+        : rowKeys(resource), columnCubes(resource), rowColumns(resource), columnRows(resource) {}
+
+    std::pmr::vector<int> rowKeys;                            // Sorted minterm of every row
+    std::pmr::vector<CubeId> columnCubes;                     // Prime of every column
+    std::pmr::vector<std::pmr::vector<uint32_t>> rowColumns;  // Sorted columns covering each row
+    std::pmr::vector<std::pmr::vector<uint32_t>> columnRows;  // Sorted rows covered by each column
+};
+
+// Which primes cover which minterms, both ways, as indices into
+// primeImplicants and mintermList; allocated from the solver's arena
+struct PrimeCoverage {
+    explicit PrimeCoverage(std::pmr::memory_resource* resource) : mintermPIs(resource), piMinterms(resource) {}
+
+    std::pmr::vector<std::pmr::vector<uint32_t>> mintermPIs;
+    std::pmr::vector<std::pmr::vector<uint32_t>> piMinterms;
+};
+
+// Stops solves from another thread (or a signal handler): every solve() that
+// was given the token checks it while it runs (see QM::setCancellation)
+class CancellationToken {
+public:
+    void cancel() { flag.store(true, std::memory_order_relaxed); }
+    void reset() { flag.store(false, std::memory_order_relaxed); }
+    bool cancelled() const { return flag.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<bool> flag{false};
+};
+
+// Where a running solve() is, as given to its progress callback
+struct SolveProgress {
+    const char* phase = "";    // "primes", "coverage", "essentials", "petrick", ...
+    size_t level = 0;          // Combining levels started
+    size_t cubes = 0;          // Cubes compared against their neighbour group so far
+    size_t coverNodes = 0;     // Products formed by Petrick's method plus branch and bound nodes
+};
+using ProgressCallback = std::function<void(const SolveProgress&)>;
+
+// Thrown inside solve() when it is cancelled or passes its deadline; solve()
+// catches it and returns what was known at that point
+class SolveInterrupted : public std::runtime_error {
+public:
+    using std::runtime_error::runtime_error;
+};
+
+// The combining loop and the cover search check for cancellation, the deadline
+// and progress once every this many steps (and on every combining level)
+const size_t INTERRUPT_POLL_INTERVAL = 1024;
+
+// Essentials and one minimum cover of a set of minterms (see QM::selectCover)
+struct CoverSelection {
+    std::vector<PackedCube> essentials;
+    std::vector<PackedCube> chosen;   // Non-essential part of the cover
+    std::vector<int> uncovered;       // Minterms left after the essentials
+};
 
 class QM {
 public:
     QM(int variables);
+    QM(const Problem& problem);
+
+    // Main minimization function (prints the results and returns them)
+    QMResult minimize();
+
+    // Minimizes without any I/O and returns everything that was found
+    QMResult solve();
+
+    // Answers solve() from cache when it holds the problem, and stores new
+    // results in it (nullptr turns caching off). With a cache, solve() works on
+    // the canonical form of the problem (see result_cache.h); solves that write
+    // checkpoints do not use it.
+    void setResultCache(ResultCache* cache) { resultCache = cache; }
+    ResultCache* cache() const { return resultCache; }
+
+    // Times the phases of solve() into QMStats (off by default; the counters are always kept)
+    void setDetailedStats(bool on) { detailedStats = on; }
+
+    // Caps the scratch memory of one solve() in bytes (0 = no cap, the default).
+    // Petrick's method switches to branch and bound when its next expansion
+    // would not fit; when the budget runs out anyway, solve() returns an invalid
+    // partial result naming the phase (QMResult::failedPhase). The budget only
+    // covers the scratch arena (combining levels, cube table, coverage and cover
+    // tables, Petrick's products); the search state of branch and bound and the
+    // greedy cover, and the results, live on the heap outside it.
+    void setMemoryBudget(size_t bytes) { arena.setBudget(bytes); }
+
+    // Interruption and progress of solve(), all off by default. A solve that is
+    // cancelled or passes the deadline stops at its next check and returns an
+    // invalid partial result naming the phase (QMResult::failedPhase): the
+    // primes and essentials found so far and, in the cover search, the best
+    // cover known (the greedy cover, or the incumbent of branch and bound).
+    // The callback runs on the solving thread at every check.
+    void setCancellation(const CancellationToken* token) { cancellation = token; }
+    void setDeadline(std::chrono::steady_clock::time_point time) { deadline = time; }
+    void clearDeadline() { deadline = std::chrono::steady_clock::time_point::max(); }
+    void setProgressCallback(ProgressCallback callback) { progressCallback = std::move(callback); }
+
+    // Writes a checkpoint of single-output solves to filename once every
+    // interval (at the next combining level, Petrick step or branch and bound
+    // node after it; an empty filename turns checkpointing off). A write that
+    // fails does not stop the solve: it is counted in the stats and its error
+    // kept in QMResult::checkpointError, and the next one is tried an interval later.
+    void setCheckpointing(const std::string& filename, std::chrono::steady_clock::duration interval);
 
-    // Main minimization function
-    void minimize();
+    // Loads the problem of a checkpoint; the next solve() continues from it and
+    // gives the result of an uninterrupted run (its stats only count the rest)
+    void resumeFrom(const SolverCheckpoint& checkpoint);
 
     // File I/O
     void readFromFile(const std::string& filename);
+    void load(const Problem& problem);
+    void reset();
 
     // Input handling
-    std::vector<int> parseIntegers(const std::string& input);
+    std::vector<int> parseIntegers(std::string_view input);
     bool validateInput();
+    bool validateInput(std::vector<std::string>& errors);
+    bool validateTermLists(std::vector<int>& minterms, std::vector<int>& dontCares,
+                           const std::string& prefix, std::vector<std::string>& errors);
 
     // Core algorithm functions
     void generatePrimeImplicants();
     void findEssentialPrimeImplicants();
-    void applyDominance(std::vector<std::string>& remainingPIs,
-                       std::map<std::string, std::set<int>>& remainingCoverage,
-                       const std::set<int>& uncoveredMinterms);
-    void petricksMethod(const std::vector<std::string>& remainingPIs,
-                      const std::map<std::string, std::set<int>>& remainingCoverage,
-                      const std::set<int>& uncoveredMinterms);
+
+    // Their steps, also timed on their own by qm-bench. A level holds the cubes
+    // with the same number of dashes; the first one is the terms of ON + DC.
+    std::pmr::vector<CubeId> firstLevel();
+    std::pmr::vector<CubeId> combineLevel(const std::pmr::vector<CubeId>& level);
+    PrimeCoverage buildCoverage();
+    void selectEssentials(const PrimeCoverage& coverage, std::pmr::vector<char>& essential,
+                          std::pmr::vector<char>& covered);
+    CoverTable applyDominance(const CoverTable& table);
+    void petricksMethod(const CoverTable& table);
+    std::vector<CubeId> branchAndBoundCover(const CoverTable& table);
+
+    // Essential detection and cover selection alone, for the given minterms over
+    // a known set of primes; used to re-cover part of a table (see incremental.h)
+    CoverSelection selectCover(const std::vector<PackedCube>& primes, const std::vector<int>& minterms);
+
+    // Finishes solve() for the loaded single-output problem when its primes
+    // are already known (see bit_slice.h)
+    QMResult solveFromPrimes(const std::vector<PackedCube>& primes);
+
+    // Multi-output functions (one term list per output, product terms shared between outputs)
+    bool isMultiOutput() const;
+    void generateMultiOutputPrimeImplicants();
+    void findMultiOutputCover();
 
     // Helper functions
     std::string decToBin(int n);
@@ -38,22 +182,128 @@ public:
     bool covers(const std::string& term, int minterm);
     std::vector<int> convertMaxtermsToMinterms(const std::vector<int>& maxterms);
     std::string binaryToExpression(const std::string& binary);
+    std::string tagToOutputs(unsigned long long tag);
 
     // Output functions
-    void printCoverageTable();
-    void printVerilogModule();
+    void printCoverageTable(const QMResult& result);
+    void printVerilogModule(const QMResult& result);
+    void printMultiOutputVerilogModule(const QMResult& result);
+    void writeBinaryResult(const QMResult& result, const std::string& filename);
 
-    // Public member variables for input/output
+    // Public member variables for input/output (a problem given to load() is
+    // already validated, so the next minimize() skips validateInput())
     std::vector<int> mintermList;
     std::vector<int> dontCareList;
     int VARIABLES;
 
+    // Multi-output input (output k uses outputMintermLists[k] / outputDontCareLists[k])
+    std::vector<std::vector<int>> outputMintermLists;
+    std::vector<std::vector<int>> outputDontCareLists;
+
 private:
-    std::vector<std::string> primeImplicants;
-    std::vector<std::string> essentialPrimeImplicants;
-    std::map<std::string, std::set<int>> implicantCoverage;
-    std::vector<std::vector<std::string>> minimalSolutions;
+    void printResults(const QMResult& result);
+    void printMultiOutputResults(const QMResult& result);
+    QMResult collectResult() const;
+    QMResult partialResult(const std::runtime_error& error) const;
+
+    // Counts a step and every INTERRUPT_POLL_INTERVAL steps calls checkInterrupt()
+    void poll() {
+        if (interruptible && ++polls % INTERRUPT_POLL_INTERVAL == 0) checkInterrupt();
+    }
+    void checkInterrupt();
+    void setIncumbent(const CoverTable& table, const std::vector<uint32_t>& columns);
+
+    // Whether a checkpoint is due, and writing one (the problem is filled in)
+    bool checkpointDue() const;
+    void saveCheckpoint(SolverCheckpoint& checkpoint);
+    std::vector<PackedCube> packCubes(const std::vector<CubeId>& ids) const;
+    void clearResults();
+    void coverPrimes(const std::vector<PackedCube>& primes);
+
+    bool inputValidated = false;
+    bool detailedStats = false;
+    const char* phase = "";   // Step of solve() running, for progress and for partial results
+
+    // Interruption (see setCancellation); interruptible tells whether any is set
+    const CancellationToken* cancellation = nullptr;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+    ProgressCallback progressCallback;
+    bool interruptible = false;
+    size_t polls = 0;
+    size_t cubesProcessed = 0;
+    size_t coverNodes = 0;
+    std::vector<CubeId> incumbentCover;   // Best cover of the running cover search (see setIncumbent)
+
+    // Checkpointing, and the state resumeFrom() left for the next solve()
+    std::string checkpointFile;
+    std::chrono::steady_clock::duration checkpointInterval{};
+    std::chrono::steady_clock::time_point nextCheckpoint;
+    std::optional<SolverCheckpoint> resumeState;
+    std::string checkpointError;          // Why the last failed checkpoint write failed
+    QMStats stats;
+    ResultCache* resultCache = nullptr;
+
+    // Scratch memory of the current solve(); reset (not freed) between problems.
+    // Declared before the results that live in it.
+    ScratchArena arena;
+
+    // Every cube of the current run; the results below refer to cubes by ID
+    CubeTable cubes{arena.resource()};
+
+    std::vector<CubeId> primeImplicants;
+    std::vector<CubeId> essentialPrimeImplicants;
+    std::vector<std::vector<CubeId>> minimalSolutions;
     std::vector<int> uncoveredMintermsAfterEPI;
+
+    // Multi-output results: each prime is tagged with a bitmask of the outputs it may feed
+    std::vector<CubeId> multiOutputPrimes;
+    std::vector<unsigned long long> multiOutputTags;
+    std::vector<CubeId> multiOutputEssentials;
+    std::vector<CubeId> sharedProductTerms;
+    std::vector<std::vector<size_t>> outputProductTerms;
 };
 
+// Scratch state of the solver. solve() never changes the problem it is given and
+// keeps everything it needs in the context, so threads can minimize different
+// functions at once by giving every thread its own context. Reusing a context
+// across calls reuses the solver and the capacity of its buffers.
+class SolverContext {
+public:
+    SolverContext() : qm(1) {}
+
+    // Shares a result cache with the solves run in this context (see result_cache.h)
+    void setResultCache(ResultCache* cache) { qm.setResultCache(cache); }
+
+    // Times the phases of every solve (see QMStats)
+    void setDetailedStats(bool on) { qm.setDetailedStats(on); }
+
+    // Caps the scratch memory of every solve (see QM::setMemoryBudget)
+    void setMemoryBudget(size_t bytes) { qm.setMemoryBudget(bytes); }
+
+    // Interruption and progress of every solve (see QM::setCancellation)
+    void setCancellation(const CancellationToken* token) { qm.setCancellation(token); }
+    void setDeadline(std::chrono::steady_clock::time_point time) { qm.setDeadline(time); }
+    void clearDeadline() { qm.clearDeadline(); }
+    void setProgressCallback(ProgressCallback callback) { qm.setProgressCallback(std::move(callback)); }
+
+private:
+    friend QMResult solve(const Problem& problem, SolverContext& context);
+    friend std::vector<QMResult> solveBitSliced(const std::vector<Problem>& problems, SolverContext& context,
+                                                std::vector<std::chrono::nanoseconds>* latencies);
+    QM qm;
+};
+
+// Solves a validated problem without any I/O (the entry point for library users)
+QMResult solve(const Problem& problem, SolverContext& context);
+
+// Same, with a context that lives only for this call
+QMResult solveProblem(const Problem& problem);
+
+// Writes stats as a text block (one "name: value" line each) or as one JSON object
+void printStats(const QMStats& stats, std::ostream& out);
+std::string statsToJson(const QMStats& stats);
+
+// Writes a cube as a product of literals, e.g. "1-0" as "AC'" (empty for "---")
+std::string cubeToExpression(const std::string& cube);
+
 #endif // QM_H
\ No newline at end of file
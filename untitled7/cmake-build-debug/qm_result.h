@@ -0,0 +1,66 @@
+#ifndef QM_RESULT_H
+#define QM_RESULT_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Counters describing how a minimization went
+struct QMStats {
+    size_t combiningLevels = 0;     // Levels of the prime implicant combining loop
+    size_t remainingPIs = 0;        // PIs left for the cover search after essentials
+    size_t remainingMinterms = 0;   // Minterms (or output/minterm rows) left after essentials
+    size_t petrickProducts = 0;     // Largest number of partial products in Petrick's method
+    bool usedBranchAndBound = false; // Cover search fell back to branch and bound
+    bool fromCache = false;         // Result came from the result cache without solving
+    bool fromTable = false;         // Result came from the small function table (small_table.h)
+    bool bitSliced = false;         // Primes and essentials came from the bit-sliced kernel (bit_slice.h)
+    bool budgetFallback = false;    // Petrick's method gave way to branch and bound to stay in the memory budget
+    bool budgetExceeded = false;    // The solve stopped because the memory budget ran out
+    size_t checkpointFailures = 0;  // Periodic checkpoints that could not be written (see QM::setCheckpointing)
+    size_t scratchBytes = 0;        // Peak scratch memory of the solve (see ScratchArena::used)
+
+    // Combining loop and cover search counters (plain counts, always kept)
+    std::vector<size_t> levelCubes;     // Cubes entering every combining level
+    size_t adjacencyTests = 0;          // Cube pairs compared between adjacent groups
+    size_t merges = 0;                  // Pairs that combined
+    size_t dedupHits = 0;               // Merges giving a cube that was already found
+    size_t petrickPartialProducts = 0;  // Products formed by Petrick's method before absorption
+
+    // Phase times in nanoseconds, measured only with detailed stats on
+    // (SolverContext::setDetailedStats); timed tells whether they were
+    bool timed = false;
+    unsigned long long parseNs = 0;       // Reading the problem (filled in by whoever parsed it)
+    unsigned long long primesNs = 0;      // Combining levels
+    unsigned long long coverageNs = 0;    // Which primes cover which minterms
+    unsigned long long essentialsNs = 0;  // Essential detection
+    unsigned long long coverSearchNs = 0; // Petrick's method or branch and bound
+};
+
+// Everything QM::solve() finds; cubes use the binary form ("1-0").
+// For multi-output problems primeTags gives the outputs of every prime
+// and outputTerms lists, per output, the indices into cover it uses.
+struct QMResult {
+    bool valid = true;
+    std::vector<std::string> errors; // Why the result is invalid (validation errors, or why it stopped)
+    std::string failedPhase;         // Phase that ran out of the memory budget, was cancelled or passed
+                                     // the deadline; the result is then invalid and holds only what
+                                     // was found before
+    std::string checkpointError;     // Why the last failed checkpoint write failed; the solve went on
+
+    int variables = 0;
+    std::vector<std::string> primeImplicants;
+    std::vector<std::string> essentialPrimeImplicants;
+    std::vector<int> uncoveredAfterEssentials;
+    std::vector<std::string> cover;                     // Essentials plus the first minimal solution
+    std::vector<std::vector<std::string>> alternatives; // Non-essential part of every minimal solution
+
+    std::vector<unsigned long long> primeTags;
+    std::vector<std::vector<size_t>> outputTerms;
+
+    QMStats stats;
+
+    bool isMultiOutput() const { return !outputTerms.empty(); }
+};
+
+#endif // QM_RESULT_H
@@ -0,0 +1,405 @@
+#include "result_cache.h"
+#include "binary_format.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static const char CACHE_MAGIC[4] = {'Q', 'M', 'R', 'C'};
+const uint32_t CACHE_VERSION = 2;
+
+// Smallest cache file, and the bytes of data area per index slot
+const size_t MIN_CACHE_BYTES = size_t(64) << 10;
+const size_t BYTES_PER_SLOT = 512;
+
+// Start of the file. dirty is set for the duration of every update.
+struct CacheHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t slotCount;   // Power of two
+    uint32_t dirty;
+    uint64_t capacity;    // Bytes of the data area
+    uint64_t dataUsed;    // Records are appended at this offset
+    uint64_t clock;       // Ticks on every access, for LRU order
+    uint64_t entries;
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+};
+
+// One index entry; size 0 means empty. A record is the key followed by the
+// value, each as u32 size and bytes.
+struct CacheSlot {
+    uint64_t hash;
+    uint64_t offset;
+    uint64_t lastUse;
+    uint32_t size;
+    uint32_t reserved;
+};
+
+// FNV-1a
+static uint64_t hashKey(const string& key) {
+    uint64_t hash = 14695981039346656037ull;
+    for (char c : key) {
+        hash = (hash ^ static_cast<uint8_t>(c)) * 1099511628211ull;
+    }
+    return hash;
+}
+
+// Splits the record of a slot into key and value; false when it does not fit the data area
+static bool readRecord(const char* data, const CacheHeader& header, const CacheSlot& slot,
+                       string_view& key, string_view& value) {
+    if (slot.offset > header.capacity || slot.size > header.capacity - slot.offset || slot.size < 8) return false;
+    const char* record = data + slot.offset;
+    uint32_t keySize;
+    uint32_t valueSize;
+    memcpy(&keySize, record, 4);
+    if (keySize > slot.size - 8) return false;
+    memcpy(&valueSize, record + 4 + keySize, 4);
+    if (valueSize != slot.size - 8 - keySize) return false;
+    key = string_view(record + 4, keySize);
+    value = string_view(record + 8 + keySize, valueSize);
+    return true;
+}
+
+// Packed result plus what the packed form leaves out
+static string encodeValue(const QMResult& result) {
+    BinaryWriter writer;
+    string packed = encodeBinaryResult(packResult(result));
+    writer.u32(static_cast<uint32_t>(packed.size()));
+    writer.raw(packed);
+    writer.varint(result.uncoveredAfterEssentials.size());
+    int previous = 0;
+    for (int m : result.uncoveredAfterEssentials) {
+        writer.varint(static_cast<uint64_t>(m - previous));
+        previous = m;
+    }
+    return writer.bytes();
+}
+
+static QMResult decodeValue(string_view value) {
+    BinaryReader reader(value);
+    PackedResult packed = parseBinaryResult(reader.raw(reader.u32()));
+
+    auto toStrings = [&](const vector<PackedCube>& cubes) {
+        vector<string> strings;
+        for (PackedCube cube : cubes) strings.push_back(unpackCube(cube, packed.variables));
+        return strings;
+    };
+    QMResult result;
+    result.variables = packed.variables;
+    result.primeImplicants = toStrings(packed.primes);
+    result.essentialPrimeImplicants = toStrings(packed.essentials);
+    result.cover = toStrings(packed.cover);
+    for (const vector<PackedCube>& alternative : packed.alternatives) {
+        result.alternatives.push_back(toStrings(alternative));
+    }
+    result.primeTags.assign(packed.primeTags.begin(), packed.primeTags.end());
+    for (const vector<uint32_t>& terms : packed.outputTerms) {
+        result.outputTerms.push_back(vector<size_t>(terms.begin(), terms.end()));
+    }
+
+    uint64_t uncovered = reader.varint();
+    int term = 0;
+    for (uint64_t i = 0; i < uncovered; i++) {
+        term += static_cast<int>(reader.varint());
+        result.uncoveredAfterEssentials.push_back(term);
+    }
+    result.stats.fromCache = true;
+    return result;
+}
+
+// Holds the mutex and the file lock; a cache left dirty by a dead process is emptied
+class ResultCache::Lock {
+public:
+    explicit Lock(ResultCache& cache) : cache(cache), guard(cache.mutex) {
+#ifdef _WIN32
+        OVERLAPPED overlapped = {};
+        if (!LockFileEx(cache.fileHandle, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &overlapped)) {
+            throw runtime_error("Could not lock the result cache");
+        }
+#else
+        while (flock(cache.fd, LOCK_EX) != 0) {
+            if (errno != EINTR) throw runtime_error("Could not lock the result cache");
+        }
+#endif
+        CacheHeader* header = reinterpret_cast<CacheHeader*>(cache.mapping);
+        if (header->dirty) cache.initialize();
+        header->dirty = 1;
+    }
+
+    ~Lock() {
+        reinterpret_cast<CacheHeader*>(cache.mapping)->dirty = 0;
+#ifdef _WIN32
+        OVERLAPPED overlapped = {};
+        UnlockFileEx(cache.fileHandle, 0, MAXDWORD, MAXDWORD, &overlapped);
+#else
+        flock(cache.fd, LOCK_UN);
+#endif
+    }
+
+private:
+    ResultCache& cache;
+    lock_guard<std::mutex> guard;
+};
+
+ResultCache::ResultCache(const string& filename, size_t maxBytes) {
+    maxBytes = max(maxBytes, MIN_CACHE_BYTES);
+#ifdef _WIN32
+    fileHandle = CreateFileA(filename.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ | FILE_SHARE_WRITE,
+                             nullptr, OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (fileHandle == INVALID_HANDLE_VALUE) {
+        fileHandle = nullptr;
+        throw runtime_error("Could not open result cache: " + filename);
+    }
+    OVERLAPPED overlapped = {};
+    LockFileEx(fileHandle, LOCKFILE_EXCLUSIVE_LOCK, 0, MAXDWORD, MAXDWORD, &overlapped);
+    LARGE_INTEGER fileSize;
+    GetFileSizeEx(fileHandle, &fileSize);
+    bool created = fileSize.QuadPart == 0;
+    size = created ? maxBytes : static_cast<size_t>(fileSize.QuadPart);
+    if (size < MIN_CACHE_BYTES) {
+        CloseHandle(fileHandle);
+        throw runtime_error("Not a result cache file: " + filename);
+    }
+    mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READWRITE,
+                                       static_cast<DWORD>(static_cast<uint64_t>(size) >> 32),
+                                       static_cast<DWORD>(size), nullptr);
+    if (mappingHandle != nullptr) {
+        mapping = static_cast<char*>(MapViewOfFile(mappingHandle, FILE_MAP_ALL_ACCESS, 0, 0, size));
+    }
+    if (mapping == nullptr) {
+        UnlockFileEx(fileHandle, 0, MAXDWORD, MAXDWORD, &overlapped);
+        if (mappingHandle != nullptr) CloseHandle(mappingHandle);
+        CloseHandle(fileHandle);
+        throw runtime_error("Could not map result cache: " + filename);
+    }
+#else
+    fd = open(filename.c_str(), O_RDWR | O_CREAT, 0644);
+    if (fd < 0) {
+        throw runtime_error("Could not open result cache: " + filename);
+    }
+    // Only one process may create the file
+    flock(fd, LOCK_EX);
+    struct stat info;
+    bool created = fstat(fd, &info) == 0 && info.st_size == 0;
+    if (created && ftruncate(fd, static_cast<off_t>(maxBytes)) != 0) {
+        close(fd);
+        throw runtime_error("Could not create result cache: " + filename);
+    }
+    size = created ? maxBytes : static_cast<size_t>(info.st_size);
+    if (size < MIN_CACHE_BYTES) {
+        close(fd);
+        throw runtime_error("Not a result cache file: " + filename);
+    }
+    void* mapped = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapped == MAP_FAILED) {
+        close(fd);
+        throw runtime_error("Could not map result cache: " + filename);
+    }
+    mapping = static_cast<char*>(mapped);
+#endif
+
+    // A file whose creator died before laying it out is still all zeros
+    CacheHeader* header = reinterpret_cast<CacheHeader*>(mapping);
+    bool ours = memcmp(header->magic, CACHE_MAGIC, 4) == 0;
+    if (!created && !ours && header->magic[0] != '\0') {
+        unmap();
+        throw runtime_error("Not a result cache file: " + filename);
+    }
+    if (created || !ours || header->version != CACHE_VERSION) {
+        initialize();
+    }
+    dataOffset = sizeof(CacheHeader) + header->slotCount * sizeof(CacheSlot);
+#ifdef _WIN32
+    UnlockFileEx(fileHandle, 0, MAXDWORD, MAXDWORD, &overlapped);
+#else
+    flock(fd, LOCK_UN);
+#endif
+}
+
+ResultCache::~ResultCache() {
+    unmap();
+}
+
+void ResultCache::unmap() {
+#ifdef _WIN32
+    if (mapping != nullptr) UnmapViewOfFile(mapping);
+    if (mappingHandle != nullptr) CloseHandle(mappingHandle);
+    if (fileHandle != nullptr) CloseHandle(fileHandle);
+    mapping = nullptr;
+    mappingHandle = nullptr;
+    fileHandle = nullptr;
+#else
+    if (mapping != nullptr) munmap(mapping, size);
+    if (fd >= 0) close(fd);
+    mapping = nullptr;
+    fd = -1;
+#endif
+}
+
+// Lays out an empty cache over the whole file
+void ResultCache::initialize() {
+    uint32_t slotCount = 64;
+    while (size_t(slotCount) * 2 * BYTES_PER_SLOT <= size) slotCount *= 2;
+    size_t index = sizeof(CacheHeader) + size_t(slotCount) * sizeof(CacheSlot);
+    while (index + BYTES_PER_SLOT > size) {
+        slotCount /= 2;
+        index = sizeof(CacheHeader) + size_t(slotCount) * sizeof(CacheSlot);
+    }
+
+    memset(mapping, 0, index);
+    CacheHeader* header = reinterpret_cast<CacheHeader*>(mapping);
+    memcpy(header->magic, CACHE_MAGIC, 4);
+    header->version = CACHE_VERSION;
+    header->slotCount = slotCount;
+    header->capacity = size - index;
+    dataOffset = index;
+}
+
+// The canonical problem holds only what decides the result
+ResultCache::Key ResultCache::key(const Problem& problem) {
+    Key key;
+    key.canonical = canonicalProblem(problem, key.transform);
+    key.bytes = encodeBinaryProblem(key.canonical);
+    key.hash = hashKey(key.bytes);
+    return key;
+}
+
+bool ResultCache::lookup(const Key& key, QMResult& result) {
+    uint64_t hash = key.hash;
+    string value;
+    {
+        Lock lock(*this);
+        CacheHeader* header = reinterpret_cast<CacheHeader*>(mapping);
+        CacheSlot* slots = reinterpret_cast<CacheSlot*>(mapping + sizeof(CacheHeader));
+        uint32_t mask = header->slotCount - 1;
+        for (uint32_t i = static_cast<uint32_t>(hash) & mask; slots[i].size != 0; i = (i + 1) & mask) {
+            string_view recordKey;
+            string_view recordValue;
+            if (slots[i].hash != hash || !readRecord(data(), *header, slots[i], recordKey, recordValue) ||
+                recordKey != key.bytes) {
+                continue;
+            }
+            value = recordValue;
+            slots[i].lastUse = ++header->clock;
+            header->hits++;
+            break;
+        }
+        if (value.empty()) {
+            header->misses++;
+            return false;
+        }
+    }
+
+    // A damaged record counts as a miss
+    try {
+        result = fromCanonical(decodeValue(value), key.transform);
+        return true;
+    }
+    catch (const exception&) {
+        return false;
+    }
+}
+
+void ResultCache::store(const Key& key, const QMResult& canonicalResult) {
+    if (!canonicalResult.valid) return;
+    uint64_t hash = key.hash;
+    string value = encodeValue(canonicalResult);
+    size_t recordSize = 8 + key.bytes.size() + value.size();
+
+    Lock lock(*this);
+    CacheHeader* header = reinterpret_cast<CacheHeader*>(mapping);
+    if (recordSize > header->capacity / 8) return;
+    if (header->dataUsed + recordSize > header->capacity || (header->entries + 1) * 4 > header->slotCount * 3ull) {
+        evict();
+    }
+
+    // Find the free slot, unless another process stored the result meanwhile
+    CacheSlot* slots = reinterpret_cast<CacheSlot*>(mapping + sizeof(CacheHeader));
+    uint32_t mask = header->slotCount - 1;
+    uint32_t i = static_cast<uint32_t>(hash) & mask;
+    for (; slots[i].size != 0; i = (i + 1) & mask) {
+        string_view recordKey;
+        string_view recordValue;
+        if (slots[i].hash == hash && readRecord(data(), *header, slots[i], recordKey, recordValue) &&
+            recordKey == key.bytes) {
+            return;
+        }
+    }
+
+    char* record = data() + header->dataUsed;
+    uint32_t keySize = static_cast<uint32_t>(key.bytes.size());
+    uint32_t valueSize = static_cast<uint32_t>(value.size());
+    memcpy(record, &keySize, 4);
+    memcpy(record + 4, key.bytes.data(), keySize);
+    memcpy(record + 4 + keySize, &valueSize, 4);
+    memcpy(record + 8 + keySize, value.data(), value.size());
+
+    slots[i].hash = hash;
+    slots[i].offset = header->dataUsed;
+    slots[i].lastUse = ++header->clock;
+    slots[i].size = static_cast<uint32_t>(recordSize);
+    header->dataUsed += recordSize;
+    header->entries++;
+}
+
+// Keeps the most recently used entries that fit in half of the data area and
+// of the index, moved to the front of the data area
+void ResultCache::evict() {
+    CacheHeader* header = reinterpret_cast<CacheHeader*>(mapping);
+    CacheSlot* slots = reinterpret_cast<CacheSlot*>(mapping + sizeof(CacheHeader));
+
+    vector<CacheSlot> live;
+    for (uint32_t i = 0; i < header->slotCount; i++) {
+        if (slots[i].size != 0) live.push_back(slots[i]);
+    }
+    sort(live.begin(), live.end(), [](const CacheSlot& a, const CacheSlot& b) { return a.lastUse > b.lastUse; });
+
+    vector<CacheSlot> kept;
+    string records;
+    for (const CacheSlot& slot : live) {
+        if (records.size() + slot.size > header->capacity / 2 || kept.size() + 1 > header->slotCount / 2) break;
+        kept.push_back(slot);
+        kept.back().offset = records.size();
+        records.append(data() + slot.offset, slot.size);
+    }
+
+    memset(slots, 0, header->slotCount * sizeof(CacheSlot));
+    memcpy(data(), records.data(), records.size());
+    uint32_t mask = header->slotCount - 1;
+    for (const CacheSlot& slot : kept) {
+        uint32_t i = static_cast<uint32_t>(slot.hash) & mask;
+        while (slots[i].size != 0) i = (i + 1) & mask;
+        slots[i] = slot;
+    }
+    header->evictions += live.size() - kept.size();
+    header->entries = kept.size();
+    header->dataUsed = records.size();
+}
+
+ResultCache::Counters ResultCache::counters() {
+    Lock lock(*this);
+    const CacheHeader* header = reinterpret_cast<const CacheHeader*>(mapping);
+    Counters counters;
+    counters.entries = header->entries;
+    counters.bytesUsed = header->dataUsed;
+    counters.capacity = header->capacity;
+    counters.hits = header->hits;
+    counters.misses = header->misses;
+    counters.evictions = header->evictions;
+    return counters;
+}
@@ -0,0 +1,90 @@
+#ifndef RESULT_CACHE_H
+#define RESULT_CACHE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include "canonical.h"
+#include "problem.h"
+#include "qm_result.h"
+
+// Size of a new cache file unless the caller asks for another
+const size_t DEFAULT_CACHE_BYTES = size_t(64) << 20;
+
+// Persistent cache of solver results, shared by every process on the host that
+// opens the same file.
+//
+// Results are keyed by the canonical form of their problem (see canonical.h:
+// variables, ON and don't-care lists up to input permutation and negation,
+// single or multi-output; not how the input was written). The result stored
+// is that of the canonical representative, mapped back through the transform
+// of the problem at hand, so every function of an NP class hits the same entry
+// and gets the same cover whether it hit or missed.
+// Entries are kept packed in one memory-mapped file of fixed size: a header, an open
+// addressing index and a data area of records. When the data area or the index
+// fills up, the least recently used entries are evicted until half is free.
+//
+// Every operation holds an exclusive lock on the file (flock / LockFileEx) and
+// a mutex, so processes and threads can share a cache. A process that dies in
+// the middle of an update leaves the file marked dirty and the next user
+// empties it. The file uses native byte order and is not meant to be copied
+// between hosts.
+class ResultCache {
+public:
+    // Opens the cache file, creating it with maxBytes if needed (an existing
+    // cache keeps its size). Throws runtime_error if the file cannot be used.
+    explicit ResultCache(const std::string& filename, size_t maxBytes = DEFAULT_CACHE_BYTES);
+    ~ResultCache();
+
+    ResultCache(const ResultCache&) = delete;
+    ResultCache& operator=(const ResultCache&) = delete;
+
+    // Key of a problem: its canonical form and the transform leading there
+    struct Key {
+        Problem canonical;
+        std::string bytes;
+        uint64_t hash = 0;
+        InputTransform transform;
+    };
+    static Key key(const Problem& problem);
+
+    // Fills result with the cached result of the keyed problem and returns true on a hit
+    bool lookup(const Key& key, QMResult& result);
+
+    // Caches a valid result of key.canonical (not of the keyed problem); results
+    // bigger than an eighth of the data area are skipped
+    void store(const Key& key, const QMResult& canonicalResult);
+
+    // Counters over the whole life of the file
+    struct Counters {
+        uint64_t entries = 0;
+        uint64_t bytesUsed = 0;   // Data area in use, including evicted records not yet compacted away
+        uint64_t capacity = 0;    // Size of the data area
+        uint64_t hits = 0;
+        uint64_t misses = 0;
+        uint64_t evictions = 0;
+    };
+    Counters counters();
+
+private:
+    class Lock;
+
+    void initialize();
+    void unmap();
+    void evict();
+    char* data() { return mapping + dataOffset; }
+
+    std::mutex mutex;
+    char* mapping = nullptr;
+    size_t size = 0;
+    size_t dataOffset = 0;
+#ifdef _WIN32
+    void* fileHandle = nullptr;
+    void* mappingHandle = nullptr;
+#else
+    int fd = -1;
+#endif
+};
+
+#endif // RESULT_CACHE_H
@@ -0,0 +1,608 @@
+#include "server.h"
+#include "flight_recorder.h"
+#include "trace.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <filesystem>
+#include <sstream>
+#include <stdexcept>
+#include <string_view>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+// Bytes of a request payload before its problem, and of a response before its message text
+const size_t REQUEST_HEADER_BYTES = 12;
+const size_t RESPONSE_HEADER_BYTES = 13;
+
+// How often run() looks at stopping when nothing happens
+const int POLL_TIMEOUT_MS = 100;
+
+// How long run() keeps sending the last responses once it stops
+const int SHUTDOWN_SEND_MS = 1000;
+
+// Longest metrics request read, how long a metrics client may take to send its
+// request and read the response, and how many are served at once
+const size_t MAX_METRICS_REQUEST_BYTES = 8192;
+const int METRICS_TIMEOUT_MS = 1000;
+const size_t MAX_METRICS_CLIENTS = 16;
+
+// A metrics connection: its request is read, then the response is sent
+struct MetricsClient {
+    int fd;
+    chrono::steady_clock::time_point deadline;
+    string request;
+    string response;
+    bool responding = false;
+};
+
+#ifndef _WIN32
+#ifdef MSG_NOSIGNAL
+const int SEND_FLAGS = MSG_NOSIGNAL; // A closed peer is an error, not SIGPIPE
+#else
+const int SEND_FLAGS = 0;
+#endif
+
+// Sends all of data; false when the connection is gone
+static bool sendAll(int fd, string_view data) {
+    while (!data.empty()) {
+        ssize_t sent = ::send(fd, data.data(), data.size(), SEND_FLAGS);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent <= 0) return false;
+        data.remove_prefix(static_cast<size_t>(sent));
+    }
+    return true;
+}
+
+// Sends what the socket takes without waiting and drops it from data; false
+// when the connection is gone
+static bool sendAvailable(int fd, string& data) {
+    size_t position = 0;
+    while (position < data.size()) {
+        ssize_t sent = ::send(fd, data.data() + position, data.size() - position, SEND_FLAGS | MSG_DONTWAIT);
+        if (sent < 0 && errno == EINTR) continue;
+        if (sent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) break;
+        if (sent <= 0) return false;
+        position += static_cast<size_t>(sent);
+    }
+    data.erase(0, position);
+    return true;
+}
+
+static void setNonBlocking(int fd) {
+    ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) | O_NONBLOCK);
+}
+
+// Reads exactly size bytes; false at the end of the stream or on an error
+static bool receiveAll(int fd, char* data, size_t size) {
+    while (size > 0) {
+        ssize_t received = ::recv(fd, data, size, 0);
+        if (received < 0 && errno == EINTR) continue;
+        if (received <= 0) return false;
+        data += received;
+        size -= static_cast<size_t>(received);
+    }
+    return true;
+}
+
+static sockaddr_un socketAddress(const string& path) {
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path)) {
+        throw runtime_error("Bad socket path: " + path);
+    }
+    memcpy(address.sun_path, path.c_str(), path.size() + 1);
+    return address;
+}
+#endif
+
+static uint32_t frameLength(const char* data) {
+    uint32_t length = 0;
+    for (int i = 0; i < 4; i++) length |= static_cast<uint32_t>(static_cast<unsigned char>(data[i])) << (8 * i);
+    return length;
+}
+
+// A response frame; results are only sent for Solved and Stopped
+static string responseFrame(uint64_t id, ResponseStatus status, const string& message, const string& result) {
+    BinaryWriter writer;
+    writer.u32(static_cast<uint32_t>(RESPONSE_HEADER_BYTES + message.size() + result.size()));
+    writer.u64(id);
+    writer.u8(static_cast<uint8_t>(status));
+    writer.u32(static_cast<uint32_t>(message.size()));
+    writer.raw(message);
+    writer.raw(result);
+    return writer.bytes();
+}
+
+// An accepted connection. Workers answer on it while run() reads it, so it
+// lives (and its socket stays open) until its last request is answered.
+struct Server::Connection {
+    explicit Connection(int fd) : fd(fd) {}
+    ~Connection() {
+#ifndef _WIN32
+        ::close(fd);
+#endif
+    }
+
+    int fd;
+    string input;             // Bytes read that do not make a whole frame yet (run() only)
+    bool readDone = false;    // The client sent its last request or broke the protocol (run() only)
+
+    mutex outputMutex;        // Guards the rest, which workers share with run()
+    string output;            // Responses not sent yet
+    size_t inFlight = 0;      // Requests read and not answered yet
+    bool broken = false;      // Sending failed: the client is gone and its responses are dropped
+};
+
+Server::Server(const ServerOptions& options)
+    : options(options), threads(options.threads != 0 ? options.threads : max(1u, thread::hardware_concurrency())),
+      metrics(threads) {}
+
+Server::~Server() {
+    stop();
+    {
+        lock_guard<mutex> lock(queueMutex);
+        draining = true;
+    }
+    queueChanged.notify_all();
+    for (thread& t : workers) {
+        if (t.joinable()) t.join();
+    }
+}
+
+// Every worker solves with one context for its whole life. Phase timers are
+// always on: they feed the phase histograms.
+void Server::worker(size_t index) {
+    WorkerMetrics& recorded = metrics.worker(index);
+    SolverContext context;
+    context.setResultCache(options.cache);
+    context.setMemoryBudget(options.memoryBudget);
+    context.setCancellation(&cancellation);
+    context.setDetailedStats(true);
+    for (;;) {
+        Request request;
+        {
+            unique_lock<mutex> lock(queueMutex);
+            queueChanged.wait(lock, [&]() { return !queue.empty() || draining; });
+            if (queue.empty()) return;
+            request = move(queue.front());
+            queue.pop_front();
+        }
+        serveRequest(request, context, recorded);
+    }
+}
+
+// Solves one request and answers it; the time limit counts from when it was read
+void Server::serveRequest(Request& request, SolverContext& context, WorkerMetrics& recorded) {
+    TraceSpan span("serve_request", "id", static_cast<long long>(request.id));
+    auto taken = chrono::steady_clock::now();
+    recorded.queueWait.observe(taken - request.received);
+    ResponseStatus status;
+    string message;
+    string result;
+    try {
+        Problem problem = parseBinaryProblem(request.problem);
+        auto parseNs = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - taken).count();
+        uint32_t limit = request.timeLimitMs != 0 ? request.timeLimitMs : options.defaultTimeLimitMs;
+        auto deadline = request.received + chrono::milliseconds(limit);
+        if (limit != 0) context.setDeadline(deadline);
+        else context.clearDeadline();
+        QMResult solved = solve(problem, context);
+        if (solved.stats.timed) solved.stats.parseNs = static_cast<unsigned long long>(parseNs);
+        recorded.recordSolve(solved.stats, options.cache != nullptr);
+        // Waiting in the queue does not make a request slow
+        auto solveTime = chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - taken);
+        if (options.recorder && options.recorder->isSlow(solveTime)) {
+            options.recorder->record("request " + to_string(request.id), problem, solved, solveTime,
+                                     options.memoryBudget);
+        }
+        for (const string& error : solved.errors) message += (message.empty() ? "" : "\n") + error;
+        if (!solved.valid && solved.failedPhase.empty()) {
+            status = ResponseStatus::Invalid;
+        } else {
+            status = solved.valid ? ResponseStatus::Solved : ResponseStatus::Stopped;
+            result = encodeBinaryResult(packResult(solved));
+        }
+        if (status == ResponseStatus::Stopped) {
+            if (cancellation.cancelled()) recorded.recordStop(StopReason::Cancelled);
+            else if (limit != 0 && chrono::steady_clock::now() >= deadline) recorded.recordStop(StopReason::Timeout);
+            else recorded.recordStop(StopReason::MemoryBudget);
+        }
+    }
+    catch (const invalid_argument& e) {
+        status = ResponseStatus::Invalid;
+        message = e.what();
+    }
+    catch (const exception& e) {
+        status = ResponseStatus::Error;
+        message = e.what();
+    }
+
+    queueOutput(*request.connection, responseFrame(request.id, status, message, result));
+    recorded.responses[static_cast<size_t>(status)].add();
+    recorded.requestTime.observe(chrono::steady_clock::now() - request.received);
+}
+
+// Answers one request of the connection: sends what the socket takes now and
+// leaves the rest to run(). A client that went away loses its responses.
+void Server::queueOutput(Connection& connection, const string& frame) {
+#ifndef _WIN32
+    bool pending;
+    {
+        lock_guard<mutex> lock(connection.outputMutex);
+        if (connection.inFlight > 0) connection.inFlight--;
+        if (connection.broken) return;
+        bool idle = connection.output.empty();
+        connection.output += frame;
+        if (idle && !sendAvailable(connection.fd, connection.output)) {
+            connection.broken = true;
+            connection.output.clear();
+        }
+        pending = !connection.output.empty();
+    }
+    if (pending) {
+        char wake = 0;
+        [[maybe_unused]] ssize_t written = ::write(wakeWrite, &wake, 1); // A full pipe wakes run() anyway
+    }
+#endif
+}
+
+// Sends the pending responses of a connection as far as its socket takes them
+void Server::sendOutput(Connection& connection) {
+#ifndef _WIN32
+    lock_guard<mutex> lock(connection.outputMutex);
+    if (!connection.broken && !sendAvailable(connection.fd, connection.output)) {
+        connection.broken = true;
+        connection.output.clear();
+    }
+#endif
+}
+
+size_t Server::queueDepth() {
+    lock_guard<mutex> lock(queueMutex);
+    return queue.size();
+}
+
+// The HTTP response to a metrics request; only the request line matters
+string Server::metricsResponse(const string& request) {
+    if (request.rfind("GET /metrics ", 0) == 0 || request.rfind("GET / ", 0) == 0) {
+        ostringstream body;
+        metrics.write(body, queueDepth(), options.cache);
+        return "HTTP/1.1 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\nContent-Length: " +
+               to_string(body.str().size()) + "\r\nConnection: close\r\n\r\n" + body.str();
+    }
+    return "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\nConnection: close\r\n\r\n";
+}
+
+// Reads what the connection has and queues every whole request; false when
+// the connection is done (closed by the client, or it broke the protocol)
+bool Server::readFrames(const shared_ptr<Connection>& connection) {
+#ifdef _WIN32
+    return false;
+#else
+    char buffer[65536];
+    ssize_t received = ::recv(connection->fd, buffer, sizeof(buffer), 0);
+    if (received < 0 && (errno == EINTR || errno == EAGAIN || errno == EWOULDBLOCK)) return true;
+    if (received <= 0) return false;
+    connection->input.append(buffer, static_cast<size_t>(received));
+
+    auto now = chrono::steady_clock::now();
+    size_t position = 0;
+    vector<Request> requests;
+    while (connection->input.size() - position >= 4) {
+        uint32_t length = frameLength(connection->input.data() + position);
+        if (length < REQUEST_HEADER_BYTES || length > MAX_FRAME_BYTES) {
+            {
+                lock_guard<mutex> lock(connection->outputMutex);
+                connection->inFlight++; // Answered right away by queueOutput
+            }
+            queueOutput(*connection, responseFrame(0, ResponseStatus::Error, "Bad request frame", ""));
+            metrics.badFrames.add();
+            return false;
+        }
+        if (connection->input.size() - position - 4 < length) break;
+        BinaryReader reader(string_view(connection->input).substr(position + 4, length));
+        Request request;
+        request.id = reader.u64();
+        request.timeLimitMs = reader.u32();
+        request.problem = string(reader.raw(length - REQUEST_HEADER_BYTES));
+        request.connection = connection;
+        request.received = now;
+        requests.push_back(move(request));
+        position += 4 + length;
+    }
+    connection->input.erase(0, position);
+    if (requests.empty()) return true;
+    metrics.requestsRead.add(requests.size());
+    {
+        lock_guard<mutex> lock(connection->outputMutex);
+        connection->inFlight += requests.size();
+    }
+
+    {
+        lock_guard<mutex> lock(queueMutex);
+        for (Request& request : requests) {
+            queue.push_back(move(request));
+        }
+    }
+    queueChanged.notify_all();
+    return true;
+#endif
+}
+
+void Server::run() {
+#ifdef _WIN32
+    throw runtime_error("Server mode needs Unix domain sockets");
+#else
+    sockaddr_un address = socketAddress(options.socketPath);
+    int listener = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        throw runtime_error("Could not create socket: " + string(strerror(errno)));
+    }
+    // A socket file left behind by a server that died is replaced
+    error_code ignored;
+    if (filesystem::is_socket(options.socketPath, ignored)) filesystem::remove(options.socketPath, ignored);
+    if (::bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(listener, SOMAXCONN) != 0) {
+        string error = strerror(errno);
+        ::close(listener);
+        throw runtime_error("Could not listen on " + options.socketPath + ": " + error);
+    }
+
+    // Metrics are only offered on the loopback interface
+    int metricsListener = -1;
+    if (options.metricsPort != 0) {
+        sockaddr_in metricsAddress{};
+        metricsAddress.sin_family = AF_INET;
+        metricsAddress.sin_port = htons(options.metricsPort);
+        metricsAddress.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        int reuse = 1;
+        metricsListener = ::socket(AF_INET, SOCK_STREAM, 0);
+        if (metricsListener >= 0) setsockopt(metricsListener, SOL_SOCKET, SO_REUSEADDR, &reuse, sizeof(reuse));
+        if (metricsListener < 0 ||
+            ::bind(metricsListener, reinterpret_cast<sockaddr*>(&metricsAddress), sizeof(metricsAddress)) != 0 ||
+            ::listen(metricsListener, SOMAXCONN) != 0) {
+            string error = strerror(errno);
+            if (metricsListener >= 0) ::close(metricsListener);
+            ::close(listener);
+            filesystem::remove(options.socketPath, ignored);
+            throw runtime_error("Could not serve metrics on port " + to_string(options.metricsPort) + ": " + error);
+        }
+    }
+
+    int wakePipe[2];
+    if (::pipe(wakePipe) != 0) {
+        string error = strerror(errno);
+        if (metricsListener >= 0) ::close(metricsListener);
+        ::close(listener);
+        filesystem::remove(options.socketPath, ignored);
+        throw runtime_error("Could not create the wake-up pipe: " + error);
+    }
+    wakeRead = wakePipe[0];
+    wakeWrite = wakePipe[1];
+    setNonBlocking(wakeRead);
+    setNonBlocking(wakeWrite);
+
+    for (unsigned t = 0; t < threads; t++) workers.emplace_back(&Server::worker, this, t);
+
+    // Connections are read while they have no more than MAX_PENDING_OUTPUT_BYTES
+    // of responses waiting, written while they have any, and dropped once the
+    // client is gone or has sent everything and got every response
+    vector<shared_ptr<Connection>> connections;
+    vector<MetricsClient> metricsClients;
+    vector<pollfd> polled;
+    while (!stopping.load(memory_order_relaxed)) {
+        // Connections are not read while the queue is full
+        bool full;
+        {
+            lock_guard<mutex> lock(queueMutex);
+            full = queue.size() >= MAX_QUEUED_REQUESTS;
+        }
+        polled.assign(1, pollfd{listener, POLLIN, 0});
+        polled.push_back(pollfd{wakeRead, POLLIN, 0});
+        if (metricsListener >= 0) {
+            polled.push_back(pollfd{metricsListener, static_cast<short>(metricsClients.size() < MAX_METRICS_CLIENTS ? POLLIN : 0), 0});
+        }
+        size_t firstMetricsClient = polled.size();
+        for (const MetricsClient& client : metricsClients) {
+            polled.push_back(pollfd{client.fd, static_cast<short>(client.responding ? POLLOUT : POLLIN), 0});
+        }
+        size_t firstConnection = polled.size();
+        for (const shared_ptr<Connection>& connection : connections) {
+            size_t pending;
+            {
+                lock_guard<mutex> lock(connection->outputMutex);
+                pending = connection->output.size();
+            }
+            short events = 0;
+            if (!full && !connection->readDone && pending <= MAX_PENDING_OUTPUT_BYTES) events |= POLLIN;
+            if (pending > 0) events |= POLLOUT;
+            polled.push_back(pollfd{connection->fd, events, 0});
+        }
+        if (::poll(polled.data(), polled.size(), POLL_TIMEOUT_MS) < 0) {
+            if (errno == EINTR) continue;
+            break;
+        }
+
+        if (polled[1].revents & POLLIN) {
+            char drained[256];
+            while (::read(wakeRead, drained, sizeof(drained)) > 0) {
+            }
+        }
+        for (size_t i = polled.size(); i-- > firstConnection;) {
+            Connection& connection = *connections[i - firstConnection];
+            short revents = polled[i].revents;
+            if ((revents & POLLIN) && !readFrames(connections[i - firstConnection])) connection.readDone = true;
+            if (revents & POLLOUT) sendOutput(connection);
+            bool done;
+            {
+                lock_guard<mutex> lock(connection.outputMutex);
+                // Hang-up without data to read: the client closed both directions
+                if ((revents & (POLLHUP | POLLERR)) && !(revents & POLLIN)) {
+                    connection.broken = true;
+                    connection.output.clear();
+                }
+                done = connection.broken ||
+                       (connection.readDone && connection.inFlight == 0 && connection.output.empty());
+            }
+            if (done) connections.erase(connections.begin() + static_cast<ptrdiff_t>(i - firstConnection));
+        }
+        if (polled[0].revents & POLLIN) {
+            int fd = ::accept(listener, nullptr, nullptr);
+            if (fd >= 0) {
+                setNonBlocking(fd);
+                connections.push_back(make_shared<Connection>(fd));
+                metrics.connectionsAccepted.add();
+            }
+        }
+
+        // Metrics clients are read and written as far as their sockets go, and
+        // dropped when done or out of time
+        auto now = chrono::steady_clock::now();
+        for (size_t i = firstConnection; i-- > firstMetricsClient;) {
+            MetricsClient& client = metricsClients[i - firstMetricsClient];
+            bool done = now >= client.deadline || (polled[i].revents & (POLLERR | POLLNVAL));
+            if (!done && !client.responding && (polled[i].revents & (POLLIN | POLLHUP))) {
+                char buffer[1024];
+                ssize_t received;
+                while ((received = ::recv(client.fd, buffer, sizeof(buffer), 0)) > 0) {
+                    client.request.append(buffer, static_cast<size_t>(received));
+                }
+                bool ended = received == 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR);
+                if (ended || client.request.find("\r\n\r\n") != string::npos ||
+                    client.request.size() >= MAX_METRICS_REQUEST_BYTES) {
+                    client.response = metricsResponse(client.request);
+                    client.responding = true;
+                }
+            }
+            if (!done && client.responding) {
+                done = !sendAvailable(client.fd, client.response) || client.response.empty();
+            }
+            if (done) {
+                ::close(client.fd);
+                metricsClients.erase(metricsClients.begin() + static_cast<ptrdiff_t>(i - firstMetricsClient));
+            }
+        }
+        if (metricsListener >= 0 && (polled[2].revents & POLLIN)) {
+            int fd = ::accept(metricsListener, nullptr, nullptr);
+            if (fd >= 0) {
+                setNonBlocking(fd);
+                metricsClients.push_back(
+                    MetricsClient{fd, chrono::steady_clock::now() + chrono::milliseconds(METRICS_TIMEOUT_MS), "", "", false});
+            }
+        }
+    }
+    for (const MetricsClient& client : metricsClients) ::close(client.fd);
+
+    ::close(listener);
+    if (metricsListener >= 0) ::close(metricsListener);
+    filesystem::remove(options.socketPath, ignored);
+
+    // Whatever is still queued is answered (as Stopped, mostly) before the workers exit
+    cancellation.cancel();
+    {
+        lock_guard<mutex> lock(queueMutex);
+        draining = true;
+    }
+    queueChanged.notify_all();
+    for (thread& t : workers) t.join();
+    workers.clear();
+    ::close(wakeRead);
+    ::close(wakeWrite);
+    wakeRead = wakeWrite = -1;
+
+    // The last responses get a moment to go out
+    auto giveUp = chrono::steady_clock::now() + chrono::milliseconds(SHUTDOWN_SEND_MS);
+    while (chrono::steady_clock::now() < giveUp) {
+        polled.clear();
+        vector<Connection*> waiting;
+        for (const shared_ptr<Connection>& connection : connections) {
+            lock_guard<mutex> lock(connection->outputMutex);
+            if (connection->broken || connection->output.empty()) continue;
+            polled.push_back(pollfd{connection->fd, POLLOUT, 0});
+            waiting.push_back(connection.get());
+        }
+        if (waiting.empty()) break;
+        if (::poll(polled.data(), polled.size(), POLL_TIMEOUT_MS) < 0 && errno != EINTR) break;
+        for (size_t i = 0; i < waiting.size(); i++) {
+            if (polled[i].revents != 0) sendOutput(*waiting[i]);
+        }
+    }
+#endif
+}
+
+ServerConnection::ServerConnection(const string& socketPath) {
+#ifdef _WIN32
+    throw runtime_error("Server mode needs Unix domain sockets");
+#else
+    sockaddr_un address = socketAddress(socketPath);
+    fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        string error = strerror(errno);
+        if (fd >= 0) ::close(fd);
+        throw runtime_error("Could not connect to " + socketPath + ": " + error);
+    }
+#endif
+}
+
+ServerConnection::~ServerConnection() {
+#ifndef _WIN32
+    if (fd >= 0) ::close(fd);
+#endif
+}
+
+void ServerConnection::send(uint64_t id, const Problem& problem, uint32_t timeLimitMs) {
+    string encoded = encodeBinaryProblem(problem);
+    BinaryWriter writer;
+    writer.u32(static_cast<uint32_t>(REQUEST_HEADER_BYTES + encoded.size()));
+    writer.u64(id);
+    writer.u32(timeLimitMs);
+    writer.raw(encoded);
+#ifndef _WIN32
+    if (!sendAll(fd, writer.bytes())) {
+        throw runtime_error("Lost the connection to the server");
+    }
+#endif
+}
+
+void ServerConnection::finishSending() {
+#ifndef _WIN32
+    ::shutdown(fd, SHUT_WR);
+#endif
+}
+
+bool ServerConnection::receive(ServerResponse& response) {
+#ifdef _WIN32
+    return false;
+#else
+    char header[4];
+    if (!receiveAll(fd, header, sizeof(header))) return false;
+    uint32_t length = frameLength(header);
+    if (length < RESPONSE_HEADER_BYTES || length > MAX_FRAME_BYTES) {
+        throw runtime_error("Bad response frame from the server");
+    }
+    string payload(length, '\0');
+    if (!receiveAll(fd, payload.data(), payload.size())) {
+        throw runtime_error("Lost the connection to the server");
+    }
+    BinaryReader reader(payload);
+    response.id = reader.u64();
+    response.status = static_cast<ResponseStatus>(reader.u8());
+    response.message = string(reader.raw(reader.u32()));
+    response.result = PackedResult();
+    if (response.status == ResponseStatus::Solved || response.status == ResponseStatus::Stopped) {
+        response.result = parseBinaryResult(payload.substr(RESPONSE_HEADER_BYTES + response.message.size()));
+    }
+    return true;
+#endif
+}
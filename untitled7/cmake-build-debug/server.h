@@ -0,0 +1,156 @@
+#ifndef SERVER_H
+#define SERVER_H
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "binary_format.h"
+#include "metrics.h"
+#include "problem.h"
+#include "qm.h"
+
+class FlightRecorder;
+class ResultCache;
+
+// Long-running solver behind a Unix domain socket, for tools that minimize
+// functions all the time and should not pay for a process (and cold tables,
+// caches and arenas) per function.
+//
+// Protocol: every message is a frame of u32 payload length and payload, with
+// all integers little endian.
+//   Request payload:  u64 request id, u32 time limit in milliseconds (0 = the
+//                     server's default), binary problem (see binary_format.h)
+//   Response payload: u64 request id, u8 ResponseStatus, u32 message length,
+//                     message (the errors of the result, '\n' separated), then
+//                     for Solved and Stopped a binary result
+// A connection may have any number of requests in flight; responses come in
+// the order the requests finish and carry the id they were sent with.
+const uint32_t MAX_FRAME_BYTES = uint32_t(64) << 20;
+
+enum class ResponseStatus : uint8_t {
+    Solved = 0,     // The minimal result
+    Stopped = 1,    // Ran out of time or memory: the best cover found so far (see QMResult::failedPhase)
+    Invalid = 2,    // The problem failed validation
+    Error = 3       // The request could not be read
+};
+
+// Requests read but not yet taken by a worker; connections are not read
+// while this many are waiting
+const size_t MAX_QUEUED_REQUESTS = 4096;
+
+// Responses waiting for a client to read them; a connection is not read while
+// it has this many bytes of them, so a client that never reads its responses
+// only holds up its own requests
+const size_t MAX_PENDING_OUTPUT_BYTES = size_t(16) << 20;
+
+struct ServerOptions {
+    std::string socketPath;
+    unsigned threads = 0;            // Solver threads; 0 = one per hardware thread
+    ResultCache* cache = nullptr;    // Shared by all solves (see result_cache.h)
+    size_t memoryBudget = 0;         // Scratch memory cap of every solve (see QM::setMemoryBudget)
+    uint32_t defaultTimeLimitMs = 0; // For requests without a time limit; 0 = none
+    uint16_t metricsPort = 0;        // Serves GET /metrics on 127.0.0.1 at this port; 0 = off
+    FlightRecorder* recorder = nullptr; // Keeps requests whose solve was slow (see flight_recorder.h)
+};
+
+// Serves requests on a pool of solver threads. Workers never wait for a
+// client: a response goes out right away as far as the socket takes it, and
+// run() sends the rest when the socket is writable. Each thread keeps one
+// SolverContext for its whole life, so arenas stay allocated between requests,
+// and all of them share the result cache (keyed by NP class, see canonical.h).
+// Metrics (see metrics.h) are served over HTTP to local clients, e.g.
+// curl http://127.0.0.1:PORT/metrics, by the same loop without blocking it. Unix only; run() throws runtime_error elsewhere.
+class Server {
+public:
+    explicit Server(const ServerOptions& options);
+    ~Server();
+
+    Server(const Server&) = delete;
+    Server& operator=(const Server&) = delete;
+
+    // Listens on the socket (replacing a stale socket file) and serves until
+    // stop(); throws runtime_error if the socket cannot be set up
+    void run();
+
+    // Makes run() return after cancelling the solves in flight (their requests
+    // are answered as Stopped). Only stores atomics, so a signal handler may call it.
+    void stop() {
+        stopping.store(true, std::memory_order_relaxed);
+        cancellation.cancel();
+    }
+
+private:
+    struct Connection;
+    struct Request {
+        std::shared_ptr<Connection> connection;
+        uint64_t id = 0;
+        uint32_t timeLimitMs = 0;
+        std::string problem;
+        std::chrono::steady_clock::time_point received;
+    };
+
+    void worker(size_t index);
+    void serveRequest(Request& request, SolverContext& context, WorkerMetrics& recorded);
+    void queueOutput(Connection& connection, const std::string& frame);
+    void sendOutput(Connection& connection);
+    bool readFrames(const std::shared_ptr<Connection>& connection);
+    std::string metricsResponse(const std::string& request);
+    size_t queueDepth();
+
+    ServerOptions options;
+    unsigned threads;
+    ServerMetrics metrics;
+    std::atomic<bool> stopping{false};
+    CancellationToken cancellation;
+
+    std::mutex queueMutex;
+    std::condition_variable queueChanged;
+    std::deque<Request> queue;
+    bool draining = false;
+    std::vector<std::thread> workers;
+
+    // Workers write a byte here when they leave a response for run() to send
+    int wakeRead = -1;
+    int wakeWrite = -1;
+};
+
+// One reply of the server
+struct ServerResponse {
+    uint64_t id = 0;
+    ResponseStatus status = ResponseStatus::Error;
+    PackedResult result;
+    std::string message;
+};
+
+// Client side of the protocol. send() and receive() may run on two threads at
+// once, which is how requests are pipelined.
+class ServerConnection {
+public:
+    // Throws runtime_error if the server cannot be reached
+    explicit ServerConnection(const std::string& socketPath);
+    ~ServerConnection();
+
+    ServerConnection(const ServerConnection&) = delete;
+    ServerConnection& operator=(const ServerConnection&) = delete;
+
+    void send(uint64_t id, const Problem& problem, uint32_t timeLimitMs = 0);
+
+    // Tells the server no more requests follow (responses still arrive)
+    void finishSending();
+
+    // Waits for the next response; false once the server closed the connection
+    bool receive(ServerResponse& response);
+
+private:
+    int fd = -1;
+};
+
+#endif // SERVER_H
@@ -0,0 +1,177 @@
+#include "small_table.h"
+#include "cube_table.h"
+#include <algorithm>
+#include <array>
+#include <bit>
+#include <set>
+#include <string>
+
+using namespace std;
+
+// A cube with the terms it covers as a bit mask
+struct SmallCube {
+    PackedCube cube;
+    uint32_t terms;
+};
+
+// Every cube of n variables, in the order of their strings ('-' < '0' < '1')
+static vector<SmallCube> listCubes(int n) {
+    int count = 1;
+    for (int i = 0; i < n; i++) count *= 3;
+
+    vector<SmallCube> cubes;
+    for (int key = 0; key < count; key++) {
+        // Base 3 digit i is variable bit i: 0 = '-', 1 = '0', 2 = '1'
+        PackedCube cube{0, 0};
+        for (int i = 0, digits = key; i < n; i++, digits /= 3) {
+            if (digits % 3 != 0) cube.care |= 1u << i;
+            if (digits % 3 == 2) cube.value |= 1u << i;
+        }
+        uint32_t terms = 0;
+        for (uint32_t t = 0; t < (1u << n); t++) {
+            if ((t & cube.care) == cube.value) terms |= 1u << t;
+        }
+        cubes.push_back({cube, terms});
+    }
+    return cubes;
+}
+
+static const vector<SmallCube>& smallCubes(int n) {
+    static const array<vector<SmallCube>, SMALL_TABLE_VARIABLES + 1> cubes = []() {
+        array<vector<SmallCube>, SMALL_TABLE_VARIABLES + 1> lists;
+        for (int n = 1; n <= SMALL_TABLE_VARIABLES; n++) lists[n] = listCubes(n);
+        return lists;
+    }();
+    return cubes[n];
+}
+
+// The record of a function of SMALL_TABLE_VARIABLES variables
+static const uint8_t* findRecord(uint32_t function) {
+    const uint8_t* record = smallTableRecords + smallTableBlocks[function / SMALL_TABLE_BLOCK];
+    for (uint32_t skipped = function % SMALL_TABLE_BLOCK; skipped > 0; skipped--) {
+        record += 3 + record[0] + record[1] * record[2];
+    }
+    return record;
+}
+
+// Terms of cover of the smallest function: the essentials plus one alternative
+static int coverSize(const uint8_t* record) {
+    return record[0] + (record[1] != 0 ? record[2] : 0);
+}
+
+// The same function over SMALL_TABLE_VARIABLES variables (the extra ones unused)
+static uint32_t widen(uint32_t terms, int n) {
+    for (int width = 1 << n; width < (1 << SMALL_TABLE_VARIABLES); width *= 2) terms |= terms << width;
+    return terms;
+}
+
+bool solveSmallFunction(int variables, const vector<int>& minterms, const vector<int>& dontCares,
+                        QMResult& result) {
+    if (variables > SMALL_TABLE_VARIABLES || dontCares.size() > SMALL_TABLE_MAX_DONT_CARES) {
+        return false;
+    }
+    uint32_t on = 0;
+    uint32_t dc = 0;
+    for (int m : minterms) on |= 1u << m;
+    for (int d : dontCares) dc |= 1u << d;
+    uint32_t care = on | dc;
+
+    result = QMResult();
+    result.variables = variables;
+    result.stats.fromTable = true;
+
+    // Primes: cubes inside ON + DC whose every widening (one more dash) is not
+    const vector<SmallCube>& cubes = smallCubes(variables);
+    vector<const SmallCube*> primes;
+    array<int, 256> primeOf;
+    primeOf.fill(-1);
+    for (const SmallCube& c : cubes) {
+        if ((c.terms & ~care) != 0) continue;
+        bool prime = true;
+        for (uint32_t fixed = c.cube.care; fixed != 0 && prime; fixed &= fixed - 1) {
+            int shift = 1 << countr_zero(fixed);
+            uint32_t neighbour = (c.cube.value & (fixed & (~fixed + 1))) ? c.terms >> shift : c.terms << shift;
+            prime = (neighbour & ~care) != 0;
+        }
+        if (prime) {
+            primeOf[(c.cube.care << 4) | c.cube.value] = static_cast<int>(primes.size());
+            primes.push_back(&c);
+            result.primeImplicants.push_back(unpackCube(c.cube, variables));
+        }
+    }
+
+    // Essentials in the order the solver finds them (by their first minterm)
+    vector<char> essential(primes.size(), 0);
+    uint32_t covered = 0;
+    for (int m : minterms) {
+        int count = 0;
+        size_t only = 0;
+        for (size_t p = 0; p < primes.size(); p++) {
+            if (primes[p]->terms & (1u << m)) {
+                count++;
+                only = p;
+            }
+        }
+        if (count == 1 && !essential[only]) {
+            essential[only] = 1;
+            covered |= primes[only]->terms;
+            result.essentialPrimeImplicants.push_back(result.primeImplicants[only]);
+        }
+    }
+    for (int m : minterms) {
+        if (!(covered & (1u << m))) result.uncoveredAfterEssentials.push_back(m);
+    }
+    result.cover = result.essentialPrimeImplicants;
+    if (result.uncoveredAfterEssentials.empty()) return true;
+
+    // The cheapest completions
+    int bestSize = INT32_MAX;
+    vector<const uint8_t*> best;
+    for (uint32_t subset = 0; subset < (1u << dontCares.size()); subset++) {
+        uint32_t completion = on;
+        for (size_t d = 0; d < dontCares.size(); d++) {
+            if (subset & (1u << d)) completion |= 1u << dontCares[d];
+        }
+        const uint8_t* record = findRecord(widen(completion, variables));
+        int size = coverSize(record);
+        if (size < bestSize) {
+            bestSize = size;
+            best.clear();
+        }
+        if (size == bestSize) best.push_back(record);
+    }
+
+    // Their covers made of primes of the function, less the essentials, in
+    // the order of Petrick's method (by prime indices)
+    uint32_t variableMask = (1u << variables) - 1;
+    set<vector<int>> alternatives;
+    auto addCover = [&](const uint8_t* record, const uint8_t* alternative, int terms) {
+        vector<int> indices;
+        auto addCube = [&](uint8_t byte) {
+            int p = primeOf[(((byte >> 4) & variableMask) << 4) | (byte & variableMask)];
+            if (p >= 0 && !essential[p]) indices.push_back(p);
+            return p >= 0;
+        };
+        for (int i = 0; i < record[0]; i++) {
+            if (!addCube(record[3 + i])) return;
+        }
+        for (int i = 0; i < terms; i++) {
+            if (!addCube(alternative[i])) return;
+        }
+        sort(indices.begin(), indices.end());
+        alternatives.insert(indices);
+    };
+    for (const uint8_t* record : best) {
+        const uint8_t* alternative = record + 3 + record[0];
+        if (record[1] == 0) addCover(record, alternative, 0);
+        for (int a = 0; a < record[1]; a++, alternative += record[2]) addCover(record, alternative, record[2]);
+    }
+
+    for (const vector<int>& indices : alternatives) {
+        vector<string> alternative;
+        for (int p : indices) alternative.push_back(result.primeImplicants[p]);
+        result.alternatives.push_back(alternative);
+    }
+    result.cover.insert(result.cover.end(), result.alternatives[0].begin(), result.alternatives[0].end());
+    return true;
+}
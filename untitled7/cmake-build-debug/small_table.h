@@ -0,0 +1,34 @@
+#ifndef SMALL_TABLE_H
+#define SMALL_TABLE_H
+
+#include <cstdint>
+#include <vector>
+#include "qm_result.h"
+
+// Exact answers for functions of up to SMALL_TABLE_VARIABLES variables from a
+// table generated at build time (by qm-tablegen, from the solver itself) that
+// holds every minimal cover of every such function without don't-cares.
+//
+// Primes, essentials and uncovered minterms are found with bit masks. With
+// don't-cares the table is searched over the completions (ON plus any subset
+// of the don't-cares): the minimum covers of the function are exactly the
+// minimum covers among the cheapest completions that consist of its primes.
+// Either way the result is the one solve() would return, alternatives and
+// order included.
+const int SMALL_TABLE_VARIABLES = 4;
+const int SMALL_TABLE_MAX_DONT_CARES = 8; // More would mean over 256 completions
+
+// The table: one record per function (bit t of the index = value of term t).
+// A record is u8 essentials, u8 alternatives, u8 terms per alternative, then
+// the essentials and every alternative as cube bytes (care << 4 | value).
+// smallTableBlocks holds the offset of every SMALL_TABLE_BLOCK-th record.
+const int SMALL_TABLE_BLOCK = 16;
+extern const uint32_t smallTableBlocks[];
+extern const uint8_t smallTableRecords[];
+
+// Fills result for a validated single-output problem and returns true, or
+// returns false when the problem is too big for the table
+bool solveSmallFunction(int variables, const std::vector<int>& minterms, const std::vector<int>& dontCares,
+                        QMResult& result);
+
+#endif // SMALL_TABLE_H
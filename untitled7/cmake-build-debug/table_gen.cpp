@@ -0,0 +1,72 @@
+#include "cube_table.h"
+#include "problem.h"
+#include "qm.h"
+#include "small_table.h"
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+// Writes the table of small_table.h as C++ source: every function of
+// SMALL_TABLE_VARIABLES variables solved by the solver (built without the table).
+// Usage: qm-tablegen OUTPUT
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        cerr << "Usage: qm-tablegen OUTPUT\n";
+        return 1;
+    }
+
+    auto cubeByte = [](const string& cube) {
+        PackedCube packed = packCube(cube);
+        return static_cast<uint8_t>((packed.care << 4) | packed.value);
+    };
+
+    SolverContext context;
+    vector<uint32_t> blocks;
+    vector<uint8_t> records;
+    uint32_t functions = 1u << (1 << SMALL_TABLE_VARIABLES);
+    for (uint32_t function = 0; function < functions; function++) {
+        if (function % SMALL_TABLE_BLOCK == 0) blocks.push_back(static_cast<uint32_t>(records.size()));
+
+        Problem problem;
+        problem.variables = SMALL_TABLE_VARIABLES;
+        for (int t = 0; t < (1 << SMALL_TABLE_VARIABLES); t++) {
+            if (function & (1u << t)) problem.minterms.push_back(t);
+        }
+        QMResult result = solve(problem, context);
+        size_t terms = result.alternatives.empty() ? 0 : result.alternatives[0].size();
+        for (const vector<string>& alternative : result.alternatives) {
+            if (alternative.size() != terms || result.alternatives.size() > 255) {
+                cerr << "qm-tablegen: unexpected solution of function " << function << "\n";
+                return 1;
+            }
+        }
+
+        records.push_back(static_cast<uint8_t>(result.essentialPrimeImplicants.size()));
+        records.push_back(static_cast<uint8_t>(result.alternatives.size()));
+        records.push_back(static_cast<uint8_t>(terms));
+        for (const string& cube : result.essentialPrimeImplicants) records.push_back(cubeByte(cube));
+        for (const vector<string>& alternative : result.alternatives) {
+            for (const string& cube : alternative) records.push_back(cubeByte(cube));
+        }
+    }
+
+    ofstream out(argv[1], ios::trunc);
+    if (!out.is_open()) {
+        cerr << "qm-tablegen: could not open " << argv[1] << " for writing\n";
+        return 1;
+    }
+    out << "// Generated by qm-tablegen (see small_table.h); do not edit.\n";
+    out << "#include \"small_table.h\"\n\n";
+    out << "const uint32_t smallTableBlocks[] = {";
+    for (size_t i = 0; i < blocks.size(); i++) out << (i % 16 == 0 ? "\n    " : " ") << blocks[i] << ",";
+    out << "\n};\n\nconst uint8_t smallTableRecords[] = {";
+    for (size_t i = 0; i < records.size(); i++) out << (i % 32 == 0 ? "\n    " : "") << int(records[i]) << ",";
+    out << "\n};\n";
+    if (!out) {
+        cerr << "qm-tablegen: could not write " << argv[1] << "\n";
+        return 1;
+    }
+    return 0;
+}
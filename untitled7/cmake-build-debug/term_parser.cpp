@@ -0,0 +1,109 @@
+#include "term_parser.h"
+#include <bit>
+#include <charconv>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define QM_HAVE_SSE2 1
+#endif
+
+using namespace std;
+
+// Removes leading and trailing whitespace from a token
+static string_view trim(string_view token) {
+    const char* whitespace = " \t\r\n\v\f";
+    size_t first = token.find_first_not_of(whitespace);
+    if (first == string_view::npos) return {};
+    size_t last = token.find_last_not_of(whitespace);
+    return token.substr(first, last - first + 1);
+}
+
+// Parses a whole token as a decimal integer (surrounding whitespace allowed)
+bool parseInt(string_view token, int& value) {
+    token = trim(token);
+    if (!token.empty() && token[0] == '+') token.remove_prefix(1);
+    if (token.empty()) return false;
+    auto result = from_chars(token.data(), token.data() + token.size(), value);
+    return result.ec == errc() && result.ptr == token.data() + token.size();
+}
+
+// Parses one token, either a single term or a "low-high" range; sets kind on failure
+static bool parseTermToken(string_view token, vector<int>& out, TermParseIssue::Kind& kind) {
+    // A '-' after the first character separates the ends of a range
+    size_t dash = token.find('-', 1);
+    if (dash == string_view::npos) {
+        int value;
+        if (parseInt(token, value)) {
+            out.push_back(value);
+            return true;
+        }
+        bool tooLarge = from_chars(token.data(), token.data() + token.size(), value).ec == errc::result_out_of_range;
+        kind = tooLarge ? TermParseIssue::OutOfRange : TermParseIssue::InvalidTerm;
+        return false;
+    }
+
+    int low, high;
+    if (!parseInt(token.substr(0, dash), low) || !parseInt(token.substr(dash + 1), high) ||
+        low < 0 || high < low) {
+        kind = TermParseIssue::InvalidRange;
+        return false;
+    }
+    if (high > MAX_TERM) {
+        kind = TermParseIssue::OutOfRange;
+        return false;
+    }
+    for (int term = low; term <= high; term++) {
+        out.push_back(term);
+    }
+    return true;
+}
+
+// Parses comma separated terms and ranges such as "1, 4, 100-4095" into out
+bool parseTermList(string_view input, vector<int>& out, vector<TermParseIssue>* issues) {
+    bool ok = true;
+    const char* p = input.data();
+    const char* end = p + input.size();
+    while (true) {
+        const char* comma = findChar(p, end, ',');
+        string_view token = trim(string_view(p, comma - p));
+        TermParseIssue::Kind kind;
+        if (!token.empty() && !parseTermToken(token, out, kind)) {
+            ok = false;
+            if (issues) issues->push_back({kind, string(token)});
+        }
+        if (comma == end) break;
+        p = comma + 1;
+    }
+    return ok;
+}
+
+// Finds the first c in [begin, end), scanning 16 bytes at a time when SSE2 is available
+const char* findChar(const char* begin, const char* end, char c) {
+    const char* p = begin;
+#ifdef QM_HAVE_SSE2
+    const __m128i needle = _mm_set1_epi8(c);
+    while (end - p >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(_mm_cmpeq_epi8(chunk, needle)));
+        if (mask != 0) return p + countr_zero(mask);
+        p += 16;
+    }
+#endif
+    while (p < end && *p != c) p++;
+    return p;
+}
+
+// Splits a buffer into lines the way getline would, dropping a trailing '\r'
+vector<string_view> splitLines(string_view buffer) {
+    vector<string_view> lines;
+    const char* p = buffer.data();
+    const char* end = p + buffer.size();
+    while (p < end) {
+        const char* newline = findChar(p, end, '\n');
+        string_view line(p, newline - p);
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        lines.push_back(line);
+        p = newline + 1;
+    }
+    return lines;
+}
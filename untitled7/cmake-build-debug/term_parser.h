@@ -0,0 +1,31 @@
+#ifndef TERM_PARSER_H
+#define TERM_PARSER_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Largest term any problem can use (20 variables)
+const int MAX_TERM = (1 << 20) - 1;
+
+// A token rejected by the term list parser (reported instead of thrown)
+struct TermParseIssue {
+    enum Kind { InvalidTerm, OutOfRange, InvalidRange };
+    Kind kind;
+    std::string token;
+};
+
+// Parses a whole token as a decimal integer (surrounding whitespace allowed)
+bool parseInt(std::string_view token, int& value);
+
+// Parses comma separated terms and ranges such as "1, 4, 100-4095" into out.
+// Bad tokens are skipped and described in issues; returns false if any was skipped.
+bool parseTermList(std::string_view input, std::vector<int>& out, std::vector<TermParseIssue>* issues);
+
+// Finds the first c in [begin, end), scanning 16 bytes at a time when SSE2 is available
+const char* findChar(const char* begin, const char* end, char c);
+
+// Splits a buffer into lines the way getline would, dropping a trailing '\r'
+std::vector<std::string_view> splitLines(std::string_view buffer);
+
+#endif // TERM_PARSER_H
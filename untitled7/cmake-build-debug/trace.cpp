@@ -0,0 +1,108 @@
+#include "trace.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+atomic<bool> traceEnabled{false};
+
+struct TraceEvent {
+    const char* name;
+    const char* argName;
+    long long arg;
+    uint64_t startNs;
+    uint64_t endNs;
+};
+
+// The spans of one thread; events[recorded % TRACE_RING_EVENTS] is written next
+struct TraceRing {
+    size_t thread = 0;
+    size_t recorded = 0;
+    vector<TraceEvent> events;
+};
+
+// Every ring ever created, in order of the threads' first events
+struct TraceRings {
+    mutex lock;
+    vector<unique_ptr<TraceRing>> rings;
+};
+
+static TraceRings& traceRings() {
+    static TraceRings rings;
+    return rings;
+}
+
+static thread_local TraceRing* threadRing = nullptr;
+
+void setTracing(bool on) {
+    traceNow(); // Start the clock before the first span
+    traceEnabled.store(on, memory_order_relaxed);
+}
+
+uint64_t traceNow() {
+    static const chrono::steady_clock::time_point epoch = chrono::steady_clock::now();
+    return static_cast<uint64_t>(chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - epoch).count());
+}
+
+void traceRecord(const char* name, uint64_t startNs, uint64_t endNs, const char* argName, long long arg) {
+    if (!threadRing) {
+        TraceRings& all = traceRings();
+        lock_guard<mutex> lock(all.lock);
+        auto ring = make_unique<TraceRing>();
+        ring->thread = all.rings.size() + 1;
+        ring->events.resize(TRACE_RING_EVENTS);
+        threadRing = ring.get();
+        all.rings.push_back(move(ring));
+    }
+    threadRing->events[threadRing->recorded++ % TRACE_RING_EVENTS] = {name, argName, arg, startNs, endNs};
+}
+
+void writeTrace(ostream& out) {
+    TraceRings& all = traceRings();
+    lock_guard<mutex> lock(all.lock);
+
+    // Times are in microseconds with nanosecond decimals
+    auto micros = [](uint64_t ns) {
+        char text[32];
+        snprintf(text, sizeof(text), "%llu.%03llu", static_cast<unsigned long long>(ns / 1000),
+                 static_cast<unsigned long long>(ns % 1000));
+        return string(text);
+    };
+
+    out << "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [";
+    bool first = true;
+    auto separator = [&]() {
+        out << (first ? "\n" : ",\n");
+        first = false;
+    };
+    for (const auto& ring : all.rings) {
+        separator();
+        out << "{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": " << ring->thread
+            << ", \"args\": {\"name\": \"thread " << ring->thread << "\"}}";
+
+        // Oldest first; a full ring has lost the spans before its write position
+        size_t count = min(ring->recorded, TRACE_RING_EVENTS);
+        size_t oldest = ring->recorded - count;
+        for (size_t i = oldest; i < ring->recorded; i++) {
+            const TraceEvent& event = ring->events[i % TRACE_RING_EVENTS];
+            separator();
+            out << "{\"name\": \"" << event.name << "\", \"cat\": \"qm\", \"ph\": \"X\", \"pid\": 1, \"tid\": "
+                << ring->thread << ", \"ts\": " << micros(event.startNs)
+                << ", \"dur\": " << micros(event.endNs - event.startNs);
+            if (event.argName) out << ", \"args\": {\"" << event.argName << "\": " << event.arg << "}";
+            out << "}";
+        }
+    }
+    out << "\n]}\n";
+}
+
+void clearTrace() {
+    TraceRings& all = traceRings();
+    lock_guard<mutex> lock(all.lock);
+    for (const auto& ring : all.rings) ring->recorded = 0;
+}
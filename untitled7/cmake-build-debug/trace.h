@@ -0,0 +1,60 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+
+// Timeline recording of the solver in the Chrome trace event format, which
+// Perfetto (ui.perfetto.dev) and chrome://tracing open offline.
+//
+// Recording is off until setTracing(true) and can be switched at any time;
+// while it is off a TraceSpan costs one relaxed atomic load. Every thread
+// records into a ring buffer of its own (no locks after the first event), so
+// the oldest spans of a thread are dropped once it has recorded
+// TRACE_RING_EVENTS of them. Buffers outlive their threads, so a trace
+// written after the workers joined still shows them.
+const size_t TRACE_RING_EVENTS = size_t(1) << 16;
+
+extern std::atomic<bool> traceEnabled;
+
+inline bool tracing() { return traceEnabled.load(std::memory_order_relaxed); }
+void setTracing(bool on);
+
+// Nanoseconds since the first call in the process
+uint64_t traceNow();
+
+// Records a finished span on the calling thread. name and argName must be
+// string literals (only the pointers are kept).
+void traceRecord(const char* name, uint64_t startNs, uint64_t endNs, const char* argName, long long arg);
+
+// Records the span from construction to destruction when tracing was on at
+// construction, e.g. TraceSpan span("combine_level", "cubes", level.size());
+class TraceSpan {
+public:
+    explicit TraceSpan(const char* name, const char* argName = nullptr, long long arg = 0)
+        : name(tracing() ? name : nullptr), argName(argName), arg(arg), start(this->name ? traceNow() : 0) {}
+    ~TraceSpan() {
+        if (name) traceRecord(name, start, traceNow(), argName, arg);
+    }
+
+    TraceSpan(const TraceSpan&) = delete;
+    TraceSpan& operator=(const TraceSpan&) = delete;
+
+private:
+    const char* name;
+    const char* argName;
+    long long arg;
+    uint64_t start;
+};
+
+// Writes every recorded span as a Chrome trace JSON object, one track per
+// thread. The buffers are not locked against their threads: call it (and
+// clearTrace) once the traced work is done.
+void writeTrace(std::ostream& out);
+
+// Drops every recorded span (the buffers stay allocated)
+void clearTrace();
+
+#endif // TRACE_H
@@ -0,0 +1,273 @@
+#include "problem.h"
+#include "qm.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <memory_resource>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Micro-benchmarks of the solver kernels. Every case runs an untimed setup and
+// then the timed kernel, repeatedly, until --min-time has been spent in the
+// kernel (see runCase). Inputs come from seeded generators, so a case sees the same input on
+// every run, whatever else is selected.
+//
+// Usage: qm-bench [--filter TEXT] [--min-time SECONDS] [--seed N] [--out FILE]
+//   --filter TEXT      only cases whose name contains TEXT
+//   --min-time SECONDS kernel time to spend per case (default 0.2)
+//   --seed N           seed of the generators (default 1)
+//   --out FILE         write the JSON report to FILE instead of standard output
+
+// Variable counts and densities swept by the function based cases; cases with
+// more than MAX_TERMS terms in ON + DC are left out (combining is quadratic)
+const int VARIABLE_COUNTS[] = {4, 6, 8, 10, 12, 14, 16, 18, 20};
+const double ON_DENSITIES[] = {0.001, 0.01, 0.1, 0.3};
+const double DC_DENSITIES[] = {0.0, 0.05};
+const size_t MAX_TERMS = 4096;
+
+// Covering tables for Petrick's method: rows, and columns per row
+const int PETRICK_ROWS[] = {8, 16, 32, 64};
+const int PETRICK_COLUMNS_PER_ROW[] = {2, 3};
+
+struct BenchCase {
+    string name;
+    string kernel;
+    int variables = 0;
+    double onDensity = 0;
+    double dcDensity = 0;
+    size_t items = 0;                 // Size of the kernel's input (terms, primes, rows, ...)
+    function<void()> setup;           // Untimed, before every run
+    function<void()> run;             // Timed
+};
+
+struct BenchTiming {
+    size_t iterations = 0;
+    double minNs = 0;
+    double medianNs = 0;
+    double meanNs = 0;
+};
+
+// A seed for one case that does not depend on which other cases run
+static uint64_t caseSeed(uint64_t seed, const string& name) {
+    uint64_t hash = 1469598103934665603ull ^ seed;
+    for (unsigned char c : name) hash = (hash ^ c) * 1099511628211ull;
+    return hash;
+}
+
+// A random function: every term is in ON with probability onDensity, else in DC with probability dcDensity
+static Problem randomProblem(int variables, double onDensity, double dcDensity, uint64_t seed) {
+    mt19937_64 random(seed);
+    uniform_real_distribution<double> draw(0, 1);
+    Problem problem;
+    problem.variables = variables;
+    for (int t = 0; t < (1 << variables); t++) {
+        double x = draw(random);
+        if (x < onDensity) problem.minterms.push_back(t);
+        else if (x < onDensity + dcDensity) problem.dontCares.push_back(t);
+    }
+    return problem;
+}
+
+static string densityName(double density) {
+    string text = to_string(density);
+    text.erase(text.find_last_not_of('0') + 1);
+    if (text.back() == '.') text.pop_back();
+    return text;
+}
+
+// Runs a case until the kernel took minSeconds, or setup and kernel together
+// MAX_WALL_FACTOR times that (setups can dwarf small kernels), at least 3 times
+const double MAX_WALL_FACTOR = 5;
+
+static BenchTiming runCase(const BenchCase& bench, double minSeconds) {
+    vector<double> samples;
+    double total = 0;
+    auto caseStart = chrono::steady_clock::now();
+    auto elapsed = [&]() { return chrono::duration<double>(chrono::steady_clock::now() - caseStart).count(); };
+    while (samples.size() < 3 || (total < minSeconds * 1e9 && elapsed() < minSeconds * MAX_WALL_FACTOR)) {
+        bench.setup();
+        auto start = chrono::steady_clock::now();
+        bench.run();
+        double ns = chrono::duration<double, nano>(chrono::steady_clock::now() - start).count();
+        samples.push_back(ns);
+        total += ns;
+    }
+    sort(samples.begin(), samples.end());
+    BenchTiming timing;
+    timing.iterations = samples.size();
+    timing.minNs = samples.front();
+    timing.medianNs = samples[samples.size() / 2];
+    timing.meanNs = total / samples.size();
+    return timing;
+}
+
+int main(int argc, char* argv[]) {
+    string filter;
+    string outFile;
+    double minSeconds = 0.2;
+    uint64_t seed = 1;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--filter" && i + 1 < argc) {
+            filter = argv[++i];
+        } else if (arg == "--min-time" && i + 1 < argc) {
+            minSeconds = stod(argv[++i]);
+        } else if (arg == "--seed" && i + 1 < argc) {
+            seed = stoull(argv[++i]);
+        } else if (arg == "--out" && i + 1 < argc) {
+            outFile = argv[++i];
+        } else {
+            cerr << "Usage: qm-bench [--filter TEXT] [--min-time SECONDS] [--seed N] [--out FILE]\n";
+            return 1;
+        }
+    }
+
+    // Every case gets its own solver and inputs, built only when it is selected
+    vector<BenchCase> cases;
+    auto selected = [&](const string& name) { return name.find(filter) != string::npos; };
+
+    for (int n : VARIABLE_COUNTS) {
+        string name = "grey_code/n=" + to_string(n);
+        if (!selected(name)) continue;
+        auto qm = make_shared<QM>(n);
+        auto pairs = make_shared<vector<pair<string, string>>>();
+        mt19937_64 random(caseSeed(seed, name));
+        for (int i = 0; i < 1024; i++) {
+            // Half of the pairs differ in one position and combine
+            string a = qm->decToBin(static_cast<int>(random() & ((1u << n) - 1)));
+            string b = a;
+            int flips = (i % 2 == 0) ? 1 : 1 + static_cast<int>(random() % n);
+            for (int f = 0; f < flips; f++) {
+                char& c = b[random() % n];
+                c = (c == '0') ? '1' : '0';
+            }
+            pairs->emplace_back(a, b);
+        }
+        auto sink = make_shared<size_t>(0);
+        cases.push_back({name, "grey_code", n, 0, 0, pairs->size(), []() {}, [qm, pairs, sink]() {
+            for (const auto& [a, b] : *pairs) {
+                if (qm->isGreyCode(a, b)) *sink += qm->combineTerms(a, b).size();
+            }
+        }});
+    }
+
+    for (int n : VARIABLE_COUNTS) {
+        for (double on : ON_DENSITIES) {
+            for (double dc : DC_DENSITIES) {
+                if ((on + dc) * (1 << n) > MAX_TERMS) continue;
+                string suffix = "/n=" + to_string(n) + ",on=" + densityName(on) + ",dc=" + densityName(dc);
+                auto problem = make_shared<Problem>(randomProblem(n, on, dc, caseSeed(seed, suffix)));
+                auto qm = make_shared<QM>(n);
+                size_t terms = problem->minterms.size() + problem->dontCares.size();
+
+                // One combining level: the terms into cubes with one dash
+                if (selected("combine_level" + suffix)) {
+                    auto level = make_shared<pmr::vector<CubeId>>();
+                    cases.push_back({"combine_level" + suffix, "combine_level", n, on, dc, terms,
+                                     [qm, problem, level]() {
+                                         qm->load(*problem);
+                                         *level = qm->firstLevel(); // Copied out of the solver's arena
+                                     },
+                                     [qm, level]() { qm->combineLevel(*level); }});
+                }
+
+                // Prime/minterm coverage, over the primes of the function
+                if (selected("coverage" + suffix)) {
+                    cases.push_back({"coverage" + suffix, "coverage", n, on, dc, problem->minterms.size(),
+                                     [qm, problem]() {
+                                         qm->load(*problem);
+                                         qm->generatePrimeImplicants();
+                                     },
+                                     [qm]() { qm->buildCoverage(); }});
+                }
+
+                // Essential detection, over that coverage
+                if (selected("essentials" + suffix)) {
+                    auto coverage = make_shared<PrimeCoverage>(pmr::new_delete_resource());
+                    auto essential = make_shared<pmr::vector<char>>();
+                    auto covered = make_shared<pmr::vector<char>>();
+                    cases.push_back({"essentials" + suffix, "essentials", n, on, dc, problem->minterms.size(),
+                                     [qm, problem, coverage]() {
+                                         qm->load(*problem);
+                                         qm->generatePrimeImplicants();
+                                         PrimeCoverage built = qm->buildCoverage();
+                                         coverage->mintermPIs.assign(built.mintermPIs.begin(), built.mintermPIs.end());
+                                         coverage->piMinterms.assign(built.piMinterms.begin(), built.piMinterms.end());
+                                     },
+                                     [qm, coverage, essential, covered]() {
+                                         qm->selectEssentials(*coverage, *essential, *covered);
+                                     }});
+                }
+            }
+        }
+    }
+
+    // Petrick's method on random covering tables with twice as many columns as rows
+    for (int rows : PETRICK_ROWS) {
+        for (int perRow : PETRICK_COLUMNS_PER_ROW) {
+            string name = "petrick/rows=" + to_string(rows) + ",per_row=" + to_string(perRow);
+            if (!selected(name)) continue;
+            int columns = 2 * rows;
+            auto table = make_shared<CoverTable>(pmr::new_delete_resource());
+            mt19937_64 random(caseSeed(seed, name));
+            table->rowColumns.resize(rows);
+            table->columnRows.resize(columns);
+            for (int c = 0; c < columns; c++) table->columnCubes.push_back(static_cast<CubeId>(c));
+            for (int r = 0; r < rows; r++) {
+                table->rowKeys.push_back(r);
+                while (static_cast<int>(table->rowColumns[r].size()) < perRow) {
+                    auto c = static_cast<uint32_t>(random() % columns);
+                    auto& row = table->rowColumns[r];
+                    if (find(row.begin(), row.end(), c) == row.end()) row.push_back(c);
+                }
+                sort(table->rowColumns[r].begin(), table->rowColumns[r].end());
+                for (uint32_t c : table->rowColumns[r]) table->columnRows[c].push_back(static_cast<uint32_t>(r));
+            }
+
+            // The columns name cubes of a solver holding at least that many
+            Problem all;
+            all.variables = 8;
+            for (int t = 0; t < 256; t++) all.minterms.push_back(t);
+            auto qm = make_shared<QM>(8);
+            cases.push_back({name, "petrick", 0, 0, 0, static_cast<size_t>(rows),
+                             [qm, all]() {
+                                 qm->load(all);
+                                 qm->firstLevel();
+                             },
+                             [qm, table]() { qm->petricksMethod(*table); }});
+        }
+    }
+
+    ofstream file;
+    if (!outFile.empty()) {
+        file.open(outFile, ios::trunc);
+        if (!file.is_open()) {
+            cerr << "Could not open " << outFile << " for writing\n";
+            return 1;
+        }
+    }
+    ostream& out = outFile.empty() ? cout : file;
+
+    out << "{\n  \"benchmark\": \"qm-bench\",\n  \"seed\": " << seed << ",\n  \"min_time\": " << minSeconds
+        << ",\n  \"cases\": [";
+    for (size_t i = 0; i < cases.size(); i++) {
+        const BenchCase& bench = cases[i];
+        BenchTiming timing = runCase(bench, minSeconds);
+        out << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << bench.name << "\", \"kernel\": \"" << bench.kernel
+            << "\", \"variables\": " << bench.variables << ", \"on\": " << bench.onDensity
+            << ", \"dc\": " << bench.dcDensity << ", \"items\": " << bench.items
+            << ", \"iterations\": " << timing.iterations << ", \"min_ns\": " << timing.minNs
+            << ", \"median_ns\": " << timing.medianNs << ", \"mean_ns\": " << timing.meanNs << "}";
+        out.flush();
+        if (!outFile.empty()) cerr << bench.name << ": " << timing.medianNs << " ns\n";
+    }
+    out << "\n  ]\n}\n";
+    return out ? 0 : 1;
+}
@@ -0,0 +1,412 @@
+#include "problem.h"
+#include "qm.h"
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <random>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#ifdef __linux__
+#include <cstdio>
+#include <cstring>
+#elif !defined(_WIN32)
+#include <sys/resource.h>
+#endif
+
+using namespace std;
+
+// End-to-end runs of the minimizer over a corpus: the sample inputs ("test*.txt")
+// plus generated families of functions over a range of variable counts. Every
+// case records wall time (median of --repeat solves), peak RSS, the phase times
+// of the solver's detailed stats (zero for phases a fast path skipped) and the
+// size of its result;
+// a thread sweep then solves the whole corpus on 1, 2, 4, ... threads.
+//
+// Usage: qm-corpus [--tests DIR] [--max-variables N] [--repeat N] [--seed N] [--out FILE]
+//        qm-corpus --compare OLD.json NEW.json [--threshold FRACTION]
+//   --tests DIR          also run every test*.txt of DIR
+//   --max-variables N    cap the variable count of the generated families
+//   --repeat N           solves per case; the median is reported (default 3)
+//   --seed N             seed of the random families (default 1)
+//   --out FILE           write the JSON report to FILE instead of standard output
+//   --compare OLD NEW    report cases of NEW that got slower or bigger than in
+//                        OLD by more than --threshold (default 0.1), or whose
+//                        results changed; exits with 1 if there are any
+
+// Cases faster than this (or growing less than REGRESSION_MIN_RSS_KB) are
+// never flagged, their timings being mostly noise
+const double REGRESSION_MIN_MS = 0.05;
+const double REGRESSION_MIN_RSS_KB = 1024;
+
+struct CorpusCase {
+    string name;
+    string family;
+    int variables = 0;
+    Problem problem;
+};
+
+struct CaseReport {
+    double wallMs = 0;
+    QMStats stats;                    // Of the last solve, with phase times
+    long peakRssKb = 0;
+    size_t primes = 0;
+    size_t coverTerms = 0;
+    size_t alternatives = 0;
+};
+
+// Peak RSS of the process since the last resetPeakRss() (Linux), or since
+// it started (elsewhere); 0 where it is not measured
+static void resetPeakRss() {
+#ifdef __linux__
+    if (FILE* file = fopen("/proc/self/clear_refs", "w")) {
+        fputs("5", file);
+        fclose(file);
+    }
+#endif
+}
+
+static long peakRssKb() {
+#ifdef __linux__
+    long kb = 0;
+    if (FILE* file = fopen("/proc/self/status", "r")) {
+        char line[256];
+        while (fgets(line, sizeof line, file)) {
+            if (strncmp(line, "VmHWM:", 6) == 0) kb = strtol(line + 6, nullptr, 10);
+        }
+        fclose(file);
+    }
+    return kb;
+#elif defined(_WIN32)
+    return 0;
+#else
+    rusage usage{};
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+// A seed for one case that does not depend on which other cases run
+static uint64_t caseSeed(uint64_t seed, const string& name) {
+    uint64_t hash = 1469598103934665603ull ^ seed;
+    for (unsigned char c : name) hash = (hash ^ c) * 1099511628211ull;
+    return hash;
+}
+
+// A single-output problem from a predicate over terms
+template <typename Predicate>
+static Problem functionProblem(int variables, Predicate isOn) {
+    Problem problem;
+    problem.variables = variables;
+    for (int t = 0; t < (1 << variables); t++) {
+        if (isOn(t)) problem.minterms.push_back(t);
+    }
+    return problem;
+}
+
+// The generated families: name, largest variable count by default, generator
+struct Family {
+    string name;
+    int firstVariables;
+    int maxVariables;
+    Problem (*make)(int variables, uint64_t seed);
+};
+
+static Problem randomFunction(int variables, uint64_t seed) {
+    // 30% ON, 5% DC
+    mt19937_64 random(seed);
+    Problem problem;
+    problem.variables = variables;
+    for (int t = 0; t < (1 << variables); t++) {
+        uint64_t x = random() % 100;
+        if (x < 30) problem.minterms.push_back(t);
+        else if (x < 35) problem.dontCares.push_back(t);
+    }
+    return problem;
+}
+
+static Problem symmetricFunction(int variables, uint64_t) {
+    // ON with one or two ones: a cyclic covering table, exponential for the cover search
+    return functionProblem(variables, [](int t) {
+        int ones = popcount(static_cast<unsigned>(t));
+        return ones == 1 || ones == 2;
+    });
+}
+
+static Problem thresholdFunction(int variables, uint64_t seed) {
+    // ON when a weighted sum of the inputs (weights 1 to 3) reaches half the total
+    mt19937_64 random(seed);
+    vector<int> weights(variables);
+    int total = 0;
+    for (int& weight : weights) total += weight = 1 + static_cast<int>(random() % 3);
+    return functionProblem(variables, [&](int t) {
+        int sum = 0;
+        for (int i = 0; i < variables; i++) sum += ((t >> i) & 1) * weights[i];
+        return 2 * sum >= total;
+    });
+}
+
+static Problem parityFunction(int variables, uint64_t) {
+    // Nothing combines: every minterm is a prime
+    return functionProblem(variables, [](int t) { return popcount(static_cast<unsigned>(t)) % 2 == 1; });
+}
+
+static Problem adderFunction(int variables, uint64_t) {
+    // All sum bits of two (variables / 2)-bit numbers as one multi-output problem
+    int bits = variables / 2;
+    Problem problem;
+    problem.variables = variables;
+    problem.outputMinterms.resize(bits + 1);
+    problem.outputDontCares.resize(bits + 1);
+    for (int t = 0; t < (1 << variables); t++) {
+        int sum = (t & ((1 << bits) - 1)) + (t >> bits);
+        for (int k = 0; k <= bits; k++) {
+            if ((sum >> k) & 1) problem.outputMinterms[k].push_back(t);
+        }
+    }
+    return problem;
+}
+
+const Family FAMILIES[] = {
+    {"random", 4, 10, randomFunction},
+    {"symmetric", 4, 7, symmetricFunction},
+    {"threshold", 4, 12, thresholdFunction},
+    {"parity", 4, 12, parityFunction},
+    {"adder", 2, 8, adderFunction},
+};
+
+// Solves a case --repeat times
+static CaseReport runCase(const CorpusCase& corpusCase, int repeat) {
+    CaseReport report;
+    resetPeakRss();
+
+    SolverContext context;
+    context.setDetailedStats(true);
+    vector<double> walls;
+    QMResult result;
+    for (int r = 0; r < repeat; r++) {
+        auto start = chrono::steady_clock::now();
+        result = solve(corpusCase.problem, context);
+        walls.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - start).count());
+    }
+    sort(walls.begin(), walls.end());
+    report.wallMs = walls[walls.size() / 2];
+    report.primes = result.primeImplicants.size();
+    report.coverTerms = result.cover.size();
+    report.alternatives = result.alternatives.size();
+    report.stats = result.stats;
+
+    report.peakRssKb = peakRssKb();
+    return report;
+}
+
+// Solves every case once on threads workers; returns the wall time in milliseconds
+static double runThreads(const vector<CorpusCase>& cases, unsigned threads) {
+    atomic<size_t> next{0};
+    auto start = chrono::steady_clock::now();
+    vector<thread> pool;
+    for (unsigned t = 0; t < threads; t++) {
+        pool.emplace_back([&]() {
+            SolverContext context;
+            for (size_t i = next++; i < cases.size(); i = next++) solve(cases[i].problem, context);
+        });
+    }
+    for (thread& worker : pool) worker.join();
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
+// The value of "key" in a line of a report (reports hold one case per line)
+static bool jsonField(const string& line, const string& key, string& value) {
+    string marker = "\"" + key + "\": ";
+    size_t position = line.find(marker);
+    if (position == string::npos) return false;
+    position += marker.size();
+    if (line[position] == '"') {
+        size_t end = line.find('"', position + 1);
+        value = line.substr(position + 1, end - position - 1);
+    } else {
+        size_t end = line.find_first_of(",}", position);
+        value = line.substr(position, end - position);
+    }
+    return true;
+}
+
+// The cases of a report, by name, as their fields
+static map<string, map<string, string>> readReport(const string& path) {
+    ifstream file(path);
+    if (!file.is_open()) throw runtime_error("Could not open " + path);
+    map<string, map<string, string>> cases;
+    string line;
+    while (getline(file, line)) {
+        string name;
+        if (line.find("\"family\"") == string::npos || !jsonField(line, "name", name)) continue;
+        for (const char* key : {"wall_ms", "peak_rss_kb", "primes", "cover_terms", "alternatives"}) {
+            string value;
+            if (jsonField(line, key, value)) cases[name][key] = value;
+        }
+    }
+    return cases;
+}
+
+// Prints the differences between two reports; returns the number of flagged cases
+static int compareReports(const string& oldPath, const string& newPath, double threshold) {
+    auto oldCases = readReport(oldPath);
+    auto newCases = readReport(newPath);
+    int flagged = 0;
+    cout << left << setw(32) << "case" << right << setw(12) << "old ms" << setw(12) << "new ms" << setw(10)
+         << "change" << "  " << "flags\n";
+    cout << fixed << setprecision(3);
+    for (const auto& [name, fields] : newCases) {
+        auto old = oldCases.find(name);
+        if (old == oldCases.end()) {
+            cout << left << setw(32) << name << right << "  (new case)\n";
+            continue;
+        }
+        double oldMs = stod(old->second.at("wall_ms"));
+        double newMs = stod(fields.at("wall_ms"));
+        double oldRss = stod(old->second.at("peak_rss_kb"));
+        double newRss = stod(fields.at("peak_rss_kb"));
+
+        string flags;
+        if (newMs > oldMs * (1 + threshold) && newMs - oldMs > REGRESSION_MIN_MS) flags += " SLOWER";
+        if (newRss > oldRss * (1 + threshold) && newRss - oldRss > REGRESSION_MIN_RSS_KB) flags += " MORE-MEMORY";
+        for (const char* key : {"primes", "cover_terms", "alternatives"}) {
+            if (old->second.at(key) != fields.at(key)) {
+                flags += " CHANGED";
+                break;
+            }
+        }
+        if (!flags.empty()) flagged++;
+        double change = oldMs > 0 ? (newMs / oldMs - 1) * 100 : 0;
+        cout << left << setw(32) << name << right << setw(12) << oldMs << setw(12) << newMs << setw(9)
+             << showpos << change << noshowpos << "%" << " " << flags << "\n";
+    }
+    for (const auto& entry : oldCases) {
+        if (!newCases.count(entry.first)) cout << left << setw(32) << entry.first << right << "  (missing)\n";
+    }
+    cout << flagged << " case(s) flagged\n";
+    return flagged;
+}
+
+int main(int argc, char* argv[]) {
+    try {
+        string testsDir;
+        string outFile;
+        string compareOld;
+        string compareNew;
+        int maxVariables = 20;
+        int repeat = 3;
+        uint64_t seed = 1;
+        double threshold = 0.1;
+        for (int i = 1; i < argc; i++) {
+            string arg = argv[i];
+            if (arg == "--tests" && i + 1 < argc) {
+                testsDir = argv[++i];
+            } else if (arg == "--max-variables" && i + 1 < argc) {
+                maxVariables = stoi(argv[++i]);
+            } else if (arg == "--repeat" && i + 1 < argc) {
+                repeat = max(1, stoi(argv[++i]));
+            } else if (arg == "--seed" && i + 1 < argc) {
+                seed = stoull(argv[++i]);
+            } else if (arg == "--out" && i + 1 < argc) {
+                outFile = argv[++i];
+            } else if (arg == "--compare" && i + 2 < argc) {
+                compareOld = argv[++i];
+                compareNew = argv[++i];
+            } else if (arg == "--threshold" && i + 1 < argc) {
+                threshold = stod(argv[++i]);
+            } else {
+                cerr << "Usage: qm-corpus [--tests DIR] [--max-variables N] [--repeat N] [--seed N] [--out FILE]\n"
+                     << "       qm-corpus --compare OLD.json NEW.json [--threshold FRACTION]\n";
+                return 1;
+            }
+        }
+        if (!compareOld.empty()) return compareReports(compareOld, compareNew, threshold) == 0 ? 0 : 1;
+
+        vector<CorpusCase> cases;
+        if (!testsDir.empty()) {
+            vector<filesystem::path> files;
+            for (const filesystem::directory_entry& entry : filesystem::directory_iterator(testsDir)) {
+                string name = entry.path().filename().string();
+                if (entry.is_regular_file() && name.rfind("test", 0) == 0 && entry.path().extension() == ".txt") {
+                    files.push_back(entry.path());
+                }
+            }
+            sort(files.begin(), files.end());
+            for (const filesystem::path& file : files) {
+                try {
+                    Problem problem = loadProblem(file.string());
+                    cases.push_back({"tests/" + file.filename().string(), "tests", problem.variables, problem});
+                }
+                catch (const exception& e) {
+                    cerr << "Skipping " << file.string() << ": " << e.what() << "\n";
+                }
+            }
+        }
+        for (const Family& family : FAMILIES) {
+            for (int n = family.firstVariables; n <= min(family.maxVariables, maxVariables); n++) {
+                if (family.make == adderFunction && n % 2 != 0) continue;
+                string name = family.name + "/n=" + to_string(n);
+                cases.push_back({name, family.name, n, family.make(n, caseSeed(seed, name))});
+            }
+        }
+
+        ofstream file;
+        if (!outFile.empty()) {
+            file.open(outFile, ios::trunc);
+            if (!file.is_open()) {
+                cerr << "Could not open " << outFile << " for writing\n";
+                return 1;
+            }
+        }
+        ostream& out = outFile.empty() ? cout : file;
+
+        out << "{\n  \"harness\": \"qm-corpus\",\n  \"seed\": " << seed << ",\n  \"repeat\": " << repeat
+            << ",\n  \"cases\": [";
+        for (size_t i = 0; i < cases.size(); i++) {
+            const CorpusCase& corpusCase = cases[i];
+            CaseReport report = runCase(corpusCase, repeat);
+            out << (i == 0 ? "\n" : ",\n") << "    {\"name\": \"" << corpusCase.name << "\", \"family\": \""
+                << corpusCase.family << "\", \"variables\": " << corpusCase.variables
+                << ", \"wall_ms\": " << report.wallMs << ", \"peak_rss_kb\": " << report.peakRssKb
+                << ", \"primes_ms\": " << report.stats.primesNs / 1e6
+                << ", \"coverage_ms\": " << report.stats.coverageNs / 1e6
+                << ", \"essentials_ms\": " << report.stats.essentialsNs / 1e6
+                << ", \"cover_search_ms\": " << report.stats.coverSearchNs / 1e6
+                << ", \"primes\": " << report.primes << ", \"cover_terms\": " << report.coverTerms
+                << ", \"alternatives\": " << report.alternatives << "}";
+            out.flush();
+            if (!outFile.empty()) cerr << corpusCase.name << ": " << report.wallMs << " ms\n";
+        }
+
+        // Thread scaling over the whole corpus: 1, 2, 4, ... and the hardware thread count
+        unsigned hardware = max(1u, thread::hardware_concurrency());
+        vector<unsigned> threadCounts;
+        for (unsigned t = 1; t < hardware; t *= 2) threadCounts.push_back(t);
+        threadCounts.push_back(hardware);
+        out << "\n  ],\n  \"hardware_threads\": " << hardware << ",\n  \"threads\": [";
+        for (size_t i = 0; i < threadCounts.size(); i++) {
+            double ms = runThreads(cases, threadCounts[i]);
+            out << (i == 0 ? "\n" : ",\n") << "    {\"threads\": " << threadCounts[i] << ", \"wall_ms\": " << ms
+                << ", \"problems_per_s\": " << (ms > 0 ? cases.size() * 1000.0 / ms : 0) << "}";
+        }
+        out << "\n  ]\n}\n";
+        return out ? 0 : 1;
+    }
+    catch (const exception& e) {
+        cerr << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,122 @@
+#include "batch.h"
+#include "result_cache.h"
+#include "server.h"
+#include <bit>
+#include <chrono>
+#include <cstdio>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+using namespace std;
+
+// End-to-end check of the server, run by ctest: a stream batch solved through
+// a server on a temporary socket has to give the output of the same batch
+// solved locally. The functions are parity functions, whose primes are their
+// minterms, so the responses pile up well past MAX_PENDING_OUTPUT_BYTES and
+// the server has to hold back reading the connection while the client
+// catches up. The process exits with 1 when the outputs differ or the batch
+// fails (a deadlock shows up as the ctest timeout).
+
+const int PARITY_VARIABLES = 12;
+
+// A stream of count parity functions of PARITY_VARIABLES variables (odd ones
+// and even ones by turns)
+static void writeParityStream(const string& path, size_t count) {
+    ofstream out(path, ios::binary);
+    for (size_t i = 0; i < count; i++) {
+        if (i > 0) out << "---\n";
+        out << PARITY_VARIABLES << "\n";
+        bool first = true;
+        for (int t = 0; t < (1 << PARITY_VARIABLES); t++) {
+            if (popcount(static_cast<uint32_t>(t)) % 2 != i % 2) continue;
+            out << (first ? "" : ",") << t;
+            first = false;
+        }
+        out << "\n\n";
+    }
+}
+
+int main() {
+    try {
+        // Every response holds primes, essentials and cover of 2^(n-1) cubes each
+        size_t responseBytes = 3 * (size_t(1) << (PARITY_VARIABLES - 1)) * sizeof(PackedCube);
+        size_t count = 2 * MAX_PENDING_OUTPUT_BYTES / responseBytes + 1;
+        string streamFile = (filesystem::temp_directory_path() / "qm-server-test.txt").string();
+        string socketPath = (filesystem::temp_directory_path() / "qm-server-test.sock").string();
+        writeParityStream(streamFile, count);
+
+        ostringstream local;
+        BatchSummary localSummary = runBatch(BatchSource::Stream, streamFile, local);
+
+        // The second pass hits the cache for every function, so the server
+        // answers faster than the client formats the answers
+        string cacheFile = (filesystem::temp_directory_path() / "qm-server-test.qmc").string();
+        remove(cacheFile.c_str());
+        ResultCache cache(cacheFile);
+        ServerOptions options;
+        options.socketPath = socketPath;
+        options.cache = &cache;
+        Server server(options);
+        remove(socketPath.c_str());
+        string serverError;
+        thread serving([&]() {
+            try {
+                server.run();
+            }
+            catch (const exception& e) {
+                serverError = e.what();
+            }
+        });
+        // Wait until the server accepts connections
+        for (int attempt = 0; attempt < 500; attempt++) {
+            try {
+                ServerConnection probe(socketPath);
+                break;
+            }
+            catch (const exception&) {
+                this_thread::sleep_for(chrono::milliseconds(10));
+            }
+        }
+
+        ostringstream remote;
+        BatchSummary remoteSummary;
+        string clientError;
+        for (int pass = 0; pass < 2 && clientError.empty(); pass++) {
+            remote.str("");
+            try {
+                remoteSummary = runRemoteBatch(BatchSource::Stream, streamFile, remote, socketPath, 0);
+            }
+            catch (const exception& e) {
+                clientError = e.what();
+            }
+        }
+        server.stop();
+        serving.join();
+        remove(streamFile.c_str());
+        remove(socketPath.c_str());
+        remove(cacheFile.c_str());
+
+        bool passed = true;
+        if (!serverError.empty() || !clientError.empty()) {
+            cerr << "FAIL: " << (serverError.empty() ? clientError : serverError) << "\n";
+            passed = false;
+        } else if (localSummary.failures > 0 || remoteSummary.failures > 0 || remoteSummary.problems != count) {
+            cerr << "FAIL: " << remoteSummary.failures << " of " << remoteSummary.problems << " remote problems failed\n";
+            passed = false;
+        } else if (remote.str() != local.str()) {
+            cerr << "FAIL: remote batch output differs from the local one\n";
+            passed = false;
+        }
+        cout << "server: " << count << " problems, about " << (count * responseBytes >> 20) << " MiB of responses\n";
+        return passed ? 0 : 1;
+    }
+    catch (const exception& e) {
+        cerr << "FAIL: " << e.what() << "\n";
+        return 1;
+    }
+}
@@ -0,0 +1,87 @@
+#include "problem.h"
+#include "qm.h"
+#include "small_table.h"
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Check of the small function table, run by ctest: solveSmallFunction has to
+// give exactly what solve() gives, alternatives and order included. Like
+// qm-tablegen this is built without QM_SMALL_TABLE, so solve() here runs the
+// whole algorithm instead of the table. Every function of up to 3 variables
+// is tried with every choice of don't-cares, every 4-variable function
+// without them, and random 4-variable ones with them. The process exits with 1
+// when any differ.
+
+// Random 4-variable functions with don't-cares
+const int RANDOM_FUNCTIONS = 30000;
+
+static size_t compared = 0;
+static size_t differences = 0;
+
+static void compare(const Problem& problem) {
+    QMResult table;
+    if (!solveSmallFunction(problem.variables, problem.minterms, problem.dontCares, table)) {
+        // Only functions with too many don't-cares may be left to the solver
+        if (static_cast<int>(problem.dontCares.size()) <= SMALL_TABLE_MAX_DONT_CARES) {
+            if (differences++ < 10) cerr << "FAIL: table has no entry for a " << problem.variables << "-variable function\n";
+        }
+        return;
+    }
+    QMResult solved = solveProblem(problem);
+    compared++;
+    bool same = table.valid == solved.valid && table.primeImplicants == solved.primeImplicants &&
+                table.essentialPrimeImplicants == solved.essentialPrimeImplicants &&
+                table.uncoveredAfterEssentials == solved.uncoveredAfterEssentials && table.cover == solved.cover &&
+                table.alternatives == solved.alternatives && table.variables == solved.variables;
+    if (!same && differences++ < 10) {
+        cerr << "FAIL: table differs from solve() for " << problem.variables << " variables, minterms";
+        for (int m : problem.minterms) cerr << " " << m;
+        cerr << ", don't-cares";
+        for (int d : problem.dontCares) cerr << " " << d;
+        cerr << "\n";
+    }
+}
+
+// The function whose term t is OFF, ON or a don't-care by digit t of code in base 3
+static Problem ternaryFunction(int variables, long code) {
+    Problem problem;
+    problem.variables = variables;
+    for (int t = 0; t < (1 << variables); t++, code /= 3) {
+        if (code % 3 == 1) problem.minterms.push_back(t);
+        else if (code % 3 == 2) problem.dontCares.push_back(t);
+    }
+    return problem;
+}
+
+int main() {
+    for (int variables = 1; variables <= 3; variables++) {
+        long functions = 1;
+        for (int t = 0; t < (1 << variables); t++) functions *= 3;
+        for (long code = 0; code < functions; code++) compare(ternaryFunction(variables, code));
+    }
+    for (int bits = 0; bits < (1 << 16); bits++) {
+        Problem problem;
+        problem.variables = 4;
+        for (int t = 0; t < 16; t++) {
+            if (bits & (1 << t)) problem.minterms.push_back(t);
+        }
+        compare(problem);
+    }
+    mt19937 rng(39);
+    for (int i = 0; i < RANDOM_FUNCTIONS; i++) {
+        long code = 0;
+        for (int t = 0; t < 16; t++) code = code * 3 + static_cast<long>(rng() % 3);
+        compare(ternaryFunction(4, code));
+    }
+
+    cout << "small table: " << compared << " functions compared\n";
+    if (differences > 0) {
+        cerr << differences << " functions differ\n";
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,637 @@
+#include "binary_format.h"
+#include "bit_slice.h"
+#include "checkpoint.h"
+#include "incremental.h"
+#include "problem.h"
+#include "qm.h"
+#include "result_cache.h"
+#include "small_table.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+// Behavior checks of the solver, run by ctest. Every check solves seeded
+// random problems two ways that have to agree, e.g. an incrementally edited
+// solve against a fresh one, and reports the cases where they do not. The
+// process exits with 1 when any check failed.
+
+// Failed cases are all counted, and the first few printed
+const int MAX_FAILURES_SHOWN = 10;
+
+static int failures = 0;
+
+static void check(bool condition, const string& what) {
+    if (condition) return;
+    if (failures++ < MAX_FAILURES_SHOWN) cerr << "FAIL: " << what << "\n";
+}
+
+// A single-output problem with about onTenths tenths of the terms in ON and
+// one tenth in DC
+static Problem randomProblem(mt19937& rng, int variables, int onTenths = 4) {
+    Problem problem;
+    problem.variables = variables;
+    for (int t = 0; t < (1 << variables); t++) {
+        int roll = static_cast<int>(rng() % 10);
+        if (roll < onTenths) problem.minterms.push_back(t);
+        else if (roll < onTenths + 1) problem.dontCares.push_back(t);
+    }
+    return problem;
+}
+
+// A multi-output problem with outputs outputs, each like randomProblem
+static Problem randomMultiOutputProblem(mt19937& rng, int variables, int outputs) {
+    Problem problem;
+    problem.variables = variables;
+    for (int k = 0; k < outputs; k++) {
+        Problem output = randomProblem(rng, variables);
+        problem.outputMinterms.push_back(output.minterms);
+        problem.outputDontCares.push_back(output.dontCares);
+    }
+    return problem;
+}
+
+// The same function with its inputs permuted and negated at random, which
+// has the same canonical form as problem
+static Problem randomlyTransformed(mt19937& rng, const Problem& problem) {
+    int variables = problem.variables;
+    vector<int> permutation(variables);
+    for (int i = 0; i < variables; i++) permutation[i] = i;
+    shuffle(permutation.begin(), permutation.end(), rng);
+    int negation = static_cast<int>(rng() % (1u << variables));
+    auto transform = [&](vector<int> terms) {
+        for (int& term : terms) {
+            int moved = 0;
+            for (int i = 0; i < variables; i++) moved |= ((term >> i) & 1) << permutation[i];
+            term = moved ^ negation;
+        }
+        sort(terms.begin(), terms.end());
+        return terms;
+    };
+    Problem transformed = problem;
+    transformed.minterms = transform(problem.minterms);
+    transformed.dontCares = transform(problem.dontCares);
+    for (auto& terms : transformed.outputMinterms) terms = transform(terms);
+    for (auto& terms : transformed.outputDontCares) terms = transform(terms);
+    return transformed;
+}
+
+// A path in the temporary directory, removed first
+static string temporaryFile(const string& name) {
+    string path = (filesystem::temp_directory_path() / name).string();
+    remove(path.c_str());
+    return path;
+}
+
+static QMResult solveWithCache(const Problem& problem, ResultCache* cache) {
+    QM qm(problem);
+    qm.setResultCache(cache);
+    return qm.solve();
+}
+
+static bool covers(const string& cube, int term) {
+    PackedCube packed = packCube(cube);
+    return (static_cast<uint32_t>(term) & packed.care) == packed.value;
+}
+
+// Whether cover covers every minterm of problem and no term outside ON + DC
+static bool coversExactly(const Problem& problem, const vector<string>& cover) {
+    vector<char> allowed(size_t(1) << problem.variables, 0);
+    for (int m : problem.minterms) allowed[m] = 1;
+    for (int d : problem.dontCares) allowed[d] = 1;
+    for (int m : problem.minterms) {
+        if (none_of(cover.begin(), cover.end(), [&](const string& cube) { return covers(cube, m); })) return false;
+    }
+    for (int t = 0; t < (1 << problem.variables); t++) {
+        if (allowed[t]) continue;
+        if (any_of(cover.begin(), cover.end(), [&](const string& cube) { return covers(cube, t); })) return false;
+    }
+    return true;
+}
+
+// Two solutions of the same problem that may differ in order and in the
+// choice between covers of the same size
+static bool sameSolution(const Problem& problem, const QMResult& expected, const QMResult& actual) {
+    set<string> expectedPrimes(expected.primeImplicants.begin(), expected.primeImplicants.end());
+    set<string> actualPrimes(actual.primeImplicants.begin(), actual.primeImplicants.end());
+    set<string> expectedEssentials(expected.essentialPrimeImplicants.begin(), expected.essentialPrimeImplicants.end());
+    set<string> actualEssentials(actual.essentialPrimeImplicants.begin(), actual.essentialPrimeImplicants.end());
+    return actual.valid && expectedPrimes == actualPrimes && expectedEssentials == actualEssentials &&
+           expected.cover.size() == actual.cover.size() &&
+           expected.uncoveredAfterEssentials == actual.uncoveredAfterEssentials && coversExactly(problem, actual.cover);
+}
+
+// IncrementalQM after every edit of a random edit sequence against a fresh solve
+static void checkIncremental() {
+    enum TermState { Off, On, DontCare };
+    mt19937 rng(36);
+    size_t cases = 0;
+    for (int round = 0; round < 100; round++) {
+        int variables = 1 + static_cast<int>(rng() % 6);
+        int terms = 1 << variables;
+        Problem problem = randomProblem(rng, variables);
+        vector<TermState> states(terms, Off);
+        for (int m : problem.minterms) states[m] = On;
+        for (int d : problem.dontCares) states[d] = DontCare;
+        IncrementalQM incremental(problem);
+        for (int edit = 0; edit < 30; edit++) {
+            int term = static_cast<int>(rng() % terms);
+            switch (rng() % 4) {
+                case 0: incremental.addMinterm(term); states[term] = On; break;
+                case 1: incremental.removeMinterm(term); if (states[term] == On) states[term] = Off; break;
+                case 2: incremental.addDontCare(term); states[term] = DontCare; break;
+                default: incremental.removeDontCare(term); if (states[term] == DontCare) states[term] = Off; break;
+            }
+            Problem edited;
+            edited.variables = variables;
+            for (int t = 0; t < terms; t++) {
+                if (states[t] == On) edited.minterms.push_back(t);
+                else if (states[t] == DontCare) edited.dontCares.push_back(t);
+            }
+            cases++;
+            check(sameSolution(edited, solveProblem(edited), incremental.result()),
+                  "IncrementalQM differs from a fresh solve (round " + to_string(round) + ", edit " +
+                      to_string(edit) + ", " + to_string(variables) + " variables)");
+        }
+    }
+    cout << "incremental: " << cases << " edits\n";
+}
+
+// A cache hit against a miss on the same problem, after a transformed copy
+// of it was stored, and both against a solve without cache
+static void checkCache() {
+    mt19937 rng(38);
+    size_t hits = 0;
+    string warmFile = temporaryFile("qm-test-warm.qmc");
+    string coldFile = temporaryFile("qm-test-cold.qmc");
+    const int ROUNDS = 300;
+    for (int round = 0; round < ROUNDS; round++) {
+        int variables = 2 + static_cast<int>(rng() % 6);
+        int outputs = variables <= 5 && rng() % 3 == 0 ? 1 + static_cast<int>(rng() % 3) : 0;
+        Problem stored = outputs > 0 ? randomMultiOutputProblem(rng, variables, outputs) : randomProblem(rng, variables);
+        Problem problem = randomlyTransformed(rng, stored);
+        QMResult hit, miss;
+        {
+            remove(warmFile.c_str());
+            remove(coldFile.c_str());
+            ResultCache warm(warmFile, size_t(4) << 20), cold(coldFile, size_t(4) << 20);
+            solveWithCache(stored, &warm);
+            hit = solveWithCache(problem, &warm);
+            miss = solveWithCache(problem, &cold);
+        }
+        QMResult uncached = solveProblem(problem);
+        if (hit.stats.fromCache) hits++;
+        string where = " (round " + to_string(round) + ", " + to_string(variables) + " variables, " +
+                       to_string(outputs) + " outputs)";
+        check(!miss.stats.fromCache, "cold cache hit" + where);
+        check(hit.valid && hit.cover == miss.cover && hit.primeImplicants == miss.primeImplicants &&
+                  hit.essentialPrimeImplicants == miss.essentialPrimeImplicants &&
+                  hit.alternatives == miss.alternatives && hit.primeTags == miss.primeTags &&
+                  hit.outputTerms == miss.outputTerms,
+              "cache hit differs from a miss" + where);
+        check(hit.cover.size() == uncached.cover.size(), "cached cover is not minimal" + where);
+        if (outputs == 0) {
+            check(sameSolution(problem, uncached, hit), "cached result differs from a solve without cache" + where);
+        }
+    }
+    remove(warmFile.c_str());
+    remove(coldFile.c_str());
+    check(hits > ROUNDS / 2, "only " + to_string(hits) + " cache hits in " + to_string(ROUNDS) + " rounds");
+    cout << "cache: " << ROUNDS << " problems, " << hits << " hits\n";
+}
+
+static bool sameResult(const QMResult& expected, const QMResult& actual) {
+    return expected.valid == actual.valid && expected.primeImplicants == actual.primeImplicants &&
+           expected.essentialPrimeImplicants == actual.essentialPrimeImplicants && expected.cover == actual.cover &&
+           expected.alternatives == actual.alternatives &&
+           expected.uncoveredAfterEssentials == actual.uncoveredAfterEssentials &&
+           expected.primeTags == actual.primeTags && expected.outputTerms == actual.outputTerms;
+}
+
+// A cached solve works on the canonical problem; an exception out of it (here
+// from the progress callback) still leaves the QM holding the input
+static void checkCacheRestoresInput() {
+    mt19937 rng(380);
+    string cacheFile = temporaryFile("qm-test-throw.qmc");
+    ResultCache cache(cacheFile, size_t(4) << 20);
+    for (int round = 0; round < 50; round++) {
+        Problem problem = randomlyTransformed(rng, randomProblem(rng, 5 + static_cast<int>(rng() % 3)));
+        QM qm(problem);
+        qm.setResultCache(&cache);
+        qm.setProgressCallback([](const SolveProgress&) { throw logic_error("progress callback failed"); });
+        bool threw = false;
+        try {
+            qm.solve();
+        }
+        catch (const logic_error&) {
+            threw = true;
+        }
+        qm.setProgressCallback(nullptr);
+        qm.setResultCache(nullptr);
+        check(threw && sameResult(solveProblem(problem), qm.solve()),
+              "a cached solve that threw left the canonical problem behind (round " + to_string(round) + ")");
+    }
+    remove(cacheFile.c_str());
+    cout << "cache exceptions: 50 solves\n";
+}
+
+// solveBitSliced against solve() one problem at a time, on mixed batches of
+// sliced and unsliced problems, without a cache and then twice with one (cold
+// and warm)
+static void checkBitSliced() {
+    mt19937 rng(40);
+    vector<Problem> problems;
+    for (int i = 0; i < 600; i++) {
+        int variables = 1 + static_cast<int>(rng() % 7);
+        if (i % 10 == 0 && variables <= 5) {
+            problems.push_back(randomMultiOutputProblem(rng, variables, 2));
+        } else {
+            problems.push_back(randomProblem(rng, variables));
+        }
+    }
+    string slicedFile = temporaryFile("qm-test-sliced.qmc");
+    string scalarFile = temporaryFile("qm-test-scalar.qmc");
+    ResultCache slicedCache(slicedFile, size_t(8) << 20), scalarCache(scalarFile, size_t(8) << 20);
+    for (int pass = 0; pass < 3; pass++) {
+        SolverContext slicedContext, scalarContext;
+        if (pass > 0) {
+            slicedContext.setResultCache(&slicedCache);
+            scalarContext.setResultCache(&scalarCache);
+        }
+        vector<chrono::nanoseconds> latencies;
+        vector<QMResult> sliced = solveBitSliced(problems, slicedContext, &latencies);
+        check(sliced.size() == problems.size() && latencies.size() == problems.size(),
+              "solveBitSliced returned the wrong number of results (pass " + to_string(pass) + ")");
+        for (size_t i = 0; i < problems.size() && i < sliced.size(); i++) {
+            check(sameResult(solve(problems[i], scalarContext), sliced[i]),
+                  "solveBitSliced differs from solve() (pass " + to_string(pass) + ", problem " + to_string(i) +
+                      ", " + to_string(problems[i].variables) + " variables)");
+            if (pass == 2 && problems[i].variables > SMALL_TABLE_VARIABLES && !problems[i].isMultiOutput()) {
+                check(sliced[i].stats.fromCache, "warm cache missed (problem " + to_string(i) + ")");
+            }
+        }
+    }
+    cout << "bit-sliced: " << problems.size() << " problems, 3 passes\n";
+    remove(slicedFile.c_str());
+    remove(scalarFile.c_str());
+}
+
+// A solve cancelled at a random progress report and resumed from its last
+// checkpoint against an uninterrupted solve, at every checkpoint stage
+static void checkCheckpointResume() {
+    mt19937 rng(47);
+    string checkpointFile = temporaryFile("qm-test.qmck");
+    size_t resumed = 0;
+    size_t mismatches = 0;
+    size_t stages[4] = {};
+    for (int round = 0; round < 60; round++) {
+        // Every third problem is dense enough for long branch and bound searches
+        int variables = round % 3 == 0 ? 8 : 6 + static_cast<int>(rng() % 3);
+        Problem problem = randomProblem(rng, variables, round % 3 == 0 ? 5 : 4);
+
+        size_t reports = 0;
+        QM uninterrupted(problem);
+        uninterrupted.setProgressCallback([&](const SolveProgress&) { reports++; });
+        QMResult expected = uninterrupted.solve();
+
+        CancellationToken token;
+        size_t cancelAt = 1 + rng() % max<size_t>(reports, 1);
+        size_t seen = 0;
+        remove(checkpointFile.c_str());
+        QM interrupted(problem);
+        interrupted.setCheckpointing(checkpointFile, chrono::steady_clock::duration::zero());
+        interrupted.setCancellation(&token);
+        interrupted.setProgressCallback([&](const SolveProgress&) {
+            if (++seen == cancelAt) token.cancel();
+        });
+        interrupted.solve();
+        if (!filesystem::exists(checkpointFile)) continue;
+
+        SolverCheckpoint checkpoint = readCheckpoint(checkpointFile);
+        stages[static_cast<int>(checkpoint.stage)]++;
+        QM resuming(1);
+        resuming.resumeFrom(checkpoint);
+        resumed++;
+        check(sameResult(expected, resuming.solve()),
+              "resumed solve differs from an uninterrupted one (round " + to_string(round) + ", " +
+                  to_string(variables) + " variables, stage " + to_string(static_cast<int>(checkpoint.stage)) + ")");
+
+        // A checkpoint that does not fit its problem fails the solve once; the
+        // next solve on the same QM starts from scratch instead of failing again
+        if (checkpoint.stage == CheckpointStage::Primes) continue;
+        if (checkpoint.stage == CheckpointStage::Petrick) {
+            if (checkpoint.products.empty()) continue;
+            checkpoint.products[0].push_back(uint32_t(1) << 30);
+        } else {
+            checkpoint.best.push_back(uint32_t(1) << 30);
+        }
+        mismatches++;
+        QM mismatched(1);
+        mismatched.resumeFrom(checkpoint);
+        bool threw = false;
+        try {
+            mismatched.solve();
+        }
+        catch (const runtime_error&) {
+            threw = true;
+        }
+        check(threw, "a checkpoint that does not match its problem was resumed (round " + to_string(round) + ")");
+        check(sameResult(expected, mismatched.solve()),
+              "the solve after a failed resume differs from a fresh one (round " + to_string(round) + ")");
+    }
+    remove(checkpointFile.c_str());
+    for (CheckpointStage stage : {CheckpointStage::Primes, CheckpointStage::Petrick, CheckpointStage::BranchAndBound}) {
+        check(stages[static_cast<int>(stage)] > 0,
+              "no solve resumed at checkpoint stage " + to_string(static_cast<int>(stage)));
+    }
+    check(mismatches > 0, "no mismatched checkpoint was tried");
+    cout << "checkpoint: " << resumed << " resumed solves (" << stages[1] << " combining, " << stages[2]
+         << " Petrick, " << stages[3] << " branch and bound), " << mismatches << " mismatched\n";
+}
+
+// Checkpoints that cannot be written leave the solve and its result alone
+static void checkCheckpointFailures() {
+    mt19937 rng(470);
+    string unwritable = (filesystem::temp_directory_path() / "qm-test-missing" / "qm-test.qmck").string();
+    for (int round = 0; round < 10; round++) {
+        Problem problem = randomProblem(rng, 8, 5);
+        QM qm(problem);
+        qm.setCheckpointing(unwritable, chrono::steady_clock::duration::zero());
+        QMResult result = qm.solve();
+        check(sameResult(solveProblem(problem), result) && result.stats.checkpointFailures > 0 &&
+                  !result.checkpointError.empty(),
+              "a failed checkpoint write changed the solve (round " + to_string(round) + ")");
+    }
+    cout << "checkpoint failures: 10 solves\n";
+}
+
+static bool sameProblem(const Problem& expected, const Problem& actual) {
+    return expected.variables == actual.variables && expected.minterms == actual.minterms &&
+           expected.dontCares == actual.dontCares && expected.outputMinterms == actual.outputMinterms &&
+           expected.outputDontCares == actual.outputDontCares && expected.fromMaxterms == actual.fromMaxterms;
+}
+
+static bool sameCubes(const vector<PackedCube>& expected, const vector<PackedCube>& actual) {
+    return equal(expected.begin(), expected.end(), actual.begin(), actual.end(),
+                 [](PackedCube a, PackedCube b) { return a.value == b.value && a.care == b.care; });
+}
+
+static bool samePackedResult(const PackedResult& expected, const PackedResult& actual) {
+    return expected.variables == actual.variables && sameCubes(expected.primes, actual.primes) &&
+           sameCubes(expected.essentials, actual.essentials) && sameCubes(expected.cover, actual.cover) &&
+           equal(expected.alternatives.begin(), expected.alternatives.end(), actual.alternatives.begin(),
+                 actual.alternatives.end(), sameCubes) &&
+           expected.primeTags == actual.primeTags && expected.outputTerms == actual.outputTerms;
+}
+
+// Whether parse throws on data
+template <typename Parse>
+static bool rejects(Parse parse, const string& data) {
+    try {
+        parse(data);
+    }
+    catch (const exception&) {
+        return true;
+    }
+    return false;
+}
+
+// Lengths of the truncations of data to try: all of them for short data,
+// else the first and last few hundred and a sample in between
+static vector<size_t> truncations(mt19937& rng, size_t size) {
+    vector<size_t> lengths;
+    for (size_t length = 0; length < size; length++) {
+        if (size <= 1024 || length < 256 || length + 256 >= size || rng() % 64 == 0) lengths.push_back(length);
+    }
+    return lengths;
+}
+
+static void patchU32(string& data, size_t offset, uint32_t value) {
+    for (int i = 0; i < 4; i++) data[offset + i] = static_cast<char>(value >> (8 * i));
+}
+
+// Binary problems and results through encode and parse, every truncation of
+// them, and corrupt headers, counts, terms and cubes
+static void checkBinaryFormat() {
+    mt19937 rng(29);
+    auto parseProblem = [](const string& data) { return parseBinaryProblem(data); };
+    auto parseResult = [](const string& data) { return parseBinaryResult(data); };
+    const int ROUNDS = 200;
+    for (int round = 0; round < ROUNDS; round++) {
+        string where = " (round " + to_string(round) + ")";
+        Problem problem;
+        if (round % 4 == 0) {
+            problem = randomMultiOutputProblem(rng, 1 + static_cast<int>(rng() % 6), 1 + static_cast<int>(rng() % 4));
+        } else if (round % 4 == 1) {
+            // Sparse lists of a wide function, which go out delta encoded
+            problem.variables = 10 + static_cast<int>(rng() % 11);
+            set<int> terms;
+            for (int i = 0; i < 40; i++) terms.insert(static_cast<int>(rng() % (1u << problem.variables)));
+            for (int term : terms) (rng() % 4 ? problem.minterms : problem.dontCares).push_back(term);
+        } else {
+            problem = randomProblem(rng, 1 + static_cast<int>(rng() % 7), static_cast<int>(rng() % 9));
+        }
+        problem.fromMaxterms = round % 3 == 0;
+
+        string encoded = encodeBinaryProblem(problem);
+        check(!rejects(parseProblem, encoded) && sameProblem(problem, parseBinaryProblem(encoded)),
+              "binary problem round trip" + where);
+        for (size_t length : truncations(rng, encoded.size())) {
+            check(rejects(parseProblem, encoded.substr(0, length)),
+                  "truncated binary problem accepted (" + to_string(length) + " bytes)" + where);
+        }
+        // Header: magic, u16 version, u8 variables, u8 flags, u32 outputs, then
+        // the first list: u8 encoding, u32 count, u32 payload bytes
+        for (uint8_t variables : {0, 21, 255}) {
+            string corrupt = encoded;
+            corrupt[6] = static_cast<char>(variables);
+            check(rejects(parseProblem, corrupt), "binary problem with " + to_string(variables) + " variables" + where);
+        }
+        string corrupt = encoded;
+        patchU32(corrupt, 8, 65);
+        check(rejects(parseProblem, corrupt), "binary problem with 65 outputs" + where);
+        corrupt = encoded;
+        patchU32(corrupt, 13, 0xFFFFFFFF);
+        check(rejects(parseProblem, corrupt), "binary problem with a huge term count" + where);
+        corrupt = encoded;
+        corrupt[12] = 7;
+        check(rejects(parseProblem, corrupt), "binary problem with an unknown list encoding" + where);
+        // Any flipped byte either fails to parse or gives a problem that validates
+        for (int flip = 0; flip < 20; flip++) {
+            corrupt = encoded;
+            corrupt[rng() % corrupt.size()] ^= static_cast<char>(1 + rng() % 255);
+            try {
+                validateProblem(parseBinaryProblem(corrupt));
+            }
+            catch (const exception&) {
+            }
+        }
+
+        PackedResult packed = packResult(solveProblem(problem));
+        encoded = encodeBinaryResult(packed);
+        check(!rejects(parseResult, encoded) && samePackedResult(packed, parseBinaryResult(encoded)),
+              "binary result round trip" + where);
+        for (size_t length : truncations(rng, encoded.size())) {
+            check(rejects(parseResult, encoded.substr(0, length)),
+                  "truncated binary result accepted (" + to_string(length) + " bytes)" + where);
+        }
+        // Header: magic, u16 version, u8 variables, u8 flags, u32 primes, then
+        // the first prime as u32 value and u32 care
+        for (uint8_t variables : {0, 21, 255}) {
+            corrupt = encoded;
+            corrupt[6] = static_cast<char>(variables);
+            check(rejects(parseResult, corrupt), "binary result with " + to_string(variables) + " variables" + where);
+        }
+        corrupt = encoded;
+        patchU32(corrupt, 8, 0xFFFFFFFF);
+        check(rejects(parseResult, corrupt), "binary result with a huge prime count" + where);
+        if (!packed.primes.empty()) {
+            corrupt = encoded;
+            patchU32(corrupt, 16, uint32_t(1) << packed.variables);
+            check(rejects(parseResult, corrupt), "binary result with a cube beyond the last variable" + where);
+            corrupt = encoded;
+            patchU32(corrupt, 12, packed.primes[0].value | (~packed.primes[0].care & ((uint32_t(1) << packed.variables) - 1)));
+            if (packed.primes[0].care != (uint32_t(1) << packed.variables) - 1) {
+                check(rejects(parseResult, corrupt), "binary result with a value outside its cube" + where);
+            }
+        }
+        for (int flip = 0; flip < 20; flip++) {
+            corrupt = encoded;
+            corrupt[rng() % corrupt.size()] ^= static_cast<char>(1 + rng() % 255);
+            try {
+                PackedResult parsed = parseBinaryResult(corrupt);
+                for (PackedCube cube : parsed.cover) unpackCube(cube, parsed.variables);
+            }
+            catch (const exception&) {
+            }
+        }
+    }
+    cout << "binary format: " << ROUNDS << " problems and results\n";
+}
+
+// The hex truth table of terms: most significant digit first, bit t = term t
+static string hexTable(const vector<int>& terms, int variables) {
+    size_t digits = variables >= 2 ? (size_t(1) << variables) / 4 : 1;
+    vector<int> values(digits, 0);
+    for (int term : terms) values[term / 4] |= 1 << (term % 4);
+    string hex;
+    for (size_t d = digits; d-- > 0;) hex += "0123456789abcdef"[values[d]];
+    return hex;
+}
+
+static string termList(const vector<int>& terms) {
+    string list;
+    for (size_t i = 0; i < terms.size(); i++) list += (i > 0 ? "," : "") + to_string(terms[i]);
+    return list;
+}
+
+// Truth table files against the term lists they encode, and against the
+// same problem written as a term list file
+static void checkTruthTables() {
+    mt19937 rng(30);
+    const int ROUNDS = 300;
+    for (int round = 0; round < ROUNDS; round++) {
+        int variables = 1 + static_cast<int>(rng() % 12);
+        Problem problem = randomProblem(rng, variables, static_cast<int>(rng() % 10));
+        if (round % 3 == 0) problem.dontCares.clear();
+        string where = " (round " + to_string(round) + ", " + to_string(variables) + " variables)";
+
+        string header = to_string(variables) + "\ntruthtable\n";
+        string table = header + hexTable(problem.minterms, variables) + "\n";
+        if (!problem.dontCares.empty() || round % 2 == 0) table += hexTable(problem.dontCares, variables) + "\n";
+        Problem fromTable = parseProblem(table);
+        check(fromTable.minterms == problem.minterms && fromTable.dontCares == problem.dontCares && !fromTable.isMultiOutput(),
+              "truth table differs from its term lists" + where);
+        if (!problem.minterms.empty()) {
+            Problem fromList = parseProblem(to_string(variables) + "\n" + termList(problem.minterms) + "\n" +
+                                            termList(problem.dontCares) + "\n");
+            check(sameProblem(fromList, fromTable), "truth table differs from the term list file" + where);
+        }
+
+        // Prefixes, separators and either case of hex digits
+        string decorated = hexTable(problem.minterms, variables);
+        transform(decorated.begin(), decorated.end(), decorated.begin(), ::toupper);
+        if (decorated.size() > 4) decorated.insert(decorated.size() / 2, "_");
+        Problem fromDecorated = parseProblem(header + "0x" + decorated + "\n");
+        check(fromDecorated.minterms == problem.minterms && fromDecorated.dontCares.empty(),
+              "decorated truth table differs from its term list" + where);
+
+        // Wrong sizes, bad digits, bits beyond the last term and overlaps
+        string onTable = hexTable(problem.minterms, variables);
+        auto parse = [](const string& text) { return parseProblem(text); };
+        check(rejects(parse, header + onTable + "0\n"), "truth table with an extra digit" + where);
+        check(rejects(parse, header + "g" + onTable.substr(1) + "\n"), "truth table with a bad digit" + where);
+        if (variables == 1) check(rejects(parse, header + "4\n"), "truth table with bits beyond the last term" + where);
+        if (!problem.minterms.empty()) {
+            check(rejects(parse, header + onTable + "\n" + onTable + "\n"), "truth table overlapping its don't-cares" + where);
+        }
+    }
+    cout << "truth tables: " << ROUNDS << " problems\n";
+}
+
+// Multi-output covers: every output's terms cover its minterms and stay in
+// its ON + DC, every (output, minterm) row is covered, and sharing terms never
+// costs more than covering each output on its own
+static void checkMultiOutputCovers() {
+    mt19937 rng(26);
+    const int ROUNDS = 300;
+    size_t rows = 0;
+    for (int round = 0; round < ROUNDS; round++) {
+        int variables = 1 + static_cast<int>(rng() % 6);
+        int outputs = 1 + static_cast<int>(rng() % 4);
+        Problem problem = randomMultiOutputProblem(rng, variables, outputs);
+        QMResult result = solveProblem(problem);
+        string where = " (round " + to_string(round) + ", " + to_string(variables) + " variables, " +
+                       to_string(outputs) + " outputs)";
+        if (!result.valid || result.outputTerms.size() != static_cast<size_t>(outputs)) {
+            check(false, "multi-output result is invalid or has the wrong number of outputs" + where);
+            continue;
+        }
+        set<string> separateTerms;
+        for (int k = 0; k < outputs; k++) {
+            Problem output;
+            output.variables = variables;
+            output.minterms = problem.outputMinterms[k];
+            output.dontCares = problem.outputDontCares[k];
+            vector<string> cover;
+            for (size_t index : result.outputTerms[k]) {
+                if (index < result.cover.size()) cover.push_back(result.cover[index]);
+                else check(false, "output term index out of range" + where);
+            }
+            check(coversExactly(output, cover), "output " + to_string(k) + " is not covered exactly" + where);
+            rows += output.minterms.size();
+            QMResult separate = solveProblem(output);
+            separateTerms.insert(separate.cover.begin(), separate.cover.end());
+        }
+        check(set<string>(result.cover.begin(), result.cover.end()).size() == result.cover.size(),
+              "multi-output cover repeats a term" + where);
+        check(result.cover.size() <= separateTerms.size(),
+              "multi-output cover is bigger than the separate covers together" + where);
+    }
+    cout << "multi-output: " << ROUNDS << " problems, " << rows << " (output, minterm) rows\n";
+}
+
+int main() {
+    checkBinaryFormat();
+    checkTruthTables();
+    checkMultiOutputCovers();
+    checkIncremental();
+    checkCache();
+    checkCacheRestoresInput();
+    checkBitSliced();
+    checkCheckpointResume();
+    checkCheckpointFailures();
+    if (failures > 0) {
+        cerr << failures << " checks failed\n";
+        return 1;
+    }
+    return 0;
+}